@@ -58,8 +58,18 @@ void Config::ReadValues() {
 
     // Core
     Settings::values.cpu_core = glfw_config->GetInteger("Core", "cpu_core", Core::CPU_Interpreter);
+    Settings::values.use_fastmem = glfw_config->GetBoolean("Core", "use_fastmem", true);
+    Settings::values.translation_cache_size = glfw_config->GetInteger("Core", "translation_cache_size", 32);
     Settings::values.gpu_refresh_rate = glfw_config->GetInteger("Core", "gpu_refresh_rate", 30);
     Settings::values.frame_skip = glfw_config->GetInteger("Core", "frame_skip", 0);
+    Settings::values.rasterizer_threads = glfw_config->GetInteger("Core", "rasterizer_threads", 0);
+    Settings::values.rasterizer_sse2_verify = glfw_config->GetBoolean("Core", "rasterizer_sse2_verify", false);
+    Settings::values.vertex_cache_size = glfw_config->GetInteger("Core", "vertex_cache_size", 32);
+    Settings::values.vertex_shader_threads = glfw_config->GetInteger("Core", "vertex_shader_threads", 0);
+    Settings::values.vertex_shader_parallel_threshold = glfw_config->GetInteger("Core", "vertex_shader_parallel_threshold", 256);
+    Settings::values.use_shader_jit = glfw_config->GetBoolean("Core", "use_shader_jit", true);
+    Settings::values.shader_jit_verify = glfw_config->GetBoolean("Core", "shader_jit_verify", false);
+    Settings::values.use_gpu_thread = glfw_config->GetBoolean("Core", "use_gpu_thread", false);
 
     // Data Storage
     Settings::values.use_virtual_sd = glfw_config->GetBoolean("Data Storage", "use_virtual_sd", true);
@@ -27,9 +27,19 @@ pad_sleft =
 pad_sright =
 
 [Core]
-cpu_core = ## 0: Interpreter (default), 1: OldInterpreter (may work better, soon to be deprecated)
+cpu_core = ## 0: Interpreter (default), 1: OldInterpreter (may work better, soon to be deprecated), 2: JIT (x86-64 only)
+use_fastmem = ## Map guest memory into one host address range on x86-64 Linux. 1: On (default), 0: Off
+translation_cache_size = ## Size in MB of the cache for code translated by the DynCom CPU core. It is emptied when full. Default: 32
 gpu_refresh_rate = ## 30 (default)
 frame_skip = ## 0: No frameskip (default), 1 : 2x frameskip, 2 : 4x frameskip, etc.
+rasterizer_threads = ## 0: Rasterize on the emulation thread (default), 2 or more: number of threads shading screen tiles
+rasterizer_sse2_verify = ## Shade pixel spans with the scalar rasterizer too and report mismatches. 0: Off (default), 1: On
+vertex_cache_size = ## Number of shaded vertices reused within indexed draws, 32 (default), 0: Disabled
+vertex_shader_threads = ## 0: Shade vertices on the emulation thread (default), 2 or more: number of threads shading large batches of vertices
+vertex_shader_parallel_threshold = ## Minimum number of vertices in a batch for it to be shaded on multiple threads, 256 (default)
+use_shader_jit = ## Compile vertex shaders to native code on x86-64. 1: On (default), 0: Off
+shader_jit_verify = ## Run the shader interpreter alongside compiled shaders and report mismatches. 0: Off (default), 1: On
+use_gpu_thread = ## Process GPU command lists on a separate thread, overlapping them with CPU emulation. 0: Off (default), 1: On
 
 [Data Storage]
 use_virtual_sd =
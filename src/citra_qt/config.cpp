@@ -44,8 +44,18 @@ void Config::ReadValues() {
 
     qt_config->beginGroup("Core");
     Settings::values.cpu_core = qt_config->value("cpu_core", Core::CPU_Interpreter).toInt();
+    Settings::values.use_fastmem = qt_config->value("use_fastmem", true).toBool();
+    Settings::values.translation_cache_size = qt_config->value("translation_cache_size", 32).toInt();
     Settings::values.gpu_refresh_rate = qt_config->value("gpu_refresh_rate", 30).toInt();
     Settings::values.frame_skip = qt_config->value("frame_skip", 0).toInt();
+    Settings::values.rasterizer_threads = qt_config->value("rasterizer_threads", 0).toInt();
+    Settings::values.rasterizer_sse2_verify = qt_config->value("rasterizer_sse2_verify", false).toBool();
+    Settings::values.vertex_cache_size = qt_config->value("vertex_cache_size", 32).toInt();
+    Settings::values.vertex_shader_threads = qt_config->value("vertex_shader_threads", 0).toInt();
+    Settings::values.vertex_shader_parallel_threshold = qt_config->value("vertex_shader_parallel_threshold", 256).toInt();
+    Settings::values.use_shader_jit = qt_config->value("use_shader_jit", true).toBool();
+    Settings::values.shader_jit_verify = qt_config->value("shader_jit_verify", false).toBool();
+    Settings::values.use_gpu_thread = qt_config->value("use_gpu_thread", false).toBool();
     qt_config->endGroup();
 
     qt_config->beginGroup("Data Storage");
@@ -80,8 +90,18 @@ void Config::SaveValues() {
 
     qt_config->beginGroup("Core");
     qt_config->setValue("cpu_core", Settings::values.cpu_core);
+    qt_config->setValue("use_fastmem", Settings::values.use_fastmem);
+    qt_config->setValue("translation_cache_size", Settings::values.translation_cache_size);
     qt_config->setValue("gpu_refresh_rate", Settings::values.gpu_refresh_rate);
     qt_config->setValue("frame_skip", Settings::values.frame_skip);
+    qt_config->setValue("rasterizer_threads", Settings::values.rasterizer_threads);
+    qt_config->setValue("rasterizer_sse2_verify", Settings::values.rasterizer_sse2_verify);
+    qt_config->setValue("vertex_cache_size", Settings::values.vertex_cache_size);
+    qt_config->setValue("vertex_shader_threads", Settings::values.vertex_shader_threads);
+    qt_config->setValue("vertex_shader_parallel_threshold", Settings::values.vertex_shader_parallel_threshold);
+    qt_config->setValue("use_shader_jit", Settings::values.use_shader_jit);
+    qt_config->setValue("shader_jit_verify", Settings::values.shader_jit_verify);
+    qt_config->setValue("use_gpu_thread", Settings::values.use_gpu_thread);
     qt_config->endGroup();
 
     qt_config->beginGroup("Data Storage");
@@ -0,0 +1,164 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <QCheckBox>
+#include <QFileDialog>
+#include <QHBoxLayout>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QSortFilterProxyModel>
+#include <QTimer>
+#include <QTreeView>
+#include <QVBoxLayout>
+
+#include "hle_call_stats.h"
+
+/// Interval between two snapshots of the statistics while recording, in milliseconds
+static const int REFRESH_INTERVAL = 1000;
+
+enum {
+    COLUMN_GROUP,
+    COLUMN_NAME,
+    COLUMN_CALLS,
+    COLUMN_TOTAL_HOST_TIME,
+    COLUMN_AVERAGE_HOST_TIME,
+    COLUMN_MAX_HOST_TIME,
+    COLUMN_TICKS,
+    COLUMN_COUNT
+};
+
+HLECallStatsModel::HLECallStatsModel(QObject* parent) : QAbstractTableModel(parent) {
+}
+
+int HLECallStatsModel::columnCount(const QModelIndex& parent) const {
+    return COLUMN_COUNT;
+}
+
+int HLECallStatsModel::rowCount(const QModelIndex& parent) const {
+    return static_cast<int>(stats.size());
+}
+
+QVariant HLECallStatsModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || role != Qt::DisplayRole)
+        return QVariant();
+
+    const HLE::CallStats::FunctionStats& function = stats[index.row()];
+    switch (index.column()) {
+    case COLUMN_GROUP:
+        return QString::fromStdString(function.group);
+    case COLUMN_NAME:
+        return QString::fromStdString(function.name);
+    case COLUMN_CALLS:
+        return QVariant::fromValue<qulonglong>(function.call_count);
+    case COLUMN_TOTAL_HOST_TIME:
+        return function.total_host_ns / 1000000.0;
+    case COLUMN_AVERAGE_HOST_TIME:
+        return function.total_host_ns / 1000.0 / function.call_count;
+    case COLUMN_MAX_HOST_TIME:
+        return function.max_host_ns / 1000.0;
+    case COLUMN_TICKS:
+        return QVariant::fromValue<qulonglong>(function.total_ticks);
+    }
+
+    return QVariant();
+}
+
+QVariant HLECallStatsModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+    case COLUMN_GROUP:
+        return tr("Group");
+    case COLUMN_NAME:
+        return tr("Function");
+    case COLUMN_CALLS:
+        return tr("Calls");
+    case COLUMN_TOTAL_HOST_TIME:
+        return tr("Total (ms)");
+    case COLUMN_AVERAGE_HOST_TIME:
+        return tr("Average (us)");
+    case COLUMN_MAX_HOST_TIME:
+        return tr("Max (us)");
+    case COLUMN_TICKS:
+        return tr("Emulated Ticks");
+    }
+
+    return QVariant();
+}
+
+void HLECallStatsModel::Refresh() {
+    beginResetModel();
+
+    stats = HLE::CallStats::GetSnapshot();
+
+    endResetModel();
+}
+
+HLECallStatsWidget::HLECallStatsWidget(QWidget* parent) : QDockWidget(tr("HLE Call Statistics"), parent) {
+    setObjectName("HLE Call Statistics");
+    model = new HLECallStatsModel(this);
+
+    QSortFilterProxyModel* sorted_model = new QSortFilterProxyModel(this);
+    sorted_model->setSourceModel(model);
+
+    QWidget* main_widget = new QWidget;
+
+    QTreeView* list_widget = new QTreeView;
+    list_widget->setModel(sorted_model);
+    list_widget->setRootIsDecorated(false);
+    list_widget->setSortingEnabled(true);
+    list_widget->sortByColumn(COLUMN_TOTAL_HOST_TIME, Qt::DescendingOrder);
+
+    toggle_recording = new QCheckBox(tr("Record calls"));
+    QPushButton* reset = new QPushButton(tr("Reset"));
+    QPushButton* save = new QPushButton(tr("Save..."));
+
+    refresh_timer = new QTimer(this);
+    refresh_timer->setInterval(REFRESH_INTERVAL);
+
+    connect(toggle_recording, SIGNAL(toggled(bool)), this, SLOT(OnToggleRecording(bool)));
+    connect(reset, SIGNAL(clicked()), this, SLOT(OnReset()));
+    connect(save, SIGNAL(clicked()), this, SLOT(OnSave()));
+    connect(refresh_timer, SIGNAL(timeout()), model, SLOT(Refresh()));
+
+    QHBoxLayout* controls_layout = new QHBoxLayout;
+    controls_layout->addWidget(toggle_recording);
+    controls_layout->addStretch();
+    controls_layout->addWidget(reset);
+    controls_layout->addWidget(save);
+
+    QVBoxLayout* main_layout = new QVBoxLayout;
+    main_layout->addWidget(list_widget);
+    main_layout->addLayout(controls_layout);
+    main_widget->setLayout(main_layout);
+
+    setWidget(main_widget);
+}
+
+void HLECallStatsWidget::OnToggleRecording(bool checked) {
+    HLE::CallStats::SetEnabled(checked);
+
+    if (checked) {
+        refresh_timer->start();
+    } else {
+        refresh_timer->stop();
+        model->Refresh();
+    }
+}
+
+void HLECallStatsWidget::OnReset() {
+    HLE::CallStats::Reset();
+    model->Refresh();
+}
+
+void HLECallStatsWidget::OnSave() {
+    QString filename = QFileDialog::getSaveFileName(this, tr("Save HLE Call Statistics"), QString(),
+                                                    tr("CSV (*.csv);;JSON (*.json)"));
+    if (filename.isEmpty())
+        return;
+
+    if (!HLE::CallStats::DumpToFile(filename.toStdString()))
+        QMessageBox::warning(this, tr("HLE Call Statistics"), tr("Could not write %1").arg(filename));
+}
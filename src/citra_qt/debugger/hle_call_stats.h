@@ -0,0 +1,54 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <vector>
+
+#include <QAbstractTableModel>
+#include <QDockWidget>
+
+#include "core/hle/call_stats.h"
+
+class QCheckBox;
+class QTimer;
+class QTreeView;
+
+class HLECallStatsModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    HLECallStatsModel(QObject* parent);
+
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+public slots:
+    /// Takes a new snapshot of the recorded statistics
+    void Refresh();
+
+private:
+    std::vector<HLE::CallStats::FunctionStats> stats;
+};
+
+class HLECallStatsWidget : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    HLECallStatsWidget(QWidget* parent = nullptr);
+
+public slots:
+    void OnToggleRecording(bool checked);
+    void OnReset();
+    void OnSave();
+
+private:
+    HLECallStatsModel* model;
+    QTimer* refresh_timer;
+    QCheckBox* toggle_recording;
+};
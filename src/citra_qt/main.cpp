@@ -34,6 +34,7 @@
 #include "debugger/graphics_breakpoints.h"
 #include "debugger/graphics_cmdlists.h"
 #include "debugger/graphics_framebuffer.h"
+#include "debugger/hle_call_stats.h"
 
 #include "core/settings.h"
 #include "core/system.h"
@@ -84,6 +85,10 @@ GMainWindow::GMainWindow()
     addDockWidget(Qt::RightDockWidgetArea, graphicsFramebufferWidget);
     graphicsFramebufferWidget->hide();
 
+    auto hleCallStatsWidget = new HLECallStatsWidget(this);
+    addDockWidget(Qt::RightDockWidgetArea, hleCallStatsWidget);
+    hleCallStatsWidget->hide();
+
     QMenu* debug_menu = ui.menu_View->addMenu(tr("Debugging"));
     debug_menu->addAction(disasmWidget->toggleViewAction());
     debug_menu->addAction(registersWidget->toggleViewAction());
@@ -92,6 +97,7 @@ GMainWindow::GMainWindow()
     debug_menu->addAction(graphicsCommandsWidget->toggleViewAction());
     debug_menu->addAction(graphicsBreakpointsWidget->toggleViewAction());
     debug_menu->addAction(graphicsFramebufferWidget->toggleViewAction());
+    debug_menu->addAction(hleCallStatsWidget->toggleViewAction());
 
     // Set default UI state
     // geometry: 55% of the window contents are in the upper screen half, 45% in the lower half
@@ -0,0 +1,162 @@
+// Copyright 2013 Dolphin Emulator Project / 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "common/common.h"
+#include "common/cpu_detect.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CPU_DETECT_X86 1
+#endif
+
+#ifdef CPU_DETECT_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef CPU_DETECT_X86
+
+static void Cpuid(int info[4], int function_id) {
+#ifdef _MSC_VER
+    __cpuidex(info, function_id, 0);
+#else
+    unsigned int eax, ebx, ecx, edx;
+    __cpuid_count(function_id, 0, eax, ebx, ecx, edx);
+    info[0] = eax;
+    info[1] = ebx;
+    info[2] = ecx;
+    info[3] = edx;
+#endif
+}
+
+static u64 GetXCR0() {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    u32 eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((u64)edx << 32) | eax;
+#endif
+}
+
+#endif
+
+CPUInfo cpu_info;
+
+CPUInfo::CPUInfo() {
+    Detect();
+}
+
+void CPUInfo::Detect() {
+    memset(this, 0, sizeof(*this));
+
+#if defined(_WIN64) || defined(__x86_64__) || defined(__aarch64__)
+    OS64bit = true;
+    CPU64bit = true;
+    Mode64bit = true;
+#endif
+
+    num_cores = std::max(1u, std::thread::hardware_concurrency());
+    logical_cpu_count = num_cores;
+
+#ifdef CPU_DETECT_X86
+    vendor = VENDOR_OTHER;
+
+    // Get the vendor string
+    int cpu_id[4];
+    Cpuid(cpu_id, 0x00000000);
+    int max_std_fn = cpu_id[0];
+    memcpy(&cpu_string[0], &cpu_id[1], sizeof(int));
+    memcpy(&cpu_string[4], &cpu_id[3], sizeof(int));
+    memcpy(&cpu_string[8], &cpu_id[2], sizeof(int));
+    cpu_string[12] = '\0';
+
+    if (!strcmp(cpu_string, "GenuineIntel"))
+        vendor = VENDOR_INTEL;
+    else if (!strcmp(cpu_string, "AuthenticAMD"))
+        vendor = VENDOR_AMD;
+
+    // Get the brand string, if available
+    Cpuid(cpu_id, 0x80000000);
+    unsigned int max_ex_fn = cpu_id[0];
+    if (max_ex_fn >= 0x80000004) {
+        for (int i = 0; i < 3; ++i) {
+            Cpuid(cpu_id, 0x80000002 + i);
+            memcpy(&brand_string[16 * i], cpu_id, sizeof(cpu_id));
+        }
+        brand_string[0x40] = '\0';
+    } else {
+        strcpy(brand_string, cpu_string);
+    }
+
+    if (max_std_fn >= 1) {
+        Cpuid(cpu_id, 0x00000001);
+        HTT = ((cpu_id[3] >> 28) & 1) != 0;
+        bSSE = ((cpu_id[3] >> 25) & 1) != 0;
+        bSSE2 = ((cpu_id[3] >> 26) & 1) != 0;
+        bSSE3 = ((cpu_id[2] >> 0) & 1) != 0;
+        bSSSE3 = ((cpu_id[2] >> 9) & 1) != 0;
+        bSSE4_1 = ((cpu_id[2] >> 19) & 1) != 0;
+        bSSE4_2 = ((cpu_id[2] >> 20) & 1) != 0;
+        bPOPCNT = ((cpu_id[2] >> 23) & 1) != 0;
+        bAES = ((cpu_id[2] >> 25) & 1) != 0;
+
+        // AVX additionally requires the OS to save the YMM registers on context switches
+        bool osxsave = ((cpu_id[2] >> 27) & 1) != 0;
+        if (((cpu_id[2] >> 28) & 1) && osxsave)
+            bAVX = (GetXCR0() & 6) == 6;
+    }
+
+    if (max_ex_fn >= 0x80000001) {
+        Cpuid(cpu_id, 0x80000001);
+        bLAHFSAHF64 = ((cpu_id[2] >> 0) & 1) != 0;
+        bLZCNT = ((cpu_id[2] >> 5) & 1) != 0;
+        bSSE4A = ((cpu_id[2] >> 6) & 1) != 0;
+        bLongMode = ((cpu_id[3] >> 29) & 1) != 0;
+    }
+#elif defined(__aarch64__)
+    vendor = VENDOR_ARM;
+    strcpy(cpu_string, "ARMv8");
+    strcpy(brand_string, cpu_string);
+    bFP = true;
+    bASIMD = true;
+    bNEON = true;
+#elif defined(__arm__)
+    vendor = VENDOR_ARM;
+    strcpy(cpu_string, "ARM");
+    strcpy(brand_string, cpu_string);
+#ifdef __ARM_NEON__
+    bNEON = true;
+#endif
+#else
+    vendor = VENDOR_OTHER;
+    strcpy(cpu_string, "Unknown");
+    strcpy(brand_string, cpu_string);
+#endif
+}
+
+std::string CPUInfo::Summarize() {
+    std::string sum(brand_string);
+    sum += " (" + std::to_string(num_cores) + " threads)";
+
+    if (bSSE) sum += ", SSE";
+    if (bSSE2) sum += ", SSE2";
+    if (bSSE3) sum += ", SSE3";
+    if (bSSSE3) sum += ", SSSE3";
+    if (bSSE4_1) sum += ", SSE4.1";
+    if (bSSE4_2) sum += ", SSE4.2";
+    if (HTT) sum += ", HTT";
+    if (bAVX) sum += ", AVX";
+    if (bAES) sum += ", AES";
+    if (bNEON) sum += ", NEON";
+    if (bLongMode) sum += ", 64-bit support";
+    return sum;
+}
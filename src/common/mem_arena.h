@@ -37,6 +37,8 @@ public:
 
     // This only finds 1 GB in 32-bit
     static u8 *Find4GBBase();
+    // Frees the address space reserved by Find4GBBase, once all views into it have been released
+    static void Release4GBBase(u8 *base);
 private:
 
 #ifdef _WIN32
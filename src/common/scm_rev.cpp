@@ -0,0 +1,18 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2
+// Refer to the license.txt file included.
+
+#include "common/scm_rev.h"
+
+#define GIT_REV      "759bacb53484249e0c2a9fa5e8c2132d6843b807"
+#define GIT_BRANCH   "master"
+#define GIT_DESC     "759bacb-dirty"
+
+namespace Common {
+
+const char g_scm_rev[]      = GIT_REV;
+const char g_scm_branch[]   = GIT_BRANCH;
+const char g_scm_desc[]     = GIT_DESC;
+
+} // namespace
+
@@ -0,0 +1,69 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+#include "common/common.h" // for NonCopyable
+
+namespace Common {
+
+/**
+ * A lock-free SPSC (Single-Producer Single-Consumer) queue of bounded size. One thread may push to
+ * the queue while another one pops from it, without any locking. Neither side blocks: pushing to
+ * a full queue and popping from an empty one fail instead.
+ */
+template <typename T, size_t Capacity>
+class SPSCQueue : private NonCopyable {
+public:
+    SPSCQueue() : read_index(0), write_index(0) {}
+
+    /**
+     * Pushes a value to the queue. Must only be called by the producer thread.
+     * @return False if the queue is full, in which case value is left untouched
+     */
+    bool TryPush(T&& value) {
+        const size_t write = write_index.load(std::memory_order_relaxed);
+        const size_t next = (write + 1) % ArraySize;
+        if (next == read_index.load(std::memory_order_acquire))
+            return false;
+
+        items[write] = std::move(value);
+        write_index.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Pops the oldest value from the queue. Must only be called by the consumer thread.
+     * @return False if the queue is empty
+     */
+    bool TryPop(T& value) {
+        const size_t read = read_index.load(std::memory_order_relaxed);
+        if (read == write_index.load(std::memory_order_acquire))
+            return false;
+
+        value = std::move(items[read]);
+        read_index.store((read + 1) % ArraySize, std::memory_order_release);
+        return true;
+    }
+
+    /// Returns whether the queue is empty. Only exact when called by the consumer thread.
+    bool IsEmpty() const {
+        return read_index.load(std::memory_order_acquire) == write_index.load(std::memory_order_acquire);
+    }
+
+private:
+    // One slot always stays free, to tell a full queue from an empty one
+    static const size_t ArraySize = Capacity + 1;
+
+    std::array<T, ArraySize> items;
+    std::atomic<size_t> read_index;     ///< Next slot to pop from, only written by the consumer
+    std::atomic<size_t> write_index;    ///< Next slot to push to, only written by the producer
+};
+
+} // namespace
@@ -0,0 +1,82 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include "common/thread.h"
+#include "common/thread_pool.h"
+
+namespace Common {
+
+ThreadPool::ThreadPool(unsigned num_threads) : next_job(0) {
+    for (unsigned i = 1; i < num_threads; ++i)
+        workers.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutting_down = true;
+    }
+    work_available.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job) {
+    if (count == 0)
+        return;
+
+    // Don't bother waking up the workers if there is nothing to distribute
+    if (workers.empty() || count == 1) {
+        for (size_t i = 0; i < count; ++i)
+            job(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_job = &job;
+        num_jobs = count;
+        next_job = 0;
+        busy_workers = static_cast<unsigned>(workers.size());
+        ++batch_id;
+    }
+    work_available.notify_all();
+
+    RunJobs();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    work_finished.wait(lock, [&] { return busy_workers == 0; });
+    current_job = nullptr;
+}
+
+void ThreadPool::RunJobs() {
+    for (size_t index = next_job++; index < num_jobs; index = next_job++)
+        (*current_job)(index);
+}
+
+void ThreadPool::WorkerLoop() {
+    SetCurrentThreadName("ThreadPoolWorker");
+
+    u64 last_batch_id = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_available.wait(lock, [&] { return shutting_down || batch_id != last_batch_id; });
+            if (shutting_down)
+                return;
+            last_batch_id = batch_id;
+        }
+
+        RunJobs();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --busy_workers;
+        }
+        work_finished.notify_one();
+    }
+}
+
+} // namespace
@@ -0,0 +1,70 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "common/common.h" // for NonCopyable
+#include "common/common_types.h"
+
+namespace Common {
+
+/**
+ * A fixed-size pool of worker threads used to process data-parallel work. Work is submitted as a
+ * range of independent jobs; the submitting thread participates in processing them and only
+ * returns once every job has finished.
+ */
+class ThreadPool : private NonCopyable {
+public:
+    /**
+     * Creates a pool which processes jobs on num_threads threads in total, including the thread
+     * calling ParallelFor. Hence, num_threads - 1 additional worker threads are spawned.
+     */
+    explicit ThreadPool(unsigned num_threads);
+    ~ThreadPool();
+
+    /// Returns the total number of threads processing jobs, including the submitting thread
+    unsigned NumThreads() const {
+        return static_cast<unsigned>(workers.size()) + 1;
+    }
+
+    /**
+     * Calls job(i) for each i in [0, num_jobs) and blocks until all of them have returned.
+     * Jobs are started in ascending order, but may run concurrently and finish in any order.
+     * @warning Must not be called concurrently from multiple threads or from within a job.
+     */
+    void ParallelFor(size_t num_jobs, const std::function<void(size_t)>& job);
+
+private:
+    void WorkerLoop();
+
+    /// Processes jobs of the current batch until none are left
+    void RunJobs();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_finished;
+
+    const std::function<void(size_t)>* current_job = nullptr;
+    size_t num_jobs = 0;
+    std::atomic<size_t> next_job;
+
+    /// Incremented for every submitted batch so that workers can tell batches apart
+    u64 batch_id = 0;
+
+    /// Number of workers which have not finished processing the current batch, yet
+    unsigned busy_workers = 0;
+
+    bool shutting_down = false;
+};
+
+} // namespace
@@ -145,6 +145,18 @@ struct ThreadQueueList {
         return cur->first == cur->end;
     }
 
+    inline bool empty() const {
+        const Queue *cur = first;
+        while (cur != invalid())
+        {
+            if (cur->end - cur->first > 0)
+                return false;
+            cur = cur->next;
+        }
+
+        return true;
+    }
+
     inline void prepare(u32 priority) {
         Queue *cur = &queues[priority];
         if (cur->next == nullptr)
@@ -0,0 +1,191 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <cstring>
+#include <vector>
+
+#include "common/common_types.h"
+
+namespace X64 {
+
+enum X64Reg {
+    RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+};
+
+enum XmmReg {
+    XMM0 = 0, XMM1, XMM2, XMM3, XMM4, XMM5,
+};
+
+enum CCFlags {
+    CC_O = 0x0, CC_NO = 0x1, CC_C = 0x2, CC_NC = 0x3,
+    CC_E = 0x4, CC_NE = 0x5, CC_BE = 0x6, CC_A = 0x7,
+    CC_S = 0x8, CC_NS = 0x9, CC_L = 0xC, CC_GE = 0xD,
+    CC_LE = 0xE, CC_G = 0xF,
+};
+
+#ifdef _WIN32
+static const X64Reg ABI_PARAM1 = RCX;
+static const X64Reg ABI_PARAM2 = RDX;
+static const X64Reg ABI_PARAM3 = R8;
+#else
+static const X64Reg ABI_PARAM1 = RDI;
+static const X64Reg ABI_PARAM2 = RSI;
+static const X64Reg ABI_PARAM3 = RDX;
+#endif
+
+/**
+ * Minimal emitter for the subset of x86-64 instructions used by the JIT compilers. Code is
+ * assembled into a growable buffer and only copied to executable memory once complete, hence all
+ * jump targets are expressed as offsets into the buffer.
+ */
+class X64Emitter {
+public:
+    size_t GetOffset() const {
+        return code.size();
+    }
+
+    const std::vector<u8>& GetCode() const {
+        return code;
+    }
+
+    void Write8(u8 value) {
+        code.push_back(value);
+    }
+
+    void Write32(u32 value) {
+        for (int i = 0; i < 4; ++i)
+            Write8(static_cast<u8>(value >> (8 * i)));
+    }
+
+    void Write64(u64 value) {
+        Write32(static_cast<u32>(value));
+        Write32(static_cast<u32>(value >> 32));
+    }
+
+    /// Points the rel32 operand at the given offset to target
+    void SetJumpTarget(size_t fixup, size_t target) {
+        u32 rel = static_cast<u32>(target - (fixup + 4));
+        memcpy(&code[fixup], &rel, sizeof(rel));
+    }
+
+    // SSE instructions
+    void MOVUPS(XmmReg dest, X64Reg base, s32 disp) { OpMem(0, false, 0x10, dest, base, disp); }
+    void MOVUPS(X64Reg base, s32 disp, XmmReg src) { OpMem(0, false, 0x11, src, base, disp); }
+    void MOVSS(X64Reg base, s32 disp, XmmReg src) { OpMem(0xF3, false, 0x11, src, base, disp); }
+    void MOVAPS(XmmReg dest, XmmReg src) { OpReg(0, false, 0x28, dest, src); }
+    void SHUFPS(XmmReg dest, XmmReg src, u8 shuffle) { OpReg(0, false, 0xC6, dest, src); Write8(shuffle); }
+    void PSHUFD(XmmReg dest, XmmReg src, u8 shuffle) { OpReg(0x66, false, 0x70, dest, src); Write8(shuffle); }
+    void ADDPS(XmmReg dest, XmmReg src) { OpReg(0, false, 0x58, dest, src); }
+    void MULPS(XmmReg dest, XmmReg src) { OpReg(0, false, 0x59, dest, src); }
+    void MAXPS(XmmReg dest, XmmReg src) { OpReg(0, false, 0x5F, dest, src); }
+    void XORPS(XmmReg dest, XmmReg src) { OpReg(0, false, 0x57, dest, src); }
+    void ADDSS(XmmReg dest, XmmReg src) { OpReg(0xF3, false, 0x58, dest, src); }
+    void CMPSS(XmmReg dest, XmmReg src, u8 predicate) { OpReg(0xF3, false, 0xC2, dest, src); Write8(predicate); }
+    void CVTSS2SD(XmmReg dest, XmmReg src) { OpReg(0xF3, false, 0x5A, dest, src); }
+    void CVTSD2SS(XmmReg dest, XmmReg src) { OpReg(0xF2, false, 0x5A, dest, src); }
+    void SQRTSD(XmmReg dest, XmmReg src) { OpReg(0xF2, false, 0x51, dest, src); }
+    void DIVSD(XmmReg dest, XmmReg src) { OpReg(0xF2, false, 0x5E, dest, src); }
+    void CVTTSS2SI(X64Reg dest, XmmReg src) { OpReg(0xF3, false, 0x2C, dest, src); }
+    void MOVD(XmmReg dest, X64Reg src) { OpReg(0x66, false, 0x6E, dest, src); }
+    void MOVD(X64Reg dest, XmmReg src) { OpReg(0x66, false, 0x7E, src, dest); }
+    void MOVQ(XmmReg dest, X64Reg src) { OpReg(0x66, true, 0x6E, dest, src); }
+
+    // Integer instructions
+    void MOV64(X64Reg dest, X64Reg base, s32 disp) { Rex(true, dest, base); Write8(0x8B); ModRMMem(dest, base, disp); }
+    void MOV32(X64Reg dest, X64Reg base, s32 disp) { Rex(false, dest, base); Write8(0x8B); ModRMMem(dest, base, disp); }
+    void MOV32(X64Reg base, s32 disp, X64Reg src) { Rex(false, src, base); Write8(0x89); ModRMMem(src, base, disp); }
+    void MOV32(X64Reg base, s32 disp, u32 imm) { Rex(false, 0, base); Write8(0xC7); ModRMMem(0, base, disp); Write32(imm); }
+    void MOV8(X64Reg base, s32 disp, X64Reg src) { Rex(false, src, base); Write8(0x88); ModRMMem(src, base, disp); }
+    void MOV8(X64Reg base, s32 disp, u8 imm) { Rex(false, 0, base); Write8(0xC6); ModRMMem(0, base, disp); Write8(imm); }
+    void MOVZX8(X64Reg dest, X64Reg base, s32 disp) { OpMem(0, false, 0xB6, dest, base, disp); }
+    void MOV64(X64Reg dest, X64Reg src) { Rex(true, src, dest); Write8(0x89); ModRMReg(src, dest); }
+    void MOV32(X64Reg dest, X64Reg src) { Rex(false, src, dest); Write8(0x89); ModRMReg(src, dest); }
+    void MOV64(X64Reg dest, u64 imm) { Rex(true, 0, dest); Write8(0xB8 + (dest & 7)); Write64(imm); }
+    void MOV32(X64Reg dest, u32 imm) { Rex(false, 0, dest); Write8(0xB8 + (dest & 7)); Write32(imm); }
+    void ADD32(X64Reg dest, X64Reg src) { Rex(false, src, dest); Write8(0x01); ModRMReg(src, dest); }
+    void OR32(X64Reg dest, X64Reg src) { Rex(false, src, dest); Write8(0x09); ModRMReg(src, dest); }
+    void ADC32(X64Reg dest, X64Reg src) { Rex(false, src, dest); Write8(0x11); ModRMReg(src, dest); }
+    void SBB32(X64Reg dest, X64Reg src) { Rex(false, src, dest); Write8(0x19); ModRMReg(src, dest); }
+    void AND32(X64Reg dest, X64Reg src) { Rex(false, src, dest); Write8(0x21); ModRMReg(src, dest); }
+    void SUB32(X64Reg dest, X64Reg src) { Rex(false, src, dest); Write8(0x29); ModRMReg(src, dest); }
+    void XOR32(X64Reg dest, X64Reg src) { Rex(false, src, dest); Write8(0x31); ModRMReg(src, dest); }
+    void TEST32(X64Reg dest, X64Reg src) { Rex(false, src, dest); Write8(0x85); ModRMReg(src, dest); }
+    void ADD32(X64Reg dest, u32 imm) { Rex(false, 0, dest); Write8(0x81); ModRMReg(0, dest); Write32(imm); }
+    void AND32(X64Reg dest, s8 imm) { Rex(false, 0, dest); Write8(0x83); ModRMReg(4, dest); Write8(imm); }
+    void XOR32(X64Reg dest, s8 imm) { Rex(false, 0, dest); Write8(0x83); ModRMReg(6, dest); Write8(imm); }
+    void NOT32(X64Reg dest) { Rex(false, 0, dest); Write8(0xF7); ModRMReg(2, dest); }
+    void ROR32(X64Reg dest, u8 shift) { Rex(false, 0, dest); Write8(0xC1); ModRMReg(1, dest); Write8(shift); }
+    void SHL32(X64Reg dest, u8 shift) { Rex(false, 0, dest); Write8(0xC1); ModRMReg(4, dest); Write8(shift); }
+    void SHR32(X64Reg dest, u8 shift) { Rex(false, 0, dest); Write8(0xC1); ModRMReg(5, dest); Write8(shift); }
+    void SAR32(X64Reg dest, u8 shift) { Rex(false, 0, dest); Write8(0xC1); ModRMReg(7, dest); Write8(shift); }
+    void ADD64(X64Reg dest, s8 imm) { Rex(true, 0, dest); Write8(0x83); ModRMReg(0, dest); Write8(imm); }
+    void SUB64(X64Reg dest, s8 imm) { Rex(true, 0, dest); Write8(0x83); ModRMReg(5, dest); Write8(imm); }
+    void CMP8(X64Reg base, s32 disp, u8 imm) { Rex(false, 0, base); Write8(0x80); ModRMMem(7, base, disp); Write8(imm); }
+    void BT32(X64Reg base, s32 disp, u8 bit) { OpMem(0, false, 0xBA, 4, base, disp); Write8(bit); }
+    void SETcc(CCFlags cc, X64Reg base, s32 disp) { OpMem(0, false, 0x90 + cc, 0, base, disp); }
+    void CMC() { Write8(0xF5); }
+    void PUSH(X64Reg reg) { Rex(false, 0, reg); Write8(0x50 + (reg & 7)); }
+    void POP(X64Reg reg) { Rex(false, 0, reg); Write8(0x58 + (reg & 7)); }
+
+    // Control flow. The rel32 variants return the offset of the operand to patch.
+    void CALL(X64Reg reg) { Rex(false, 0, reg); Write8(0xFF); ModRMReg(2, reg); }
+    size_t CALL() { Write8(0xE8); return Rel32(); }
+    size_t JMP() { Write8(0xE9); return Rel32(); }
+    size_t J_CC(CCFlags cc) { Write8(0x0F); Write8(0x80 + cc); return Rel32(); }
+    void RET() { Write8(0xC3); }
+
+private:
+    void Rex(bool w, int reg, int rm) {
+        u8 rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((rm & 8) ? 1 : 0);
+        if (rex != 0x40)
+            Write8(rex);
+    }
+
+    void ModRMReg(int reg, int rm) {
+        Write8(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    void ModRMMem(int reg, int base, s32 disp) {
+        // Mod 0 with an RBP/R13 base would denote RIP-relative addressing instead
+        int mod = (disp == 0 && (base & 7) != RBP) ? 0 : (disp >= -128 && disp <= 127) ? 1 : 2;
+        Write8((mod << 6) | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP)
+            Write8(0x24); // SIB byte without index
+        if (mod == 1)
+            Write8(static_cast<u8>(disp));
+        else if (mod == 2)
+            Write32(disp);
+    }
+
+    void OpMem(u8 prefix, bool w, u8 opcode, int reg, X64Reg base, s32 disp) {
+        if (prefix)
+            Write8(prefix);
+        Rex(w, reg, base);
+        Write8(0x0F);
+        Write8(opcode);
+        ModRMMem(reg, base, disp);
+    }
+
+    void OpReg(u8 prefix, bool w, u8 opcode, int reg, int rm) {
+        if (prefix)
+            Write8(prefix);
+        Rex(w, reg, rm);
+        Write8(0x0F);
+        Write8(opcode);
+        ModRMReg(reg, rm);
+    }
+
+    size_t Rel32() {
+        size_t fixup = GetOffset();
+        Write32(0);
+        return fixup;
+    }
+
+    std::vector<u8> code;
+};
+
+} // namespace X64
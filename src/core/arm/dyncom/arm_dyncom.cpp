@@ -8,12 +8,13 @@
 
 #include "core/arm/dyncom/arm_dyncom.h"
 #include "core/arm/dyncom/arm_dyncom_interpreter.h"
+#include "core/arm/dyncom/arm_dyncom_jit_x64.h"
 
 const static cpu_config_t s_arm11_cpu_info = {
     "armv6", "arm11", 0x0007b000, 0x0007f000, NONCACHE
 };
 
-ARM_DynCom::ARM_DynCom() : ticks(0) {
+ARM_DynCom::ARM_DynCom(bool use_jit) : ticks(0), use_jit(use_jit) {
     state = std::unique_ptr<ARMul_State>(new ARMul_State);
 
     ARMul_EmulateInit();
@@ -85,6 +86,12 @@ void ARM_DynCom::ExecuteInstructions(int num_instructions) {
     // Dyncom only breaks on instruction dispatch. This only happens on every instruction when
     // executing one instruction at a time. Otherwise, if a block is being executed, more
     // instructions may actually be executed than specified.
+#ifdef ARM_JIT_X64
+    if (use_jit) {
+        ticks += JitMainLoop(state.get());
+        return;
+    }
+#endif
     ticks += InterpreterMainLoop(state.get());
 }
 
@@ -14,7 +14,12 @@
 class ARM_DynCom final : virtual public ARM_Interface {
 public:
 
-    ARM_DynCom();
+    /**
+     * Creates a DynCom CPU core
+     * @param use_jit Whether ARM code is compiled to x86-64 code rather than interpreted, this is
+     *                ignored on other platforms
+     */
+    ARM_DynCom(bool use_jit = false);
     ~ARM_DynCom();
 
     /**
@@ -92,5 +97,6 @@ private:
 
     std::unique_ptr<ARMul_State> state;
     u64 ticks;
+    bool use_jit;
 
 };
@@ -2,6 +2,8 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <vector>
+
 #include "core/arm/skyeye_common/arm_regformat.h"
 #include "core/arm/skyeye_common/armdefs.h"
 #include "core/arm/dyncom/arm_dyncom_dec.h"
@@ -397,56 +399,93 @@ const ISEITEM arm_exclusion_code[] = {
     { "invalid", 0, INVALID, 0 }
 };
 
-int decode_arm_instr(uint32_t instr, int32_t *idx) {
-    int n = 0;
+// Checks an instruction against the encoding arm_instruction[i], excluding the encodings in
+// arm_exclusion_code[i]
+static bool matches_encoding(uint32_t instr, int i) {
+    int n = arm_instruction[i].attribute_value;
     int base = 0;
-    int ret = DECODE_FAILURE;
-    int i = 0;
-    int instr_slots = sizeof(arm_instruction) / sizeof(ISEITEM);
-
-    for (i = 0; i < instr_slots; i++) {
-        n = arm_instruction[i].attribute_value;
-        base = 0;
 
-        while (n) {
-            if (arm_instruction[i].content[base + 1] == 31 && arm_instruction[i].content[base] == 0) {
-                // clrex
-                if (instr != arm_instruction[i].content[base + 2]) {
-                    break;
-                }
-            } else if (BITS(arm_instruction[i].content[base], arm_instruction[i].content[base + 1]) != arm_instruction[i].content[base + 2]) {
-                break;
+    while (n) {
+        if (arm_instruction[i].content[base + 1] == 31 && arm_instruction[i].content[base] == 0) {
+            // clrex
+            if (instr != arm_instruction[i].content[base + 2]) {
+                return false;
             }
-            base += 3;
-            n--;
+        } else if (BITS(arm_instruction[i].content[base], arm_instruction[i].content[base + 1]) != arm_instruction[i].content[base + 2]) {
+            return false;
         }
+        base += 3;
+        n--;
+    }
 
-        // All conditions is satisfied.
-        if (n == 0)
-            ret = DECODE_SUCCESS;
+    n = arm_exclusion_code[i].attribute_value;
+    if (n == 0)
+        return true;
 
-        if (ret == DECODE_SUCCESS) {
-            n = arm_exclusion_code[i].attribute_value;
-            if (n != 0) {
-                base = 0;
-                while (n) {
-                    if (BITS(arm_exclusion_code[i].content[base], arm_exclusion_code[i].content[base + 1]) != arm_exclusion_code[i].content[base + 2]) {
-                        break;
-                    }
-                    base += 3;
-                    n--;
-                }
+    base = 0;
+    while (n) {
+        if (BITS(arm_exclusion_code[i].content[base], arm_exclusion_code[i].content[base + 1]) != arm_exclusion_code[i].content[base + 2]) {
+            return true;
+        }
+        base += 3;
+        n--;
+    }
+    return false;
+}
 
-                // All conditions is satisfied.
-                if (n == 0)
-                    ret = DECODE_FAILURE;
-            }
+// Testing every encoding in arm_instruction in turn is slow, so the encodings are grouped by bits
+// 20-27 and 4-7 of the instructions they can match, which tell most instructions apart. Decoding
+// then only tests the encodings in the group of the instruction. Thumb code benefits just the
+// same, as it's decoded as the ARM instructions it translates to.
+static const uint32_t DECODE_KEY_MASK = 0x0FF000F0;
+static const int DECODE_KEY_COUNT = 1 << 12;
+
+static int decode_key(uint32_t instr) {
+    return (BITS(20, 27) << 4) | BITS(4, 7);
+}
+
+// Indices into arm_instruction of the encodings which may match the instructions with each key.
+// These are kept in the order of arm_instruction, as the first matching encoding is the one used.
+static std::vector<u16> decode_candidates[DECODE_KEY_COUNT];
+static bool decode_candidates_built = false;
+
+// Checks whether arm_instruction[i] may match an instruction with the given key bits, only looking
+// at the bits which are part of the key
+static bool may_match_key(uint32_t key_bits, int i) {
+    const ISEITEM& item = arm_instruction[i];
+    for (int n = 0, base = 0; n < item.attribute_value; n++, base += 3) {
+        const u32 lo = item.content[base];
+        const u32 hi = item.content[base + 1];
+        const u32 field_mask = (hi - lo == 31) ? 0xFFFFFFFF : ((1u << (hi - lo + 1)) - 1) << lo;
+
+        if (((item.content[base + 2] << lo) ^ key_bits) & field_mask & DECODE_KEY_MASK)
+            return false;
+    }
+    return true;
+}
+
+static void build_decode_candidates() {
+    const int instr_slots = sizeof(arm_instruction) / sizeof(ISEITEM);
+
+    for (int key = 0; key < DECODE_KEY_COUNT; key++) {
+        const uint32_t key_bits = ((key >> 4) << 20) | ((key & 0xF) << 4);
+        for (int i = 0; i < instr_slots; i++) {
+            if (may_match_key(key_bits, i))
+                decode_candidates[key].push_back(i);
         }
+    }
+    decode_candidates_built = true;
+}
+
+int decode_arm_instr(uint32_t instr, int32_t *idx) {
+    if (!decode_candidates_built)
+        build_decode_candidates();
 
-        if (ret == DECODE_SUCCESS) {
+    for (u16 i : decode_candidates[decode_key(instr)]) {
+        if (matches_encoding(instr, i)) {
             *idx = i;
-            return ret;
+            return DECODE_SUCCESS;
         }
     }
-    return ret;
+    return DECODE_FAILURE;
 }
@@ -5,7 +5,8 @@
 #define CITRA_IGNORE_EXIT(x)
 
 #include <algorithm>
-#include <unordered_map>
+#include <array>
+#include <memory>
 #include <stdio.h>
 #include <assert.h>
 #include <cstdio>
@@ -15,13 +16,16 @@ using namespace std;
 
 #include "core/arm/skyeye_common/armdefs.h"
 #include "core/arm/skyeye_common/armmmu.h"
+#include "core/arm/dyncom/arm_dyncom_interpreter.h"
 #include "arm_dyncom_thumb.h"
 #include "arm_dyncom_run.h"
 #include "core/arm/skyeye_common/vfp/vfp.h"
 #include "core/arm/disassembler/arm_disasm.h"
 
+#include "core/core_timing.h"
 #include "core/mem_map.h"
 #include "core/hle/hle.h"
+#include "core/settings.h"
 
 enum {
     COND = (1 << 0),
@@ -686,6 +690,7 @@ typedef struct _arm_inst {
     unsigned int cond;
     int br;
     int load_r15;
+    int stale_flags; // An earlier instruction in the block skipped its flag updates, see drop_dead_flag_updates
     char component[0];
 } arm_inst;
 
@@ -743,11 +748,21 @@ typedef struct _eor_inst {
     shtop_fp_t shtop_func;
 } eor_inst;
 
+// Translated block which a direct branch continues with. This is remembered in the branch, such
+// that taking it again doesn't require looking up the block.
+typedef struct _block_link {
+    int block;                  // Offset of the block in inst_buf, or -1 if not linked yet
+    unsigned int generation;    // Value of link_generation when the link was made
+} block_link;
+
 typedef struct _bbl_inst {
     unsigned int L;
     int signed_immed_24;
     unsigned int next_addr;
     unsigned int jmp_addr;
+    block_link taken;
+    block_link not_taken;
+    bool idle_loop;             // The branch closes a loop which only polls memory, see IsIdleLoop
 } bbl_inst;
 
 typedef struct _bx_inst {
@@ -1100,10 +1115,13 @@ typedef struct _swp_inst {
 
 typedef struct _b_2_thumb {
     unsigned int imm;
+    block_link taken;
 }b_2_thumb;
 typedef struct _b_cond_thumb {
     unsigned int imm;
     unsigned int cond;
+    block_link taken;
+    block_link not_taken;
 }b_cond_thumb;
 
 typedef struct _bl_1_thumb {
@@ -1126,13 +1144,20 @@ typedef struct _pkh_inst {
 
 typedef arm_inst * ARM_INST_PTR;
 
-#define CACHE_BUFFER_SIZE    (64 * 1024 * 2000)
-char inst_buf[CACHE_BUFFER_SIZE];
+// Translated instructions are allocated one after another from inst_buf. Blocks never cross a
+// page, so they consist of at most one instruction per halfword of a page. Once more than
+// inst_buf_size bytes are in use, all blocks are dropped before translating the next one (see
+// InterpreterTranslate), and the remaining MAX_BLOCK_SIZE bytes ensure that every block fits.
+#define MAX_INST_SIZE        64
+#define MAX_BLOCK_SIZE       (4096 / 2 * MAX_INST_SIZE)
+static char* inst_buf = nullptr;
+static int inst_buf_size = 0;
 int top = 0;
 inline void *AllocBuffer(unsigned int size) {
+    _dbg_assert_msg_(Core_ARM11, size <= MAX_INST_SIZE, "Translated instruction too large");
     int start = top;
     top += size;
-    if (top > CACHE_BUFFER_SIZE) {
+    if (top > inst_buf_size + MAX_BLOCK_SIZE) {
         LOG_ERROR(Core_ARM11, "inst_buf is full");
         CITRA_IGNORE_EXIT(-1);
     }
@@ -1373,6 +1398,9 @@ ARM_INST_PTR INTERPRETER_TRANSLATE(bbl)(unsigned int inst, int index)
 
     inst_cream->L      = BIT(inst, 24);
     inst_cream->signed_immed_24 = BIT(inst, 23) ? NEGBRANCH : POSBRANCH;
+    inst_cream->taken.block = -1;
+    inst_cream->not_taken.block = -1;
+    inst_cream->idle_loop = false;
 
     return inst_base;
 }
@@ -3105,6 +3133,7 @@ ARM_INST_PTR INTERPRETER_TRANSLATE(b_2_thumb)(unsigned int tinst, int index)
     b_2_thumb *inst_cream = (b_2_thumb *)inst_base->component;
 
     inst_cream->imm   = ((tinst & 0x3FF) << 1) | ((tinst & (1 << 10)) ? 0xFFFFF800 : 0);
+    inst_cream->taken.block = -1;
 
     inst_base->idx    = index;
     inst_base->br     = DIRECT_BRANCH;
@@ -3119,6 +3148,8 @@ ARM_INST_PTR INTERPRETER_TRANSLATE(b_cond_thumb)(unsigned int tinst, int index)
 
     inst_cream->imm   = (((tinst & 0x7F) << 1) | ((tinst & (1 << 7)) ?    0xFFFFFF00 : 0));
     inst_cream->cond  = ((tinst >> 8) & 0xf);
+    inst_cream->taken.block = -1;
+    inst_cream->not_taken.block = -1;
     inst_base->idx    = index;
     inst_base->br     = DIRECT_BRANCH;
 
@@ -3463,24 +3494,214 @@ const transop_fp_t arm_instruction_trans[] = {
     INTERPRETER_TRANSLATE(blx_1_thumb)
 };
 
-typedef std::unordered_map<u32, int> bb_map;
-bb_map CreamCache;
+// Offsets of translated blocks in inst_buf, indexed by the page of their start address and the
+// halfword within that page. The tables for each page are allocated when the first block in the
+// page is translated.
+#define BLOCK_PAGE_BITS                 12
+typedef std::array<int, (1 << BLOCK_PAGE_BITS) / 2> block_page;
+static std::unique_ptr<block_page> block_table[1 << (32 - BLOCK_PAGE_BITS)];
+
+// Incremented whenever translated blocks are dropped, which invalidates all block links
+static unsigned int link_generation = 0;
 
 void insert_bb(unsigned int addr, int start) {
-    CreamCache[addr] = start;
+    std::unique_ptr<block_page>& page = block_table[addr >> BLOCK_PAGE_BITS];
+    if (!page) {
+        page.reset(new block_page);
+        page->fill(-1);
+
+        // Guest writes to the page have to drop the blocks translated from it
+        Memory::SetCodePageWriteTracking(addr, Memory::TRACK_CODE, true);
+    }
+    (*page)[(addr & ((1 << BLOCK_PAGE_BITS) - 1)) >> 1] = start;
 }
 
 #define TRANS_THRESHOLD                 65000
 int find_bb(unsigned int addr, int &start) {
-    int ret = -1;
-    bb_map::const_iterator it = CreamCache.find(addr);
-    if (it != CreamCache.end()) {
-        start = static_cast<int>(it->second);
-        ret = 0;
-    } else {
-        ret = -1;
+    const block_page* page = block_table[addr >> BLOCK_PAGE_BITS].get();
+    if (page == nullptr)
+        return -1;
+
+    int block = (*page)[(addr & ((1 << BLOCK_PAGE_BITS) - 1)) >> 1];
+    if (block == -1)
+        return -1;
+
+    start = block;
+    return 0;
+}
+
+// NZCV flags, as tracked by drop_dead_flag_updates
+enum {
+    FLAG_N = (1 << 3),
+    FLAG_Z = (1 << 2),
+    FLAG_C = (1 << 1),
+    FLAG_V = (1 << 0),
+    FLAGS_NZCV = FLAG_N | FLAG_Z | FLAG_C | FLAG_V
+};
+
+// How a translated instruction uses the flags
+typedef struct _flag_usage {
+    arm_inst* inst;
+    unsigned int* s_bit;  // S bit of the instruction, if clearing it drops all its flag updates
+    unsigned int read;    // Flags read by the instruction
+    unsigned int written; // Flags which the instruction may update
+    unsigned int killed;  // Flags which the instruction always overwrites with new values
+} flag_usage;
+
+// Flags read by the condition of an instruction
+static unsigned int cond_flags(unsigned int cond) {
+    switch (cond) {
+    case 0x0: case 0x1: return FLAG_Z;
+    case 0x2: case 0x3: return FLAG_C;
+    case 0x4: case 0x5: return FLAG_N;
+    case 0x6: case 0x7: return FLAG_V;
+    case 0x8: case 0x9: return FLAG_C | FLAG_Z;
+    case 0xA: case 0xB: return FLAG_N | FLAG_V;
+    case 0xC: case 0xD: return FLAG_N | FLAG_Z | FLAG_V;
+    default:            return 0;
+    }
+}
+
+// Determines how a translated ARM instruction uses the flags. Instructions which aren't known to
+// leave the flags alone are treated as reading all of them.
+static flag_usage get_flag_usage(arm_inst* inst_base, unsigned int inst, int idx) {
+    static const transop_fp_t no_flags[] = {
+        INTERPRETER_TRANSLATE(ldr), INTERPRETER_TRANSLATE(ldrcond), INTERPRETER_TRANSLATE(ldrb),
+        INTERPRETER_TRANSLATE(ldrh), INTERPRETER_TRANSLATE(ldrsb), INTERPRETER_TRANSLATE(ldrsh),
+        INTERPRETER_TRANSLATE(ldrd), INTERPRETER_TRANSLATE(ldm), INTERPRETER_TRANSLATE(str),
+        INTERPRETER_TRANSLATE(strb), INTERPRETER_TRANSLATE(strh), INTERPRETER_TRANSLATE(strd),
+        INTERPRETER_TRANSLATE(stm), INTERPRETER_TRANSLATE(bbl), INTERPRETER_TRANSLATE(bx),
+        INTERPRETER_TRANSLATE(blx), INTERPRETER_TRANSLATE(pld), INTERPRETER_TRANSLATE(clz),
+        INTERPRETER_TRANSLATE(rev), INTERPRETER_TRANSLATE(uxtb), INTERPRETER_TRANSLATE(uxth),
+        INTERPRETER_TRANSLATE(sxtb), INTERPRETER_TRANSLATE(sxth), INTERPRETER_TRANSLATE(uxtab),
+        INTERPRETER_TRANSLATE(uxtah), INTERPRETER_TRANSLATE(sxtab), INTERPRETER_TRANSLATE(sxtah),
+    };
+    static const transop_fp_t arithmetic[] = {
+        INTERPRETER_TRANSLATE(add), INTERPRETER_TRANSLATE(adc), INTERPRETER_TRANSLATE(sub),
+        INTERPRETER_TRANSLATE(sbc), INTERPRETER_TRANSLATE(rsb), INTERPRETER_TRANSLATE(rsc),
+        INTERPRETER_TRANSLATE(cmp), INTERPRETER_TRANSLATE(cmn),
+    };
+    static const transop_fp_t logical[] = {
+        INTERPRETER_TRANSLATE(and), INTERPRETER_TRANSLATE(eor), INTERPRETER_TRANSLATE(orr),
+        INTERPRETER_TRANSLATE(bic), INTERPRETER_TRANSLATE(mov), INTERPRETER_TRANSLATE(mvn),
+        INTERPRETER_TRANSLATE(tst), INTERPRETER_TRANSLATE(teq),
+    };
+
+    flag_usage usage = { inst_base, nullptr, cond_flags(inst_base->cond), 0, 0 };
+    const transop_fp_t trans = arm_instruction_trans[idx];
+
+    if (std::find(std::begin(no_flags), std::end(no_flags), trans) != std::end(no_flags))
+        return usage;
+
+    const bool is_arithmetic = std::find(std::begin(arithmetic), std::end(arithmetic), trans) != std::end(arithmetic);
+    const bool is_logical = std::find(std::begin(logical), std::end(logical), trans) != std::end(logical);
+    if (!is_arithmetic && !is_logical) {
+        usage.read = FLAGS_NZCV;
+        return usage;
     }
-    return ret;
+
+    // The value of RRX shifted operands, ADC, SBC and RSC read the carry flag
+    if (!BIT(inst, 25) && BITS(inst, 4, 11) == 0x06)
+        usage.read |= FLAG_C;
+    if (trans == INTERPRETER_TRANSLATE(adc) || trans == INTERPRETER_TRANSLATE(sbc) ||
+        trans == INTERPRETER_TRANSLATE(rsc))
+        usage.read |= FLAG_C;
+
+    const bool is_test = trans == INTERPRETER_TRANSLATE(cmp) || trans == INTERPRETER_TRANSLATE(cmn) ||
+                         trans == INTERPRETER_TRANSLATE(tst) || trans == INTERPRETER_TRANSLATE(teq);
+    if (!is_test && !BIT(inst, 20))
+        return usage;
+
+    // Writing R15 with the S bit set restores the CPSR
+    if (!is_test && BITS(inst, 12, 15) == 15) {
+        usage.read = FLAGS_NZCV;
+        return usage;
+    }
+
+    // The shifter carry out of logical instructions may be the current carry flag, so they only
+    // overwrite N and Z for certain
+    usage.written = is_arithmetic ? FLAGS_NZCV : (FLAG_N | FLAG_Z | FLAG_C);
+    if (inst_base->cond == 0xE)
+        usage.killed = is_arithmetic ? FLAGS_NZCV : (FLAG_N | FLAG_Z);
+
+    // All data processing instructions other than the tests keep the S bit after I
+    if (!is_test)
+        usage.s_bit = reinterpret_cast<unsigned int*>(inst_base->component) + 1;
+
+    return usage;
+}
+
+// Clears the S bit of instructions whose flag updates are overwritten before anything reads them,
+// assuming that all flags are read after the block. The flags are stale until they are
+// overwritten, so the instructions in between are marked as ones to not stop execution before.
+static void drop_dead_flag_updates(std::vector<flag_usage>& block) {
+    unsigned int live = FLAGS_NZCV;
+    for (auto it = block.rbegin(); it != block.rend(); ++it) {
+        if (it->s_bit != nullptr && !(it->written & live)) {
+            *it->s_bit = 0;
+            it->killed = 0;
+        } else {
+            it->written = 0;
+        }
+        live = (live & ~it->killed) | it->read;
+    }
+
+    unsigned int stale = 0;
+    for (flag_usage& usage : block) {
+        usage.inst->stale_flags = stale != 0;
+        stale = (stale & ~usage.killed) | usage.written;
+    }
+}
+
+bool IsIdleLoop(u32 start, u32 branch_addr) {
+    // Limits the search to short loops, which are the common polling loops
+    static const u32 MAX_IDLE_LOOP_INSTRUCTIONS = 8;
+
+    if (branch_addr < start || (branch_addr - start) / 4 >= MAX_IDLE_LOOP_INSTRUCTIONS)
+        return false;
+
+    // The loop has to be closed by a B (not BL) back to its start
+    const u32 branch = Memory::FastRead32(branch_addr);
+    if (BITS(branch, 28, 31) == 0xF || BITS(branch, 24, 27) != 0xA)
+        return false;
+    const u32 offset = (BITS(branch, 0, 23) ^ 0x800000) - 0x800000;
+    if (branch_addr + 8 + (offset << 2) != start)
+        return false;
+
+    // Other than that, the loop may only load into registers and compare. Loads may not write back
+    // their base, and the registers they load are not used for addressing, so each iteration reads
+    // the same memory and leaves the registers just like the last one did.
+    u32 loaded = 0;
+    u32 addressing = 0;
+    for (u32 addr = start; addr != branch_addr; addr += 4) {
+        const u32 inst = Memory::FastRead32(addr);
+        if (BITS(inst, 28, 31) == 0xF)
+            return false;
+
+        const bool is_load = BIT(inst, 20) && BIT(inst, 24) && !BIT(inst, 21);
+        if (BITS(inst, 26, 27) == 1 && is_load && !(BIT(inst, 25) && BIT(inst, 4))) {
+            // LDR and LDRB with an immediate or (shifted) register offset
+            if (BIT(inst, 25))
+                addressing |= 1 << BITS(inst, 0, 3);
+        } else if (BITS(inst, 25, 27) == 0 && BIT(inst, 7) && BIT(inst, 4) && BITS(inst, 5, 6) != 0 && is_load) {
+            // LDRH, LDRSB and LDRSH with an immediate or register offset
+            if (!BIT(inst, 22))
+                addressing |= 1 << BITS(inst, 0, 3);
+        } else if (BITS(inst, 26, 27) == 0 && BITS(inst, 23, 24) == 2 && BIT(inst, 20) &&
+                   !(!BIT(inst, 25) && BIT(inst, 7) && BIT(inst, 4))) {
+            // TST, TEQ, CMP and CMN
+            continue;
+        } else {
+            return false;
+        }
+
+        if (BITS(inst, 12, 15) == 15)
+            return false;
+        loaded |= 1 << BITS(inst, 12, 15);
+        addressing |= 1 << BITS(inst, 16, 19);
+    }
+
+    return (loaded & addressing) == 0;
 }
 
 enum {
@@ -3552,34 +3773,47 @@ typedef struct instruction_set_encoding_item ISEITEM;
 
 extern const ISEITEM arm_instruction[];
 
-vector<uint64_t> code_page_set;
-
 void flush_bb(uint32_t addr) {
-    bb_map::iterator it;
-    uint32_t start;
+    std::unique_ptr<block_page>& page = block_table[addr >> BLOCK_PAGE_BITS];
+    if (!page)
+        return;
 
-    addr  &= 0xfffff000;
-    for (it = CreamCache.begin(); it != CreamCache.end(); ) {
-        start = static_cast<uint32_t>(it->first);
-        start &= 0xfffff000;
-        if (start == addr) {
-            CreamCache.erase(it++);
-        } else
-            ++it;
-    }
+    page.reset();
+    link_generation++;
+    Memory::SetCodePageWriteTracking(addr, Memory::TRACK_CODE, false);
+}
+
+// Drops all translated blocks, such that inst_buf can be reused from the start
+static void flush_all_bb() {
+    for (u32 page = 0; page < ARRAY_SIZE(block_table); ++page)
+        flush_bb(page << BLOCK_PAGE_BITS);
+    top = 0;
+}
+
+void InterpreterInvalidateCodePage(u32 addr) {
+    flush_bb(addr);
 }
 
 int InterpreterTranslate(arm_processor *cpu, int &bb_start, addr_t addr) {
     // Decode instruction, get index
     // Allocate memory and init InsCream
     // Go on next, until terminal instruction
-    // Save start addr of basicblock in CreamCache
+    // Save start addr of basicblock in the block table
     ARM_INST_PTR inst_base = nullptr;
     unsigned int inst, inst_size = 4;
     int idx;
     int ret = NON_BRANCH;
     int thumb = 0;
     int size = 0; // instruction size of basic block
+
+    if (inst_buf == nullptr) {
+        inst_buf_size = Settings::values.translation_cache_size * 1024 * 1024;
+        inst_buf = new char[inst_buf_size + MAX_BLOCK_SIZE];
+    } else if (top > inst_buf_size) {
+        LOG_DEBUG(Core_ARM11, "Translation cache is full, dropping all translated blocks");
+        flush_all_bb();
+    }
+
     bb_start = top;
 
     if (cpu->TFlag)
@@ -3588,8 +3822,11 @@ int InterpreterTranslate(arm_processor *cpu, int &bb_start, addr_t addr) {
     addr_t phys_addr = addr;
     addr_t pc_start = cpu->Reg[15];
 
+    static std::vector<flag_usage> block_flag_usage;
+    block_flag_usage.clear();
+
     while(ret == NON_BRANCH) {
-        inst = Memory::Read32(phys_addr & 0xFFFFFFFC);
+        inst = Memory::FastRead32(phys_addr & 0xFFFFFFFC);
 
         size++;
         // If we are in thumb instruction, we will translate one thumb to one corresponding arm instruction
@@ -3600,6 +3837,8 @@ int InterpreterTranslate(arm_processor *cpu, int &bb_start, addr_t addr) {
 
             // We have translated the branch instruction of thumb in thumb decoder
             if(state == t_branch){
+                flag_usage usage = { inst_base, nullptr, FLAGS_NZCV, 0, 0 };
+                block_flag_usage.push_back(usage);
                 goto translated;
             }
             inst = arm_inst;
@@ -3613,6 +3852,7 @@ int InterpreterTranslate(arm_processor *cpu, int &bb_start, addr_t addr) {
             CITRA_IGNORE_EXIT(-1);
         }
         inst_base = arm_instruction_trans[idx](inst, idx);
+        block_flag_usage.push_back(get_flag_usage(inst_base, inst, idx));
 translated:
         phys_addr += inst_size;
 
@@ -3621,6 +3861,13 @@ translated:
         }
         ret = inst_base->br;
     };
+    drop_dead_flag_updates(block_flag_usage);
+
+    // A block which branches back to its start may be a polling loop. The branch is the last
+    // instruction translated, as the block ended at it.
+    if (!cpu->TFlag && IsIdleLoop(pc_start, phys_addr - 4))
+        reinterpret_cast<bbl_inst*>(inst_base->component)->idle_loop = true;
+
     insert_bb(pc_start, bb_start);
     return KEEP_GOING;
 }
@@ -3666,16 +3913,31 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
 
     #define INC_PC(l) ptr += sizeof(arm_inst) + l
 
+    // Continues with the block linked to a direct branch, whose target is already in R15. If the
+    // block hasn't been linked yet or interrupts are pending, it is looked up in DISPATCH instead
+    // and linked afterwards.
+    #define GOTO_LINKED_BLOCK(link) \
+        if ((link).block != -1 && (link).generation == link_generation && cpu->NirqSig) { \
+            ptr = (link).block; \
+            inst_base = (arm_inst *)&inst_buf[ptr]; \
+            GOTO_NEXT_INST; \
+        } \
+        pending_link = &(link); \
+        goto DISPATCH
+
+// Execution only stops before instructions at which the flags are up to date, so it may run a few
+// instructions past NumInstrsToExecute (see drop_dead_flag_updates).
+//
 // GCC and Clang have a C++ extension to support a lookup table of labels. Otherwise, fallback to a
 // clunky switch statement.
 #if defined __GNUC__ || defined __clang__
 #define GOTO_NEXT_INST \
-    if (num_instrs >= cpu->NumInstrsToExecute) goto END; \
+    if (num_instrs >= cpu->NumInstrsToExecute && !inst_base->stale_flags) goto END; \
     num_instrs++; \
     goto *InstLabel[inst_base->idx]
 #else
 #define GOTO_NEXT_INST \
-    if (num_instrs >= cpu->NumInstrsToExecute) goto END; \
+    if (num_instrs >= cpu->NumInstrsToExecute && !inst_base->stale_flags) goto END; \
     num_instrs++; \
     switch(inst_base->idx) { \
     case 0: goto VMLA_INST; \
@@ -3950,6 +4212,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
     static unsigned int last_physical_base = 0, last_logical_base = 0;
     int ptr;
     bool single_step = (cpu->NumInstrsToExecute == 1);
+    block_link* pending_link = nullptr;
 
     LOAD_NZCVT;
     DISPATCH:
@@ -3967,9 +4230,20 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
 
         phys_addr = cpu->Reg[15];
 
-        if (find_bb(cpu->Reg[15], ptr) == -1)
+        if (find_bb(cpu->Reg[15], ptr) == -1) {
+            // The block which the pending link belongs to is gone if translating flushed the cache
+            const unsigned int generation = link_generation;
             if (InterpreterTranslate(cpu, ptr, cpu->Reg[15]) == FETCH_EXCEPTION)
                 goto END;
+            if (generation != link_generation)
+                pending_link = nullptr;
+        }
+
+        if (pending_link != nullptr) {
+            pending_link->block = ptr;
+            pending_link->generation = link_generation;
+            pending_link = nullptr;
+        }
 
         inst_base = (arm_inst *)&inst_buf[ptr];
         GOTO_NEXT_INST;
@@ -4066,18 +4340,22 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
     }
     BBL_INST:
     {
+        bbl_inst *inst_cream = (bbl_inst *)inst_base->component;
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
-            bbl_inst *inst_cream = (bbl_inst *)inst_base->component;
             if (inst_cream->L) {
                 LINK_RTN_ADDR;
             }
             SET_PC;
-            INC_PC(sizeof(bbl_inst));
-            goto DISPATCH;
+            // Polling the same memory again won't give a different result before the next event
+            // fires, so skip ahead to it
+            if (inst_cream->idle_loop) {
+                CoreTiming::Idle();
+                goto END;
+            }
+            GOTO_LINKED_BLOCK(inst_cream->taken);
         }
         cpu->Reg[15] += GET_INST_SIZE(cpu);
-        INC_PC(sizeof(bbl_inst));
-        goto DISPATCH;
+        GOTO_LINKED_BLOCK(inst_cream->not_taken);
     }
     BIC_INST:
     {
@@ -4336,28 +4614,28 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
             if (BIT(inst, 22) && !BIT(inst, 15)) {
                 for (int i = 0; i < 13; i++) {
                     if(BIT(inst, i)) {
-                        cpu->Reg[i] = Memory::Read32(addr);
+                        cpu->Reg[i] = Memory::FastRead32(addr);
                         addr += 4;
                     }
                 }
                 if (BIT(inst, 13)) {
                     if (cpu->Mode == USER32MODE) 
-                        cpu->Reg[13] = Memory::Read32(addr);
+                        cpu->Reg[13] = Memory::FastRead32(addr);
                     else
-                        cpu->Reg_usr[0] = Memory::Read32(addr);
+                        cpu->Reg_usr[0] = Memory::FastRead32(addr);
 
                     addr += 4;
                 }
                 if (BIT(inst, 14)) {
                     if (cpu->Mode == USER32MODE) 
-                        cpu->Reg[14] = Memory::Read32(addr);
+                        cpu->Reg[14] = Memory::FastRead32(addr);
                     else
-                        cpu->Reg_usr[1] = Memory::Read32(addr);
+                        cpu->Reg_usr[1] = Memory::FastRead32(addr);
                 }
             } else if (!BIT(inst, 22)) {
                 for(int i = 0; i < 16; i++ ){
                     if(BIT(inst, i)){
-                        unsigned int ret = Memory::Read32(addr);
+                        unsigned int ret = Memory::FastRead32(addr);
 
                         // For armv5t, should enter thumb when bits[0] is non-zero.
                         if(i == 15){
@@ -4372,7 +4650,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
             } else if (BIT(inst, 22) && BIT(inst, 15)) {
                 for(int i = 0; i < 15; i++ ){
                     if(BIT(inst, i)){
-                        cpu->Reg[i] = Memory::Read32(addr);
+                        cpu->Reg[i] = Memory::FastRead32(addr);
                         addr += 4;
                      }
                  }
@@ -4383,7 +4661,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
                     LOAD_NZCVT;
                 }
 
-                cpu->Reg[15] = Memory::Read32(addr);
+                cpu->Reg[15] = Memory::FastRead32(addr);
             }
 
             if (BIT(inst, 15)) {
@@ -4419,7 +4697,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         //if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 1);
 
-            unsigned int value = Memory::Read32(addr);
+            unsigned int value = Memory::FastRead32(addr);
             if (BIT(CP15_REG(CP15_CONTROL), 22) == 1)
                 cpu->Reg[BITS(inst_cream->inst, 12, 15)] = value;
             else {
@@ -4446,7 +4724,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         ldst_inst *inst_cream = (ldst_inst *)inst_base->component;
         if (CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 1);
-            unsigned int value = Memory::Read32(addr);
+            unsigned int value = Memory::FastRead32(addr);
             if (BIT(CP15_REG(CP15_CONTROL), 22) == 1)
                 cpu->Reg[BITS(inst_cream->inst, 12, 15)] = value;
             else {
@@ -4502,7 +4780,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         ldst_inst *inst_cream = (ldst_inst *)inst_base->component;
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 1);
-            cpu->Reg[BITS(inst_cream->inst, 12, 15)] = Memory::Read8(addr);
+            cpu->Reg[BITS(inst_cream->inst, 12, 15)] = Memory::FastRead8(addr);
 
             if (BITS(inst_cream->inst, 12, 15) == 15) {
                 INC_PC(sizeof(ldst_inst));
@@ -4519,7 +4797,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         ldst_inst *inst_cream = (ldst_inst *)inst_base->component;
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 1);
-            cpu->Reg[BITS(inst_cream->inst, 12, 15)] = Memory::Read8(addr);
+            cpu->Reg[BITS(inst_cream->inst, 12, 15)] = Memory::FastRead8(addr);
 
             if (BITS(inst_cream->inst, 12, 15) == 15) {
                 INC_PC(sizeof(ldst_inst));
@@ -4538,8 +4816,8 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
             // Should check if RD is even-numbered, Rd != 14, addr[0:1] == 0, (CP15_reg1_U == 1 || addr[2] == 0)
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 1);
 
-            cpu->Reg[BITS(inst_cream->inst, 12, 15)] = Memory::Read32(addr);
-            cpu->Reg[BITS(inst_cream->inst, 12, 15) + 1] = Memory::Read32(addr + 4);
+            cpu->Reg[BITS(inst_cream->inst, 12, 15)] = Memory::FastRead32(addr);
+            cpu->Reg[BITS(inst_cream->inst, 12, 15) + 1] = Memory::FastRead32(addr + 4);
 
             // No dispatch since this operation should not modify R15
         }
@@ -4558,7 +4836,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
             add_exclusive_addr(cpu, read_addr);
             cpu->exclusive_state = 1;
 
-            RD = Memory::Read32(read_addr);
+            RD = Memory::FastRead32(read_addr);
             if (inst_cream->Rd == 15) {
                 INC_PC(sizeof(generic_arm_inst));
                 goto DISPATCH;
@@ -4578,7 +4856,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
             add_exclusive_addr(cpu, read_addr);
             cpu->exclusive_state = 1;
 
-            RD = Memory::Read8(read_addr);
+            RD = Memory::FastRead8(read_addr);
             if (inst_cream->Rd == 15) {
                 INC_PC(sizeof(generic_arm_inst));
                 goto DISPATCH;
@@ -4598,7 +4876,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
             add_exclusive_addr(cpu, read_addr);
             cpu->exclusive_state = 1;
 
-            RD = Memory::Read16(read_addr);
+            RD = Memory::FastRead16(read_addr);
             if (inst_cream->Rd == 15) {
                 INC_PC(sizeof(generic_arm_inst));
                 goto DISPATCH;
@@ -4618,8 +4896,8 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
             add_exclusive_addr(cpu, read_addr);
             cpu->exclusive_state = 1;
 
-            RD = Memory::Read32(read_addr);
-            RD2 = Memory::Read32(read_addr + 4);
+            RD = Memory::FastRead32(read_addr);
+            RD2 = Memory::FastRead32(read_addr + 4);
 
             if (inst_cream->Rd == 15) {
                 INC_PC(sizeof(generic_arm_inst));
@@ -4636,7 +4914,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         ldst_inst *inst_cream = (ldst_inst *)inst_base->component;
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 1);
-            cpu->Reg[BITS(inst_cream->inst, 12, 15)] = Memory::Read16(addr);
+            cpu->Reg[BITS(inst_cream->inst, 12, 15)] = Memory::FastRead16(addr);
             if (BITS(inst_cream->inst, 12, 15) == 15) {
                 INC_PC(sizeof(ldst_inst));
                 goto DISPATCH;
@@ -4652,7 +4930,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         ldst_inst *inst_cream = (ldst_inst *)inst_base->component;
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 1);
-            unsigned int value = Memory::Read8(addr);
+            unsigned int value = Memory::FastRead8(addr);
             if (BIT(value, 7)) {
                 value |= 0xffffff00;
             }
@@ -4672,7 +4950,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         ldst_inst *inst_cream = (ldst_inst *)inst_base->component;
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 1);
-            unsigned int value = Memory::Read16(addr);
+            unsigned int value = Memory::FastRead16(addr);
             if (BIT(value, 15)) {
                 value |= 0xffff0000;
             }
@@ -4692,7 +4970,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         ldst_inst *inst_cream = (ldst_inst *)inst_base->component;
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 1);
-            unsigned int value = Memory::Read32(addr);
+            unsigned int value = Memory::FastRead32(addr);
             cpu->Reg[BITS(inst_cream->inst, 12, 15)] = value;
 
             if (BIT(CP15_REG(CP15_CONTROL), 22) == 1)
@@ -5932,45 +6210,45 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
             if (BIT(inst_cream->inst, 22) == 1) {
                 for (i = 0; i < 13; i++) {
                     if(BIT(inst_cream->inst, i)) {
-                        Memory::Write32(addr, cpu->Reg[i]);
+                        Memory::FastWrite32(addr, cpu->Reg[i]);
                         addr += 4;
                     }
                 }
                 if (BIT(inst_cream->inst, 13)) {
                     if (cpu->Mode == USER32MODE) {
-                        Memory::Write32(addr, cpu->Reg[i]);
+                        Memory::FastWrite32(addr, cpu->Reg[i]);
                         addr += 4;
                     } else {
-                        Memory::Write32(addr, cpu->Reg_usr[0]);
+                        Memory::FastWrite32(addr, cpu->Reg_usr[0]);
                         addr += 4;
                     }
                 }
                 if (BIT(inst_cream->inst, 14)) {
                     if (cpu->Mode == USER32MODE) {
-                        Memory::Write32(addr, cpu->Reg[i]);
+                        Memory::FastWrite32(addr, cpu->Reg[i]);
                         addr += 4;
                     } else {
-                        Memory::Write32(addr, cpu->Reg_usr[1]);
+                        Memory::FastWrite32(addr, cpu->Reg_usr[1]);
                         addr += 4;
                     }
                 }
                 if (BIT(inst_cream->inst, 15)) {
-                    Memory::Write32(addr, cpu->Reg_usr[1] + 8);
+                    Memory::FastWrite32(addr, cpu->Reg_usr[1] + 8);
                 }
             } else {
                 for( i = 0; i < 15; i++ ) {
                     if(BIT(inst_cream->inst, i)) {
                         if(i == Rn)
-                            Memory::Write32(addr, old_RN);
+                            Memory::FastWrite32(addr, old_RN);
                         else
-                            Memory::Write32(addr, cpu->Reg[i]);
+                            Memory::FastWrite32(addr, cpu->Reg[i]);
                         addr += 4;
                     }
                 }
 
                 // Check PC reg
                 if(BIT(inst_cream->inst, i)) {
-                    Memory::Write32(addr, cpu->Reg_usr[1] + 8);
+                    Memory::FastWrite32(addr, cpu->Reg_usr[1] + 8);
                 }
             }
         }
@@ -6005,7 +6283,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 0);
             unsigned int value = cpu->Reg[BITS(inst_cream->inst, 12, 15)];
-            Memory::Write32(addr, value);
+            Memory::FastWrite32(addr, value);
         }
         cpu->Reg[15] += GET_INST_SIZE(cpu);
         INC_PC(sizeof(ldst_inst));
@@ -6044,7 +6322,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 0);
             unsigned int value = cpu->Reg[BITS(inst_cream->inst, 12, 15)] & 0xff;
-            Memory::Write8(addr, value);
+            Memory::FastWrite8(addr, value);
         }
         cpu->Reg[15] += GET_INST_SIZE(cpu);
         INC_PC(sizeof(ldst_inst));
@@ -6057,7 +6335,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 0);
             unsigned int value = cpu->Reg[BITS(inst_cream->inst, 12, 15)] & 0xff;
-            Memory::Write8(addr, value);
+            Memory::FastWrite8(addr, value);
         }
         cpu->Reg[15] += GET_INST_SIZE(cpu);
         INC_PC(sizeof(ldst_inst));
@@ -6071,9 +6349,9 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 0);
 
             unsigned int value = cpu->Reg[BITS(inst_cream->inst, 12, 15)];
-            Memory::Write32(addr, value);
+            Memory::FastWrite32(addr, value);
             value = cpu->Reg[BITS(inst_cream->inst, 12, 15) + 1];
-            Memory::Write32(addr + 4, value);
+            Memory::FastWrite32(addr + 4, value);
         }
         cpu->Reg[15] += GET_INST_SIZE(cpu);
         INC_PC(sizeof(ldst_inst));
@@ -6091,7 +6369,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
                 remove_exclusive(cpu, write_addr);
                 cpu->exclusive_state = 0;
 
-                Memory::Write32(write_addr, cpu->Reg[inst_cream->Rm]);
+                Memory::FastWrite32(write_addr, cpu->Reg[inst_cream->Rm]);
                 RD = 0;
             } else {
                 // Failed to write due to mutex access
@@ -6114,7 +6392,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
                 remove_exclusive(cpu, write_addr);
                 cpu->exclusive_state = 0;
 
-                Memory::Write8(write_addr, cpu->Reg[inst_cream->Rm]);
+                Memory::FastWrite8(write_addr, cpu->Reg[inst_cream->Rm]);
                 RD = 0;
             } else {
                 // Failed to write due to mutex access
@@ -6137,8 +6415,8 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
                 remove_exclusive(cpu, write_addr);
                 cpu->exclusive_state = 0;
 
-                Memory::Write32(write_addr, cpu->Reg[inst_cream->Rm]);
-                Memory::Write32(write_addr + 4, cpu->Reg[inst_cream->Rm + 1]);
+                Memory::FastWrite32(write_addr, cpu->Reg[inst_cream->Rm]);
+                Memory::FastWrite32(write_addr + 4, cpu->Reg[inst_cream->Rm + 1]);
                 RD = 0;
             }
             else {
@@ -6162,7 +6440,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
                 remove_exclusive(cpu, write_addr);
                 cpu->exclusive_state = 0;
 
-                Memory::Write16(write_addr, cpu->Reg[inst_cream->Rm]);
+                Memory::FastWrite16(write_addr, cpu->Reg[inst_cream->Rm]);
                 RD = 0;
             } else {
                 // Failed to write due to mutex access
@@ -6180,7 +6458,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 0);
             unsigned int value = cpu->Reg[BITS(inst_cream->inst, 12, 15)] & 0xffff;
-            Memory::Write16(addr, value);
+            Memory::FastWrite16(addr, value);
         }
         cpu->Reg[15] += GET_INST_SIZE(cpu);
         INC_PC(sizeof(ldst_inst));
@@ -6193,7 +6471,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             inst_cream->get_addr(cpu, inst_cream->inst, addr, 0);
             unsigned int value = cpu->Reg[BITS(inst_cream->inst, 12, 15)];
-            Memory::Write32(addr, value);
+            Memory::FastWrite32(addr, value);
         }
         cpu->Reg[15] += GET_INST_SIZE(cpu);
         INC_PC(sizeof(ldst_inst));
@@ -6237,7 +6515,7 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         swi_inst *inst_cream = (swi_inst *)inst_base->component;
 
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond))
-            HLE::CallSVC(Memory::Read32(cpu->Reg[15]));
+            HLE::CallSVC(Memory::FastRead32(cpu->Reg[15]));
 
         cpu->Reg[15] += GET_INST_SIZE(cpu);
         INC_PC(sizeof(swi_inst));
@@ -6250,8 +6528,8 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             addr = RN;
             unsigned int value;
-            value = Memory::Read32(addr);
-            Memory::Write32(addr, RM);
+            value = Memory::FastRead32(addr);
+            Memory::FastWrite32(addr, RM);
 
             RD = value;
         }
@@ -6265,8 +6543,8 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
         swp_inst *inst_cream = (swp_inst *)inst_base->component;
         if ((inst_base->cond == 0xe) || CondPassed(cpu, inst_base->cond)) {
             addr = RN;
-            unsigned int value = Memory::Read8(addr);
-            Memory::Write8(addr, (RM & 0xFF));
+            unsigned int value = Memory::FastRead8(addr);
+            Memory::FastWrite8(addr, (RM & 0xFF));
         }
         cpu->Reg[15] += GET_INST_SIZE(cpu);
         INC_PC(sizeof(swp_inst));
@@ -6704,20 +6982,19 @@ unsigned InterpreterMainLoop(ARMul_State* state) {
     {
         b_2_thumb *inst_cream = (b_2_thumb *)inst_base->component;
         cpu->Reg[15] = cpu->Reg[15] + 4 + inst_cream->imm;
-        INC_PC(sizeof(b_2_thumb));
-        goto DISPATCH;
+        GOTO_LINKED_BLOCK(inst_cream->taken);
     }
     B_COND_THUMB:
     {
         b_cond_thumb *inst_cream = (b_cond_thumb *)inst_base->component;
 
-        if(CondPassed(cpu, inst_cream->cond))
+        if(CondPassed(cpu, inst_cream->cond)) {
             cpu->Reg[15] = cpu->Reg[15] + 4 + inst_cream->imm;
-        else
-            cpu->Reg[15] += 2;
+            GOTO_LINKED_BLOCK(inst_cream->taken);
+        }
 
-        INC_PC(sizeof(b_cond_thumb));
-        goto DISPATCH;
+        cpu->Reg[15] += 2;
+        GOTO_LINKED_BLOCK(inst_cream->not_taken);
     }
     BL_1_THUMB:
     {
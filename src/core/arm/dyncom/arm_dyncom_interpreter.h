@@ -4,4 +4,19 @@
 
 #pragma once
 
+#include "common/common_types.h"
+
+struct ARMul_State;
+
 unsigned InterpreterMainLoop(ARMul_State* state);
+
+/// Drops the translated blocks starting in the page of the given virtual address
+void InterpreterInvalidateCodePage(u32 addr);
+
+/**
+ * Checks whether the code from start up to the branch at branch_addr is a loop which only polls
+ * memory, and therefore can't exit until something else writes that memory
+ * @param start Address of the first instruction of the loop
+ * @param branch_addr Address of the branch which closes the loop
+ */
+bool IsIdleLoop(u32 start, u32 branch_addr);
@@ -0,0 +1,770 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "common/common.h"
+#include "common/memory_util.h"
+#include "common/x64_emitter.h"
+
+#include "core/core_timing.h"
+#include "core/mem_map.h"
+#include "core/settings.h"
+#include "core/hle/hle.h"
+#include "core/arm/skyeye_common/armdefs.h"
+
+// The decoder defines its own versions of these, which nothing in here uses
+#undef BIT
+#undef BITS
+#include "core/arm/dyncom/arm_dyncom_dec.h"
+#include "core/arm/dyncom/arm_dyncom_interpreter.h"
+#include "core/arm/dyncom/arm_dyncom_jit_x64.h"
+
+#ifdef ARM_JIT_X64
+
+namespace {
+
+using namespace X64;
+
+// Registers with a fixed meaning throughout compiled code. Both are callee-saved in the System V
+// and the Windows x64 calling conventions.
+static const X64Reg STATE = X64::R15; // ARMul_State of the CPU
+static const X64Reg ADDRESS = RBX;    // Address of the next transfer of LDM and STM
+
+// Stack space reserved by compiled code: The Windows x64 calling convention requires 32 bytes of
+// shadow space for called functions, and another 8 bytes keep the stack 16-byte aligned.
+static const s8 FRAME_SIZE = 40;
+
+static const s32 N_FLAG = offsetof(ARMul_State, NFlag);
+static const s32 Z_FLAG = offsetof(ARMul_State, ZFlag);
+static const s32 C_FLAG = offsetof(ARMul_State, CFlag);
+static const s32 V_FLAG = offsetof(ARMul_State, VFlag);
+static const s32 T_FLAG = offsetof(ARMul_State, TFlag);
+
+static s32 RegOffset(int index) {
+    return static_cast<s32>(offsetof(ARMul_State, Reg) + sizeof(ARMword) * index);
+}
+
+static u32 RotateRight(u32 value, u32 amount) {
+    return amount == 0 ? value : (value >> amount) | (value << (32 - amount));
+}
+
+// Memory accessors called by compiled code, these do the same as the interpreter's handlers
+
+static u32 LoadWord(ARMul_State* state, u32 addr) {
+    u32 value = Memory::FastRead32(addr);
+    if (((state->CP15[CP15(CP15_CONTROL)] >> 22) & 1) == 0)
+        value = RotateRight(value, 8 * (addr & 3));
+    return value;
+}
+
+static u32 LoadByte(ARMul_State* state, u32 addr) {
+    return Memory::FastRead8(addr);
+}
+
+static u32 LoadMultipleWord(ARMul_State* state, u32 addr) {
+    return Memory::FastRead32(addr);
+}
+
+static void StoreWord(ARMul_State* state, u32 addr, u32 value) {
+    Memory::FastWrite32(addr, value);
+}
+
+static void StoreByte(ARMul_State* state, u32 addr, u32 value) {
+    Memory::FastWrite8(addr, value & 0xFF);
+}
+
+/// Instruction classes handled by the compiler
+enum class InstructionClass {
+    Unsupported,
+    DataProcessing,
+    LoadStore,
+    LoadStoreMultiple,
+    Branch,
+    BranchExchange,
+};
+
+/// Classifies an instruction by what the dyncom decoder decodes it as
+static InstructionClass ClassifyInstruction(u32 inst) {
+    static const char* const data_processing[] = {
+        "and", "eor", "sub", "rsb", "add", "adc", "sbc", "rsc",
+        "tst", "teq", "cmp", "cmn", "orr", "mov", "bic", "mvn",
+    };
+    static const char* const load_store[] = { "ldr", "ldrcond", "ldrb", "str", "strb" };
+
+    // The unconditional instruction space holds a different set of instructions
+    if ((inst >> 28) == 0xF)
+        return InstructionClass::Unsupported;
+
+    int idx;
+    if (decode_arm_instr(inst, &idx) == DECODE_FAILURE)
+        return InstructionClass::Unsupported;
+
+    const char* name = arm_instruction[idx].name;
+    for (const char* candidate : data_processing) {
+        if (strcmp(name, candidate) == 0)
+            return InstructionClass::DataProcessing;
+    }
+    for (const char* candidate : load_store) {
+        if (strcmp(name, candidate) == 0)
+            return InstructionClass::LoadStore;
+    }
+    if (strcmp(name, "ldm") == 0 || strcmp(name, "stm") == 0)
+        return InstructionClass::LoadStoreMultiple;
+    if (strcmp(name, "bbl") == 0)
+        return InstructionClass::Branch;
+    if (strcmp(name, "bx") == 0)
+        return InstructionClass::BranchExchange;
+
+    return InstructionClass::Unsupported;
+}
+
+/**
+ * Translates a basic block of ARM code to x86-64 code. Guest registers and flags stay in the
+ * ARMul_State, with the flags kept in the separate NFlag etc. fields like in the interpreter.
+ * Compiled code runs the whole block, skipping instructions whose condition fails, and then
+ * returns with R15 set to the next instruction.
+ */
+class BlockCompiler {
+public:
+    /**
+     * Compiles the block starting at pc. The block ends at the first branch, at the end of the
+     * page or before the first instruction which the compiler doesn't handle.
+     * @return Number of instructions compiled
+     */
+    u32 Compile(u32 pc) {
+        // Epilogue shared by all exits of the block
+        epilogue = code.GetOffset();
+        code.ADD64(RSP, FRAME_SIZE);
+        code.POP(STATE);
+        code.POP(ADDRESS);
+        code.RET();
+
+        entry_point = code.GetOffset();
+        code.PUSH(ADDRESS);
+        code.PUSH(STATE);
+        code.SUB64(RSP, FRAME_SIZE);
+        code.MOV64(STATE, ABI_PARAM1);
+
+        u32 num_instructions = 0;
+        while (num_instructions < MAX_BLOCK_INSTRUCTIONS) {
+            const u32 inst = Memory::FastRead32(pc);
+            bool ends_block = false;
+            if (!CompileInstruction(inst, pc, ends_block))
+                break;
+
+            ++num_instructions;
+            pc += 4;
+            if (ends_block)
+                return num_instructions;
+            if ((pc & Memory::PAGE_MASK) == 0)
+                break;
+        }
+
+        EmitExit(pc);
+        return num_instructions;
+    }
+
+    const std::vector<u8>& GetCode() const {
+        return code.GetCode();
+    }
+
+    size_t GetEntryPoint() const {
+        return entry_point;
+    }
+
+private:
+    // Bounds how far a block may run past the number of instructions requested
+    static const u32 MAX_BLOCK_INSTRUCTIONS = 64;
+
+    static const size_t NO_FIXUP = ~size_t(0);
+
+    enum DataProcessingOpcode {
+        AND = 0x0, EOR = 0x1, SUB = 0x2, RSB = 0x3, ADD = 0x4, ADC = 0x5, SBC = 0x6, RSC = 0x7,
+        TST = 0x8, TEQ = 0x9, CMP = 0xA, CMN = 0xB, ORR = 0xC, MOV = 0xD, BIC = 0xE, MVN = 0xF,
+    };
+
+    /// Compiles an instruction, returns false without emitting any code if it isn't supported
+    bool CompileInstruction(u32 inst, u32 pc, bool& ends_block) {
+        switch (ClassifyInstruction(inst)) {
+        case InstructionClass::DataProcessing:
+            return CompileDataProcessing(inst, pc);
+
+        case InstructionClass::LoadStore:
+            return CompileLoadStore(inst, pc);
+
+        case InstructionClass::LoadStoreMultiple:
+            ends_block = (inst & (1 << 15)) != 0;
+            return CompileLoadStoreMultiple(inst, pc);
+
+        case InstructionClass::Branch:
+            ends_block = true;
+            CompileBranch(inst, pc);
+            return true;
+
+        case InstructionClass::BranchExchange:
+            ends_block = true;
+            return CompileBranchExchange(inst, pc);
+
+        default:
+            return false;
+        }
+    }
+
+    /// Sets R15 and leaves the block
+    void EmitExit(u32 next_pc) {
+        code.MOV32(STATE, RegOffset(15), next_pc);
+        code.SetJumpTarget(code.JMP(), epilogue);
+    }
+
+    /// Reads a guest register, R15 reads as the address of the instruction plus 8
+    void LoadRegister(X64Reg dest, int index, u32 pc) {
+        if (index == 15)
+            code.MOV32(dest, pc + 8);
+        else
+            code.MOV32(dest, STATE, RegOffset(index));
+    }
+
+    /**
+     * Emits a jump over the instruction which is taken if its condition fails
+     * @return Offset of the jump to patch once the instruction is compiled, or NO_FIXUP
+     */
+    size_t BeginConditional(u32 inst) {
+        switch (inst >> 28) {
+        case 0x0: code.CMP8(STATE, Z_FLAG, 0); return code.J_CC(CC_E);  // EQ
+        case 0x1: code.CMP8(STATE, Z_FLAG, 0); return code.J_CC(CC_NE); // NE
+        case 0x2: code.CMP8(STATE, C_FLAG, 0); return code.J_CC(CC_E);  // CS
+        case 0x3: code.CMP8(STATE, C_FLAG, 0); return code.J_CC(CC_NE); // CC
+        case 0x4: code.CMP8(STATE, N_FLAG, 0); return code.J_CC(CC_E);  // MI
+        case 0x5: code.CMP8(STATE, N_FLAG, 0); return code.J_CC(CC_NE); // PL
+        case 0x6: code.CMP8(STATE, V_FLAG, 0); return code.J_CC(CC_E);  // VS
+        case 0x7: code.CMP8(STATE, V_FLAG, 0); return code.J_CC(CC_NE); // VC
+
+        case 0x8: // HI
+        case 0x9: // LS
+            // RAX = !C || Z
+            code.MOVZX8(RAX, STATE, C_FLAG);
+            code.XOR32(RAX, 1);
+            code.MOVZX8(RCX, STATE, Z_FLAG);
+            code.OR32(RAX, RCX);
+            return code.J_CC((inst >> 28) == 0x8 ? CC_NE : CC_E);
+
+        case 0xA: // GE
+        case 0xB: // LT
+            // RAX = N != V
+            code.MOVZX8(RAX, STATE, N_FLAG);
+            code.MOVZX8(RCX, STATE, V_FLAG);
+            code.XOR32(RAX, RCX);
+            return code.J_CC((inst >> 28) == 0xA ? CC_NE : CC_E);
+
+        case 0xC: // GT
+        case 0xD: // LE
+            // RAX = Z || N != V
+            code.MOVZX8(RAX, STATE, N_FLAG);
+            code.MOVZX8(RCX, STATE, V_FLAG);
+            code.XOR32(RAX, RCX);
+            code.MOVZX8(RCX, STATE, Z_FLAG);
+            code.OR32(RAX, RCX);
+            return code.J_CC((inst >> 28) == 0xC ? CC_NE : CC_E);
+
+        default:
+            return NO_FIXUP;
+        }
+    }
+
+    void EndConditional(size_t skip) {
+        if (skip != NO_FIXUP)
+            code.SetJumpTarget(skip, code.GetOffset());
+    }
+
+    void CallHelper(const void* function) {
+        code.MOV64(ABI_PARAM1, STATE);
+        code.MOV64(RAX, reinterpret_cast<u64>(function));
+        code.CALL(RAX);
+    }
+
+    bool CompileDataProcessing(u32 inst, u32 pc) {
+        const u32 opcode = (inst >> 21) & 0xF;
+        const bool set_flags = ((inst >> 20) & 1) != 0;
+        const int rn = (inst >> 16) & 0xF;
+        const int rd = (inst >> 12) & 0xF;
+        const bool immediate = ((inst >> 25) & 1) != 0;
+        const u32 shift_type = (inst >> 5) & 3;
+        const u32 shift_amount = (inst >> 7) & 0x1F;
+
+        const bool is_test = opcode >= TST && opcode <= CMN;
+        const bool is_logical = opcode == AND || opcode == EOR || opcode == TST || opcode == TEQ ||
+                                opcode >= ORR;
+
+        // Writing R15 is a branch, which may also restore the CPSR
+        if (!is_test && rd == 15)
+            return false;
+
+        // Register shifted registers, as well as the encodings of LSR #32, ASR #32 and RRX
+        if (!immediate && (((inst >> 4) & 1) != 0 || (shift_amount == 0 && shift_type != 0)))
+            return false;
+
+        const size_t skip = BeginConditional(inst);
+        const bool shifter_carry = set_flags && is_logical;
+
+        // Second operand into RCX, its carry out goes straight to the C flag of logical operations
+        if (immediate) {
+            const u32 rotate = ((inst >> 8) & 0xF) * 2;
+            const u32 value = RotateRight(inst & 0xFF, rotate);
+            code.MOV32(RCX, value);
+            if (shifter_carry && rotate != 0)
+                code.MOV8(STATE, C_FLAG, static_cast<u8>(value >> 31));
+        } else {
+            LoadRegister(RCX, inst & 0xF, pc);
+            if (shift_amount != 0) {
+                switch (shift_type) {
+                case 0: code.SHL32(RCX, shift_amount); break;
+                case 1: code.SHR32(RCX, shift_amount); break;
+                case 2: code.SAR32(RCX, shift_amount); break;
+                case 3: code.ROR32(RCX, shift_amount); break;
+                }
+                if (shifter_carry)
+                    code.SETcc(CC_C, STATE, C_FLAG);
+            }
+        }
+
+        // Result into RAX. The x86 flags are set like the ARM ones, except for the carry of
+        // subtractions, which is a borrow.
+        switch (opcode) {
+        case AND:
+        case TST:
+            LoadRegister(RAX, rn, pc);
+            code.AND32(RAX, RCX);
+            break;
+
+        case EOR:
+        case TEQ:
+            LoadRegister(RAX, rn, pc);
+            code.XOR32(RAX, RCX);
+            break;
+
+        case SUB:
+        case CMP:
+            LoadRegister(RAX, rn, pc);
+            code.SUB32(RAX, RCX);
+            break;
+
+        case RSB:
+            LoadRegister(RDX, rn, pc);
+            code.MOV32(RAX, RCX);
+            code.SUB32(RAX, RDX);
+            break;
+
+        case ADD:
+        case CMN:
+            LoadRegister(RAX, rn, pc);
+            code.ADD32(RAX, RCX);
+            break;
+
+        case ADC:
+            LoadRegister(RAX, rn, pc);
+            code.BT32(STATE, C_FLAG, 0);
+            code.ADC32(RAX, RCX);
+            break;
+
+        case SBC:
+            LoadRegister(RAX, rn, pc);
+            code.BT32(STATE, C_FLAG, 0);
+            code.CMC();
+            code.SBB32(RAX, RCX);
+            break;
+
+        case RSC:
+            LoadRegister(RDX, rn, pc);
+            code.MOV32(RAX, RCX);
+            code.BT32(STATE, C_FLAG, 0);
+            code.CMC();
+            code.SBB32(RAX, RDX);
+            break;
+
+        case ORR:
+            LoadRegister(RAX, rn, pc);
+            code.OR32(RAX, RCX);
+            break;
+
+        case MOV:
+            code.MOV32(RAX, RCX);
+            code.TEST32(RAX, RAX);
+            break;
+
+        case BIC:
+            LoadRegister(RAX, rn, pc);
+            code.NOT32(RCX);
+            code.AND32(RAX, RCX);
+            break;
+
+        case MVN:
+            code.MOV32(RAX, RCX);
+            code.NOT32(RAX);
+            code.TEST32(RAX, RAX);
+            break;
+        }
+
+        // The flag fields only ever hold 0 or 1, so it's enough to set their lowest byte
+        if (set_flags) {
+            code.SETcc(CC_S, STATE, N_FLAG);
+            code.SETcc(CC_E, STATE, Z_FLAG);
+            if (!is_logical) {
+                const bool is_subtraction = opcode == SUB || opcode == RSB || opcode == SBC ||
+                                            opcode == RSC || opcode == CMP;
+                code.SETcc(is_subtraction ? CC_NC : CC_C, STATE, C_FLAG);
+                code.SETcc(CC_O, STATE, V_FLAG);
+            }
+        }
+
+        if (!is_test)
+            code.MOV32(STATE, RegOffset(rd), RAX);
+
+        EndConditional(skip);
+        return true;
+    }
+
+    /// LDR, LDRB, STR and STRB with immediate or LSL shifted register offsets
+    bool CompileLoadStore(u32 inst, u32 pc) {
+        const bool is_load = ((inst >> 20) & 1) != 0;
+        const bool writeback = ((inst >> 21) & 1) != 0;
+        const bool is_byte = ((inst >> 22) & 1) != 0;
+        const bool up = ((inst >> 23) & 1) != 0;
+        const bool pre_indexed = ((inst >> 24) & 1) != 0;
+        const bool register_offset = ((inst >> 25) & 1) != 0;
+        const int rn = (inst >> 16) & 0xF;
+        const int rd = (inst >> 12) & 0xF;
+        const u32 shift_amount = (inst >> 7) & 0x1F;
+
+        // LDRT and STRT access memory as if in user mode
+        if (!pre_indexed && writeback)
+            return false;
+
+        // Loads into R15 are branches, and the interpreter stores a different value of R15
+        if (rd == 15)
+            return false;
+
+        const bool updates_base = !pre_indexed || writeback;
+        if (updates_base && (rn == 15 || rn == rd))
+            return false;
+
+        if (register_offset && (inst & 0x70) != 0)
+            return false;
+
+        const size_t skip = BeginConditional(inst);
+
+        // Base address into RAX, offset address into RDX
+        LoadRegister(RAX, rn, pc);
+        code.MOV32(RDX, RAX);
+        if (register_offset) {
+            LoadRegister(RCX, inst & 0xF, pc);
+            if (shift_amount != 0)
+                code.SHL32(RCX, shift_amount);
+            if (up)
+                code.ADD32(RDX, RCX);
+            else
+                code.SUB32(RDX, RCX);
+        } else {
+            const u32 offset = inst & 0xFFF;
+            code.ADD32(RDX, up ? offset : 0u - offset);
+        }
+
+        if (updates_base)
+            code.MOV32(STATE, RegOffset(rn), RDX);
+
+        code.MOV32(ABI_PARAM2, pre_indexed ? RDX : RAX);
+        if (is_load) {
+            CallHelper(is_byte ? (const void*)&LoadByte : (const void*)&LoadWord);
+            code.MOV32(STATE, RegOffset(rd), RAX);
+        } else {
+            LoadRegister(ABI_PARAM3, rd, pc);
+            CallHelper(is_byte ? (const void*)&StoreByte : (const void*)&StoreWord);
+        }
+
+        EndConditional(skip);
+        return true;
+    }
+
+    /// LDM and STM without the user mode register bank
+    bool CompileLoadStoreMultiple(u32 inst, u32 pc) {
+        const bool is_load = ((inst >> 20) & 1) != 0;
+        const bool writeback = ((inst >> 21) & 1) != 0;
+        const bool user_bank = ((inst >> 22) & 1) != 0;
+        const bool up = ((inst >> 23) & 1) != 0;
+        const bool before = ((inst >> 24) & 1) != 0;
+        const int rn = (inst >> 16) & 0xF;
+        const u32 register_list = inst & 0xFFFF;
+
+        // The interpreter stores a different value of R15
+        if (user_bank || rn == 15 || register_list == 0 || (!is_load && (register_list & (1 << 15))))
+            return false;
+
+        u32 count = 0;
+        for (int i = 0; i < 16; ++i)
+            count += (register_list >> i) & 1;
+
+        const size_t skip = BeginConditional(inst);
+
+        s32 start_offset;
+        if (up)
+            start_offset = before ? 4 : 0;
+        else
+            start_offset = before ? -4 * (s32)count : -4 * (s32)count + 4;
+
+        LoadRegister(ADDRESS, rn, pc);
+        code.ADD32(ADDRESS, static_cast<u32>(start_offset));
+
+        // Like the interpreter, load the base register after and store it before writeback
+        if (is_load && writeback)
+            EmitWriteback(rn, up, count);
+
+        for (int i = 0; i < 16; ++i) {
+            if (!((register_list >> i) & 1))
+                continue;
+
+            code.MOV32(ABI_PARAM2, ADDRESS);
+            if (is_load) {
+                CallHelper((const void*)&LoadMultipleWord);
+                if (i == 15) {
+                    code.MOV32(RCX, RAX);
+                    code.AND32(RCX, 1);
+                    code.MOV32(STATE, T_FLAG, RCX);
+                    code.AND32(RAX, -2);
+                }
+                code.MOV32(STATE, RegOffset(i), RAX);
+            } else {
+                LoadRegister(ABI_PARAM3, i, pc);
+                CallHelper((const void*)&StoreWord);
+            }
+            code.ADD32(ADDRESS, 4u);
+        }
+
+        if (!is_load && writeback)
+            EmitWriteback(rn, up, count);
+
+        if (register_list & (1 << 15)) {
+            code.SetJumpTarget(code.JMP(), epilogue);
+            if (skip != NO_FIXUP) {
+                code.SetJumpTarget(skip, code.GetOffset());
+                EmitExit(pc + 4);
+            }
+            return true;
+        }
+
+        EndConditional(skip);
+        return true;
+    }
+
+    void EmitWriteback(int rn, bool up, u32 count) {
+        code.MOV32(RAX, STATE, RegOffset(rn));
+        code.ADD32(RAX, up ? 4 * count : 0u - 4 * count);
+        code.MOV32(STATE, RegOffset(rn), RAX);
+    }
+
+    /// B and BL
+    void CompileBranch(u32 inst, u32 pc) {
+        const size_t skip = BeginConditional(inst);
+
+        if ((inst >> 24) & 1)
+            code.MOV32(STATE, RegOffset(14), pc + 4);
+
+        const u32 offset = ((inst & 0xFFFFFF) ^ 0x800000) - 0x800000;
+        EmitExit(pc + 8 + (offset << 2));
+
+        if (skip != NO_FIXUP) {
+            code.SetJumpTarget(skip, code.GetOffset());
+            EmitExit(pc + 4);
+        }
+    }
+
+    bool CompileBranchExchange(u32 inst, u32 pc) {
+        const int rm = inst & 0xF;
+        if (rm == 15)
+            return false;
+
+        const size_t skip = BeginConditional(inst);
+
+        code.MOV32(RAX, STATE, RegOffset(rm));
+        code.MOV32(RCX, RAX);
+        code.AND32(RCX, 1);
+        code.MOV32(STATE, T_FLAG, RCX);
+        code.AND32(RAX, -2);
+        code.MOV32(STATE, RegOffset(15), RAX);
+        code.SetJumpTarget(code.JMP(), epilogue);
+
+        if (skip != NO_FIXUP) {
+            code.SetJumpTarget(skip, code.GetOffset());
+            EmitExit(pc + 4);
+        }
+        return true;
+    }
+
+    X64Emitter code;
+    size_t epilogue;
+    size_t entry_point;
+};
+
+/// Compiled code for the block starting at an address
+struct Block {
+    void (*entry)(ARMul_State* state);  ///< Compiled code, nullptr if the interpreter runs the block
+    u32 num_instructions;               ///< Number of instructions in the block, 0 if not compiled
+    bool idle_loop;                     ///< The block is a loop which only polls memory
+};
+
+// Compiled blocks, indexed by the page of their start address and the word within that page. The
+// tables for each page are allocated when the first block in the page is compiled.
+typedef std::array<Block, (Memory::PAGE_MASK + 1) / 4> BlockPage;
+static std::unique_ptr<BlockPage> block_table[Memory::PAGE_TABLE_NUM_ENTRIES];
+
+// Compiled code is allocated one block after another from code_buffer, until it is full and all
+// blocks are dropped
+static u8* code_buffer = nullptr;
+static size_t code_buffer_size = 0;
+static size_t code_buffer_used = 0;
+
+static void FlushAllBlocks() {
+    for (u32 page = 0; page < Memory::PAGE_TABLE_NUM_ENTRIES; ++page)
+        JitInvalidateCodePage(page << Memory::PAGE_BITS);
+    code_buffer_used = 0;
+}
+
+static const Block* LookupBlock(u32 pc) {
+    const BlockPage* page = block_table[pc >> Memory::PAGE_BITS].get();
+    if (page == nullptr)
+        return nullptr;
+
+    const Block& block = (*page)[(pc & Memory::PAGE_MASK) >> 2];
+    return block.num_instructions != 0 ? &block : nullptr;
+}
+
+static const Block* CompileBlock(u32 pc) {
+    BlockCompiler compiler;
+    Block block = { nullptr, 1, false };
+
+    const u32 num_instructions = compiler.Compile(pc);
+    const std::vector<u8>& code = compiler.GetCode();
+    if (num_instructions != 0 && code.size() <= code_buffer_size) {
+        if (code_buffer_used + code.size() > code_buffer_size) {
+            LOG_DEBUG(Core_ARM11, "JIT code buffer is full, dropping all compiled blocks");
+            FlushAllBlocks();
+        }
+
+        u8* block_code = code_buffer + code_buffer_used;
+        memcpy(block_code, code.data(), code.size());
+        code_buffer_used += code.size();
+
+        block.entry = reinterpret_cast<void (*)(ARMul_State*)>(block_code + compiler.GetEntryPoint());
+        block.num_instructions = num_instructions;
+        block.idle_loop = IsIdleLoop(pc, pc + (num_instructions - 1) * 4);
+    }
+
+    std::unique_ptr<BlockPage>& page = block_table[pc >> Memory::PAGE_BITS];
+    if (!page) {
+        page.reset(new BlockPage());
+
+        // Guest writes to the page have to drop the blocks compiled from it
+        Memory::SetCodePageWriteTracking(pc, Memory::TRACK_JIT_CODE, true);
+    }
+
+    Block& entry = (*page)[(pc & Memory::PAGE_MASK) >> 2];
+    entry = block;
+    return &entry;
+}
+
+static void SaveFlags(ARMul_State* state) {
+    state->Cpsr = (state->Cpsr & 0x0fffffdf) | (state->NFlag << 31) | (state->ZFlag << 30) |
+                  (state->CFlag << 29) | (state->VFlag << 28) | (state->TFlag << 5);
+}
+
+static void LoadFlags(ARMul_State* state) {
+    state->NFlag = (state->Cpsr >> 31);
+    state->ZFlag = (state->Cpsr >> 30) & 1;
+    state->CFlag = (state->Cpsr >> 29) & 1;
+    state->VFlag = (state->Cpsr >> 28) & 1;
+    state->TFlag = (state->Cpsr >> 5) & 1;
+}
+
+/// Runs at most num_instructions instructions in the interpreter
+static unsigned Interpret(ARMul_State* state, unsigned num_instructions) {
+    // The interpreter loads the flags from the CPSR, and saves them to it when done
+    SaveFlags(state);
+    state->NumInstrsToExecute = num_instructions;
+    return InterpreterMainLoop(state);
+}
+
+} // namespace
+
+unsigned JitMainLoop(ARMul_State* state) {
+    if (code_buffer == nullptr) {
+        code_buffer_size = Settings::values.translation_cache_size * 1024 * 1024;
+        code_buffer = static_cast<u8*>(AllocateExecutableMemory(code_buffer_size, false));
+    }
+
+    const unsigned num_instrs_to_execute = state->NumInstrsToExecute;
+    unsigned num_instrs = 0;
+
+    LoadFlags(state);
+    while (num_instrs < num_instrs_to_execute) {
+        // Stop for pending interrupts, like the interpreter does on each dispatch
+        if (!state->NirqSig && !(state->Cpsr & 0x80))
+            break;
+
+        // The interpreter runs Thumb code, as well as single steps for the debugger
+        if (state->TFlag || num_instrs_to_execute == 1) {
+            num_instrs += Interpret(state, num_instrs_to_execute - num_instrs);
+            break;
+        }
+
+        const u32 pc = state->Reg[15] & 0xfffffffc;
+        state->Reg[15] = pc;
+        const Block* block = LookupBlock(pc);
+        if (block == nullptr)
+            block = CompileBlock(pc);
+
+        if (block->entry != nullptr) {
+            // The block may write to its own code page, which frees it, so nothing may be read
+            // from it after running it
+            const unsigned num_block_instrs = block->num_instructions;
+            const bool idle_loop = block->idle_loop;
+            block->entry(state);
+            num_instrs += num_block_instrs;
+
+            // Polling the same memory again won't give a different result before the next event
+            // fires, so skip ahead to it
+            if (idle_loop && state->Reg[15] == pc) {
+                CoreTiming::Idle();
+                break;
+            }
+            continue;
+        }
+
+        const u64 idle_ticks = CoreTiming::GetIdleTicks();
+        const unsigned num_interpreted = Interpret(state, 1);
+        num_instrs += num_interpreted;
+
+        // Stop if the instruction failed to decode, requested a thread switch, or closed an idle
+        // loop which the interpreter skipped ahead for
+        if (num_interpreted == 0 || HLE::g_reschedule || CoreTiming::GetIdleTicks() != idle_ticks)
+            break;
+    }
+    SaveFlags(state);
+
+    state->NumInstrsToExecute = 0;
+    return num_instrs;
+}
+
+void JitInvalidateCodePage(u32 addr) {
+    std::unique_ptr<BlockPage>& page = block_table[addr >> Memory::PAGE_BITS];
+    if (!page)
+        return;
+
+    page.reset();
+    Memory::SetCodePageWriteTracking(addr, Memory::TRACK_JIT_CODE, false);
+}
+
+#endif // ARM_JIT_X64
@@ -0,0 +1,27 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include "common/common_types.h"
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(_M_GENERIC)
+#define ARM_JIT_X64
+#endif
+
+#ifdef ARM_JIT_X64
+
+struct ARMul_State;
+
+/**
+ * Runs guest code compiled to x86-64 code by basic block, like InterpreterMainLoop. Instructions
+ * which the compiler doesn't handle, as well as Thumb code, are run by the interpreter.
+ * @return Number of instructions executed
+ */
+unsigned JitMainLoop(ARMul_State* state);
+
+/// Drops the compiled blocks starting in the page of the given virtual address
+void JitInvalidateCodePage(u32 addr);
+
+#endif // ARM_JIT_X64
@@ -60,18 +60,18 @@ ARMword ARMul_LoadInstrS(ARMul_State * state, ARMword address, ARMword isize) {
     }
 #endif
     if (isize == 2)
-        return (u16)Memory::Read16(address);
+        return (u16)Memory::FastRead16(address);
     else
-        return (u32)Memory::Read32(address);
+        return (u32)Memory::FastRead32(address);
 }
 
 ARMword ARMul_LoadInstrN(ARMul_State * state, ARMword address, ARMword isize) {
     state->NumNcycles++;
 
     if (isize == 2)
-        return (u16)Memory::Read16(address);
+        return (u16)Memory::FastRead16(address);
     else
-        return (u32)Memory::Read32(address);
+        return (u32)Memory::FastRead32(address);
 }
 
 ARMword ARMul_ReLoadInstr(ARMul_State * state, ARMword address, ARMword isize) {
@@ -79,17 +79,17 @@ ARMword ARMul_ReLoadInstr(ARMul_State * state, ARMword address, ARMword isize) {
 
     if ((isize == 2) && (address & 0x2)) {
         ARMword lo;
-        lo = (u16)Memory::Read16(address);
+        lo = (u16)Memory::FastRead16(address);
         return lo;
     }
 
-    data = (u32)Memory::Read32(address);
+    data = (u32)Memory::FastRead32(address);
     return data;
 }
 
 ARMword ARMul_ReadWord(ARMul_State * state, ARMword address) {
     ARMword data;
-    data = Memory::Read32(address);
+    data = Memory::FastRead32(address);
     return data;
 }
 
@@ -105,11 +105,11 @@ ARMword ARMul_LoadWordN(ARMul_State * state, ARMword address) {
 
 ARMword ARMul_LoadHalfWord(ARMul_State * state, ARMword address) {
     state->NumNcycles++;
-    return (u16)Memory::Read16(address);;
+    return (u16)Memory::FastRead16(address);;
 }
 
 ARMword ARMul_ReadByte(ARMul_State * state, ARMword address) {
-    return (u8)Memory::Read8(address);
+    return (u8)Memory::FastRead8(address);
 }
 
 ARMword ARMul_LoadByte(ARMul_State * state, ARMword address) {
@@ -119,7 +119,7 @@ ARMword ARMul_LoadByte(ARMul_State * state, ARMword address) {
 
 void ARMul_StoreHalfWord(ARMul_State * state, ARMword address, ARMword data) {
     state->NumNcycles++;
-    Memory::Write16(address, data);
+    Memory::FastWrite16(address, data);
 }
 
 void ARMul_StoreByte(ARMul_State * state, ARMword address, ARMword data) {
@@ -132,24 +132,24 @@ ARMword ARMul_SwapWord(ARMul_State * state, ARMword address, ARMword data) {
     state->NumNcycles++;
     temp = ARMul_ReadWord(state, address);
     state->NumNcycles++;
-    Memory::Write32(address, data);
+    Memory::FastWrite32(address, data);
     return temp;
 }
 
 ARMword ARMul_SwapByte(ARMul_State * state, ARMword address, ARMword data) {
     ARMword temp;
     temp = ARMul_LoadByte(state, address);
-    Memory::Write8(address, data);
+    Memory::FastWrite8(address, data);
     return temp;
 }
 
 void ARMul_WriteWord(ARMul_State * state, ARMword address, ARMword data) {
-    Memory::Write32(address, data);
+    Memory::FastWrite32(address, data);
 }
 
 void ARMul_WriteByte(ARMul_State * state, ARMword address, ARMword data)
 {
-    Memory::Write8(address, data);
+    Memory::FastWrite8(address, data);
 }
 
 void ARMul_StoreWordS(ARMul_State * state, ARMword address, ARMword data)
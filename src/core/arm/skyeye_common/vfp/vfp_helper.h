@@ -532,6 +532,117 @@ static u32 fls(ARMword x)
 
 }
 
+/*
+ * Host FPU fast path. On x86-64, arithmetic on normal numbers is done with SSE, using the
+ * rounding mode of the FPSCR. The host differs from VFP whenever NaNs, infinities or denormals
+ * are involved (default NaN, flush-to-zero, ...), so in that case, or when any exception other
+ * than inexact occurs, the result is discarded and the software routines are used instead. They
+ * are also always used while exception traps are enabled.
+ */
+#if defined(_M_X64) || defined(__x86_64__)
+#define VFP_HOST_FPU
+
+#include <cstring>
+#include <xmmintrin.h>
+
+enum vfp_host_operation {
+	VFP_HOST_ADD,
+	VFP_HOST_MUL,
+	VFP_HOST_DIV,
+};
+
+#define MXCSR_EXCEPTION_MASKS	(0x3F << 7)
+#define MXCSR_PRECISION_FLAG	(1 << 5)
+#define MXCSR_EXCEPTION_FLAGS	(0x3F)
+#define FPSCR_TRAP_ENABLES	(FPSCR_IOE|FPSCR_DZE|FPSCR_OFE|FPSCR_UFE|FPSCR_IXE|FPSCR_IDE)
+
+/* MXCSR rounding control for each FPSCR rounding mode */
+static const u32 vfp_host_rounding[] = { 0 << 13, 2 << 13, 1 << 13, 3 << 13 };
+
+template <typename T>
+static inline T vfp_host_compute(enum vfp_host_operation op, T n, T m)
+{
+	switch (op) {
+	case VFP_HOST_ADD: return n + m;
+	case VFP_HOST_MUL: return n * m;
+	default:           return n / m;
+	}
+}
+
+/*
+ * Computes n op m on the host, where U is the bit representation of the floating point type T.
+ * Returns false if the software routines have to compute the result instead, otherwise the
+ * exceptions to raise are added to *exceptions.
+ */
+template <typename T, typename U>
+static inline bool vfp_host_op(u32 fpscr, enum vfp_host_operation op, U n, U m, U* result, u32* exceptions)
+{
+	static const int exponent_bits = sizeof(T) == 4 ? 8 : 11;
+	static const int fraction_bits = sizeof(T) * 8 - 1 - exponent_bits;
+	static const U exponent_mask = (((U)1 << exponent_bits) - 1) << fraction_bits;
+
+	if (fpscr & FPSCR_TRAP_ENABLES)
+		return false;
+
+	/*
+	 * The operands are only read from and the result only written to volatile variables in
+	 * between changing MXCSR, so that the compiler can't move the operation past those changes.
+	 */
+	volatile T host_n, host_m, host_result;
+	memcpy((void*)&host_n, &n, sizeof(T));
+	memcpy((void*)&host_m, &m, sizeof(T));
+
+	const u32 host_mxcsr = _mm_getcsr();
+	_mm_setcsr(MXCSR_EXCEPTION_MASKS | vfp_host_rounding[(fpscr & FPSCR_RMODE_MASK) >> FPSCR_RMODE_BIT]);
+	host_result = vfp_host_compute<T>(op, host_n, host_m);
+	const u32 flags = _mm_getcsr() & MXCSR_EXCEPTION_FLAGS;
+	_mm_setcsr(host_mxcsr);
+
+	U value;
+	memcpy(&value, (const void*)&host_result, sizeof(T));
+
+	/*
+	 * NaNs and infinities have an all-ones exponent, denormals a zero exponent and a non-zero
+	 * fraction.
+	 */
+	const U exponent = value & exponent_mask;
+	if (exponent == exponent_mask || (exponent == 0 && (value << 1) != 0))
+		return false;
+	if (flags & ~MXCSR_PRECISION_FLAG)
+		return false;
+
+	*result = value;
+	if (flags & MXCSR_PRECISION_FLAG)
+		*exceptions |= FPSCR_IXC;
+	return true;
+}
+
+/*
+ * Computes (n * m) + d on the host like VMLA and related instructions, with both the product
+ * and the sum rounded. The operands are negated as given by negate_product and negate_d.
+ */
+template <typename T, typename U>
+static inline bool vfp_host_multiply_accumulate(u32 fpscr, U d, U n, U m, bool negate_product,
+                                                bool negate_d, U* result, u32* exceptions)
+{
+	static const U sign_bit = (U)1 << (sizeof(U) * 8 - 1);
+	U product;
+	u32 host_exceptions = 0;
+
+	if (!vfp_host_op<T>(fpscr, VFP_HOST_MUL, n, m, &product, &host_exceptions))
+		return false;
+	if (negate_product)
+		product ^= sign_bit;
+	if (negate_d)
+		d ^= sign_bit;
+	if (!vfp_host_op<T>(fpscr, VFP_HOST_ADD, d, product, result, &host_exceptions))
+		return false;
+
+	*exceptions |= host_exceptions;
+	return true;
+}
+#endif
+
 u32 vfp_double_normaliseroundintern(ARMul_State* state, struct vfp_double *vd, u32 fpscr, u32 exceptions, const char *func);
 u32 vfp_double_multiply(struct vfp_double *vdd, struct vfp_double *vdn, struct vfp_double *vdm, u32 fpscr);
 u32 vfp_double_add(struct vfp_double *vdd, struct vfp_double *vdn, struct vfp_double *vdm, u32 fpscr);
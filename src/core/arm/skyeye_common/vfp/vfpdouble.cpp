@@ -1069,6 +1069,19 @@ vfp_double_multiply_accumulate(ARMul_State* state, int dd, int dn, int dm, u32 f
     struct vfp_double vdd, vdp, vdn, vdm;
     u32 exceptions;
 
+#ifdef VFP_HOST_FPU
+    {
+        u64 result;
+        u32 host_exceptions = 0;
+        if (vfp_host_multiply_accumulate<double>(fpscr, vfp_get_double(state, dd), vfp_get_double(state, dn),
+                                                 vfp_get_double(state, dm), (negate & NEG_MULTIPLY) != 0,
+                                                 (negate & NEG_SUBTRACT) != 0, &result, &host_exceptions)) {
+            vfp_put_double(state, result, dd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     vfp_double_unpack(&vdn, vfp_get_double(state, dn));
     if (vdn.exponent == 0 && vdn.significand)
         vfp_double_normalise_denormal(&vdn);
@@ -1139,6 +1152,18 @@ static u32 vfp_double_fmul(ARMul_State* state, int dd, int dn, int dm, u32 fpscr
     u32 exceptions;
 
     pr_debug("In %s\n", __FUNCTION__);
+
+#ifdef VFP_HOST_FPU
+    {
+        u64 result;
+        u32 host_exceptions = 0;
+        if (vfp_host_op<double>(fpscr, VFP_HOST_MUL, vfp_get_double(state, dn), vfp_get_double(state, dm), &result, &host_exceptions)) {
+            vfp_put_double(state, result, dd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     vfp_double_unpack(&vdn, vfp_get_double(state, dn));
     if (vdn.exponent == 0 && vdn.significand)
         vfp_double_normalise_denormal(&vdn);
@@ -1160,6 +1185,19 @@ static u32 vfp_double_fnmul(ARMul_State* state, int dd, int dn, int dm, u32 fpsc
     u32 exceptions;
 
     pr_debug("In %s\n", __FUNCTION__);
+
+#ifdef VFP_HOST_FPU
+    {
+        u64 result;
+        u32 host_exceptions = 0;
+        if (vfp_host_op<double>(fpscr, VFP_HOST_MUL, vfp_get_double(state, dn), vfp_get_double(state, dm), &result, &host_exceptions)) {
+            result ^= (u64)1 << 63;
+            vfp_put_double(state, result, dd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     vfp_double_unpack(&vdn, vfp_get_double(state, dn));
     if (vdn.exponent == 0 && vdn.significand)
         vfp_double_normalise_denormal(&vdn);
@@ -1183,6 +1221,18 @@ static u32 vfp_double_fadd(ARMul_State* state, int dd, int dn, int dm, u32 fpscr
     u32 exceptions;
 
     pr_debug("In %s\n", __FUNCTION__);
+
+#ifdef VFP_HOST_FPU
+    {
+        u64 result;
+        u32 host_exceptions = 0;
+        if (vfp_host_op<double>(fpscr, VFP_HOST_ADD, vfp_get_double(state, dn), vfp_get_double(state, dm), &result, &host_exceptions)) {
+            vfp_put_double(state, result, dd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     vfp_double_unpack(&vdn, vfp_get_double(state, dn));
     if (vdn.exponent == 0 && vdn.significand)
         vfp_double_normalise_denormal(&vdn);
@@ -1205,6 +1255,18 @@ static u32 vfp_double_fsub(ARMul_State* state, int dd, int dn, int dm, u32 fpscr
     u32 exceptions;
 
     pr_debug("In %s\n", __FUNCTION__);
+
+#ifdef VFP_HOST_FPU
+    {
+        u64 result;
+        u32 host_exceptions = 0;
+        if (vfp_host_op<double>(fpscr, VFP_HOST_ADD, vfp_get_double(state, dn), vfp_get_double(state, dm) ^ ((u64)1 << 63), &result, &host_exceptions)) {
+            vfp_put_double(state, result, dd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     vfp_double_unpack(&vdn, vfp_get_double(state, dn));
     if (vdn.exponent == 0 && vdn.significand)
         vfp_double_normalise_denormal(&vdn);
@@ -1233,6 +1295,18 @@ static u32 vfp_double_fdiv(ARMul_State* state, int dd, int dn, int dm, u32 fpscr
     int tm, tn;
 
     pr_debug("In %s\n", __FUNCTION__);
+
+#ifdef VFP_HOST_FPU
+    {
+        u64 result;
+        u32 host_exceptions = 0;
+        if (vfp_host_op<double>(fpscr, VFP_HOST_DIV, vfp_get_double(state, dn), vfp_get_double(state, dm), &result, &host_exceptions)) {
+            vfp_put_double(state, result, dd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     vfp_double_unpack(&vdn, vfp_get_double(state, dn));
     vfp_double_unpack(&vdm, vfp_get_double(state, dm));
 
@@ -2873,12 +2873,12 @@ VSTR_INST:
 
         if (inst_cream->single)
         {
-            Memory::Write32(addr, cpu->ExtReg[inst_cream->d]);
+            Memory::FastWrite32(addr, cpu->ExtReg[inst_cream->d]);
         }
         else
         {
-            Memory::Write32(addr, cpu->ExtReg[inst_cream->d*2]);
-            Memory::Write32(addr + 4, cpu->ExtReg[inst_cream->d*2+1]);
+            Memory::FastWrite32(addr, cpu->ExtReg[inst_cream->d*2]);
+            Memory::FastWrite32(addr + 4, cpu->ExtReg[inst_cream->d*2+1]);
         }
     }
     cpu->Reg[15] += GET_INST_SIZE(cpu);
@@ -2984,13 +2984,13 @@ VPUSH_INST:
         {
             if (inst_cream->single)
             {
-                Memory::Write32(addr, cpu->ExtReg[inst_cream->d+i]);
+                Memory::FastWrite32(addr, cpu->ExtReg[inst_cream->d+i]);
                 addr += 4;
             }
             else
             {
-                Memory::Write32(addr, cpu->ExtReg[(inst_cream->d+i)*2]);
-                Memory::Write32(addr + 4, cpu->ExtReg[(inst_cream->d+i)*2 + 1]);
+                Memory::FastWrite32(addr, cpu->ExtReg[(inst_cream->d+i)*2]);
+                Memory::FastWrite32(addr + 4, cpu->ExtReg[(inst_cream->d+i)*2 + 1]);
                 addr += 8;
             }
         }
@@ -3037,7 +3037,7 @@ int DYNCOM_TRANS(vpush)(cpu_t *cpu, uint32_t instr, BasicBlock *bb, addr_t pc){
     {
         if (single)
         {
-            //Memory::Write32(addr, cpu->ExtReg[inst_cream->d+i]);
+            //Memory::FastWrite32(addr, cpu->ExtReg[inst_cream->d+i]);
             //memory_write(cpu, bb, Addr, RSPR(d + i), 32);
             memory_write(cpu, bb, Addr, IBITCAST32(FR32(d + i)), 32);
             bb = cpu->dyncom_engine->bb;
@@ -3116,13 +3116,13 @@ VSTM_INST: /* encoding 1 */
         {
             if (inst_cream->single)
             {
-                Memory::Write32(addr, cpu->ExtReg[inst_cream->d+i]);
+                Memory::FastWrite32(addr, cpu->ExtReg[inst_cream->d+i]);
                 addr += 4;
             }
             else
             {
-                Memory::Write32(addr, cpu->ExtReg[(inst_cream->d+i)*2]);
-                Memory::Write32(addr + 4, cpu->ExtReg[(inst_cream->d+i)*2 + 1]);
+                Memory::FastWrite32(addr, cpu->ExtReg[(inst_cream->d+i)*2]);
+                Memory::FastWrite32(addr + 4, cpu->ExtReg[(inst_cream->d+i)*2 + 1]);
                 addr += 8;
             }
         }
@@ -3183,7 +3183,7 @@ int DYNCOM_TRANS(vstm)(cpu_t *cpu, uint32_t instr, BasicBlock *bb, addr_t pc){
         if (single)
         {
 
-            //Memory::Write32(addr, cpu->ExtReg[inst_cream->d+i]);
+            //Memory::FastWrite32(addr, cpu->ExtReg[inst_cream->d+i]);
             /* if R(i) is R15? */
             //memory_write(cpu, bb, Addr, RSPR(d + i), 32);
             memory_write(cpu, bb, Addr, IBITCAST32(FR32(d + i)),32);
@@ -3194,12 +3194,12 @@ int DYNCOM_TRANS(vstm)(cpu_t *cpu, uint32_t instr, BasicBlock *bb, addr_t pc){
         else
         {
 
-            //Memory::Write32(addr, cpu->ExtReg[(inst_cream->d+i)*2]);
+            //Memory::FastWrite32(addr, cpu->ExtReg[(inst_cream->d+i)*2]);
             //memory_write(cpu, bb, Addr, RSPR((d + i) * 2), 32);
             memory_write(cpu, bb, Addr, IBITCAST32(FR32((d + i) * 2)),32);
             bb = cpu->dyncom_engine->bb;
 
-            //Memory::Write32(addr + 4, cpu->ExtReg[(inst_cream->d+i)*2 + 1]);
+            //Memory::FastWrite32(addr + 4, cpu->ExtReg[(inst_cream->d+i)*2 + 1]);
             //memory_write(cpu, bb, ADD(Addr, CONST(4)), RSPR((d + i) * 2 + 1), 32);
             memory_write(cpu, bb, ADD(Addr, CONST(4)), IBITCAST32(FR32((d + i) * 2 + 1)), 32);
             bb = cpu->dyncom_engine->bb;
@@ -3267,14 +3267,14 @@ VPOP_INST:
         {
             if (inst_cream->single)
             {
-                value1 = Memory::Read32(addr);
+                value1 = Memory::FastRead32(addr);
                 cpu->ExtReg[inst_cream->d+i] = value1;
                 addr += 4;
             }
             else
             {
-                value1 = Memory::Read32(addr);
-                value2 = Memory::Read32(addr + 4);
+                value1 = Memory::FastRead32(addr);
+                value2 = Memory::FastRead32(addr + 4);
                 cpu->ExtReg[(inst_cream->d+i)*2] = value1;
                 cpu->ExtReg[(inst_cream->d+i)*2 + 1] = value2;
                 addr += 8;
@@ -3406,13 +3406,13 @@ VLDR_INST:
 
         if (inst_cream->single)
         {
-            cpu->ExtReg[inst_cream->d] = Memory::Read32(addr);
+            cpu->ExtReg[inst_cream->d] = Memory::FastRead32(addr);
         }
         else
         {
             unsigned int word1, word2;
-            word1 = Memory::Read32(addr);
-            word2 = Memory::Read32(addr + 4);
+            word1 = Memory::FastRead32(addr);
+            word2 = Memory::FastRead32(addr + 4);
 
             cpu->ExtReg[inst_cream->d*2] = word1;
             cpu->ExtReg[inst_cream->d*2+1] = word2;
@@ -3543,13 +3543,13 @@ VLDM_INST:
         {
             if (inst_cream->single)
             {
-                cpu->ExtReg[inst_cream->d+i] = Memory::Read32(addr);
+                cpu->ExtReg[inst_cream->d+i] = Memory::FastRead32(addr);
                 addr += 4;
             }
             else
             {
-                cpu->ExtReg[(inst_cream->d+i)*2] = Memory::Read32(addr);
-                cpu->ExtReg[(inst_cream->d+i)*2 + 1] = Memory::Read32(addr + 4);
+                cpu->ExtReg[(inst_cream->d+i)*2] = Memory::FastRead32(addr);
+                cpu->ExtReg[(inst_cream->d+i)*2 + 1] = Memory::FastRead32(addr + 4);
                 addr += 8;
             }
         }
@@ -3610,7 +3610,7 @@ int DYNCOM_TRANS(vldm)(cpu_t *cpu, uint32_t instr, BasicBlock *bb, addr_t pc){
         if (single)
         {
 
-            //Memory::Write32(addr, cpu->ExtReg[inst_cream->d+i]);
+            //Memory::FastWrite32(addr, cpu->ExtReg[inst_cream->d+i]);
             /* if R(i) is R15? */
             memory_read(cpu, bb, Addr, 0, 32);
             bb = cpu->dyncom_engine->bb;
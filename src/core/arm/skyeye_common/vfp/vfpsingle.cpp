@@ -959,6 +959,18 @@ vfp_single_multiply(struct vfp_single *vsd, struct vfp_single *vsn, struct vfp_s
 static u32
 vfp_single_multiply_accumulate(ARMul_State* state, int sd, int sn, s32 m, u32 fpscr, u32 negate, const char *func)
 {
+#ifdef VFP_HOST_FPU
+    {
+        u32 result, host_exceptions = 0;
+        if (vfp_host_multiply_accumulate<float>(fpscr, (u32)vfp_get_float(state, sd), (u32)vfp_get_float(state, sn),
+                                                (u32)m, (negate & NEG_MULTIPLY) != 0, (negate & NEG_SUBTRACT) != 0,
+                                                &result, &host_exceptions)) {
+            vfp_put_float(state, result, sd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     
     {
         struct vfp_single vsd, vsp, vsn, vsm;
@@ -1076,6 +1088,16 @@ static u32 vfp_single_fmul(ARMul_State* state, int sd, int sn, s32 m, u32 fpscr)
 
     pr_debug("In %sVFP: s%u = %08x\n", __FUNCTION__, sn, n);
 
+#ifdef VFP_HOST_FPU
+    {
+        u32 result, host_exceptions = 0;
+        if (vfp_host_op<float>(fpscr, VFP_HOST_MUL, (u32)n, (u32)m, &result, &host_exceptions)) {
+            vfp_put_float(state, result, sd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     vfp_single_unpack(&vsn, n);
     if (vsn.exponent == 0 && vsn.significand)
         vfp_single_normalise_denormal(&vsn);
@@ -1099,6 +1121,17 @@ static u32 vfp_single_fnmul(ARMul_State* state, int sd, int sn, s32 m, u32 fpscr
 
     pr_debug("VFP: s%u = %08x\n", sn, n);
 
+#ifdef VFP_HOST_FPU
+    {
+        u32 result, host_exceptions = 0;
+        if (vfp_host_op<float>(fpscr, VFP_HOST_MUL, (u32)n, (u32)m, &result, &host_exceptions)) {
+            result ^= 0x80000000;
+            vfp_put_float(state, result, sd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     vfp_single_unpack(&vsn, n);
     if (vsn.exponent == 0 && vsn.significand)
         vfp_single_normalise_denormal(&vsn);
@@ -1123,6 +1156,16 @@ static u32 vfp_single_fadd(ARMul_State* state, int sd, int sn, s32 m, u32 fpscr)
 
     pr_debug("VFP: s%u = %08x\n", sn, n);
 
+#ifdef VFP_HOST_FPU
+    {
+        u32 result, host_exceptions = 0;
+        if (vfp_host_op<float>(fpscr, VFP_HOST_ADD, (u32)n, (u32)m, &result, &host_exceptions)) {
+            vfp_put_float(state, result, sd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     /*
      * Unpack and normalise denormals.
      */
@@ -1166,6 +1209,16 @@ static u32 vfp_single_fdiv(ARMul_State* state, int sd, int sn, s32 m, u32 fpscr)
 
     pr_debug("VFP: s%u = %08x\n", sn, n);
 
+#ifdef VFP_HOST_FPU
+    {
+        u32 result, host_exceptions = 0;
+        if (vfp_host_op<float>(fpscr, VFP_HOST_DIV, (u32)n, (u32)m, &result, &host_exceptions)) {
+            vfp_put_float(state, result, sd);
+            return host_exceptions;
+        }
+    }
+#endif
+
     vfp_single_unpack(&vsn, n);
     vfp_single_unpack(&vsm, m);
 
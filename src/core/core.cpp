@@ -5,6 +5,7 @@
 #include "common/common_types.h"
 
 #include "core/core.h"
+#include "core/core_timing.h"
 
 #include "core/settings.h"
 #include "core/arm/disassembler/arm_disasm.h"
@@ -12,19 +13,45 @@
 #include "core/arm/dyncom/arm_dyncom.h"
 #include "core/hle/hle.h"
 #include "core/hle/kernel/thread.h"
-#include "core/hw/hw.h"
+
+#include "video_core/command_processor.h"
 
 namespace Core {
 
 static u64         last_ticks = 0;        ///< Last CPU ticks
 static ARM_Disasm* disasm     = nullptr;  ///< ARM disassembler
+static bool        deadlocked = false;    ///< No thread can run and no event can wake one up
 ARM_Interface*     g_app_core = nullptr;  ///< ARM11 application core
 ARM_Interface*     g_sys_core = nullptr;  ///< ARM11 system (OS) core
 
 /// Run the core CPU loop
-void RunLoop(int tight_loop) {
-    g_app_core->Run(tight_loop);
-    HW::Update();
+void RunLoop() {
+    // If no thread can run, only a scheduled event (a timeout, or an interrupt signalling an object)
+    // can wake one of them up. Skip straight to it instead of running the CPU.
+    if (Kernel::IsIdle()) {
+        // There's nothing left to overlap the GPU thread with, and the interrupts raised by its
+        // command lists may wake up a thread
+        Pica::CommandProcessor::WaitForIdle();
+        Kernel::Reschedule();
+        if (!Kernel::IsIdle())
+            return;
+
+        // If no event is scheduled either, the guest deadlocked. Idle still moves the time on then,
+        // so that an event scheduled from another thread can recover from this.
+        if (!CoreTiming::HasPendingEvents() && !deadlocked) {
+            LOG_CRITICAL(Core, "All threads are waiting, but no event is scheduled to wake them up");
+            deadlocked = true;
+        }
+
+        CoreTiming::Idle();
+        CoreTiming::Advance();
+        Kernel::Reschedule();
+        return;
+    }
+
+    deadlocked = false;
+    g_app_core->Run(CoreTiming::GetDowncount());
+    CoreTiming::Advance();
     if (HLE::g_reschedule) {
         Kernel::Reschedule();
     }
@@ -32,7 +59,11 @@ void RunLoop(int tight_loop) {
 
 /// Step the CPU one instruction
 void SingleStep() {
-    RunLoop(1);
+    g_app_core->Step();
+    CoreTiming::Advance();
+    if (HLE::g_reschedule) {
+        Kernel::Reschedule();
+    }
 }
 
 /// Halt the core
@@ -56,6 +87,9 @@ int Init() {
         case CPU_Interpreter:
             g_app_core = new ARM_DynCom();
             break;
+        case CPU_JIT:
+            g_app_core = new ARM_DynCom(true);
+            break;
         case CPU_OldInterpreter:
         default:
             g_app_core = new ARM_Interpreter();
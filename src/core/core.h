@@ -14,6 +14,7 @@ namespace Core {
 enum CPUCore {
     CPU_Interpreter,
     CPU_OldInterpreter,
+    CPU_JIT,
 };
 
 extern ARM_Interface*   g_app_core;     ///< ARM11 application core
@@ -26,13 +27,12 @@ void Start();
 
 /**
  * Run the core CPU loop
- * This function runs the core for the specified number of CPU instructions before trying to update
- * hardware. This is much faster than SingleStep (and should be equivalent), as the CPU is not
- * required to do a full dispatch with each instruction. NOTE: the number of instructions requested
- * is not guaranteed to run, as this will be interrupted preemptively if a hardware update is
- * requested (e.g. on a thread switch).
+ * This function runs the core until the next event scheduled with CoreTiming is due, and then
+ * fires all due events (e.g. the GPU vblank). This is much faster than SingleStep (and should be
+ * equivalent), as the CPU is not required to do a full dispatch with each instruction. NOTE: the
+ * slice is cut short if a thread switch is requested, or if an earlier event gets scheduled.
  */
-void RunLoop(int tight_loop=1000);
+void RunLoop();
 
 /// Step the CPU one instruction
 void SingleStep();
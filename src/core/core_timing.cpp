@@ -2,6 +2,7 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <vector>
 #include <cstdio>
 #include <atomic>
@@ -39,28 +40,27 @@ std::vector<EventType> event_types;
 struct BaseEvent
 {
     s64 time;
+    u64 fifo_order;
     u64 userdata;
     int type;
-    // Event *next;
 };
 
-typedef LinkedListItem<BaseEvent> Event;
+typedef BaseEvent Event;
 
-Event *first;
-Event *tsFirst;
-Event *tsLast;
+// Pending events, kept as a binary min-heap on (time, fifo_order) so that the next event to fire is
+// always at the front. Events scheduled for the same time fire in the order they were scheduled.
+static std::vector<Event> event_queue;
+static u64 event_fifo_id;
 
-// event pools
-Event *eventPool = 0;
-Event *eventTsPool = 0;
-int allocatedTsEvents = 0;
+// Events scheduled from other threads, merged into event_queue by MoveEvents on the CPU thread
+static std::vector<Event> ts_queue;
 // Optimization to skip MoveEvents when possible.
 std::atomic<u32> hasTsEvents;
 
-// Downcount has been moved to currentMIPS, to save a couple of clocks in every ARM JIT block
-// as we can already reach that structure through a register.
+// Number of cycles the CPU was asked to run for in the current slice
 int slicelength;
 
+// Tick count at the start of the current slice
 MEMORY_ALIGNED16(s64) globalTimer;
 s64 idledCycles;
 
@@ -69,6 +69,14 @@ static std::recursive_mutex externalEventSection;
 // Warning: not included in save state.
 void(*advanceCallback)(int cyclesExecuted) = nullptr;
 
+// Heap predicate: orders events so that the earliest one ends up at the front of the queue
+static bool EventLater(const Event& a, const Event& b)
+{
+    if (a.time != b.time)
+        return a.time > b.time;
+    return a.fifo_order > b.fifo_order;
+}
+
 void SetClockFrequencyMHz(int cpuMhz)
 {
     g_clock_rate_arm11 = cpuMhz * 1000000;
@@ -81,41 +89,6 @@ int GetClockFrequencyMHz()
 }
 
 
-Event* GetNewEvent()
-{
-    if (!eventPool)
-        return new Event;
-
-    Event* ev = eventPool;
-    eventPool = ev->next;
-    return ev;
-}
-
-Event* GetNewTsEvent()
-{
-    allocatedTsEvents++;
-
-    if (!eventTsPool)
-        return new Event;
-
-    Event* ev = eventTsPool;
-    eventTsPool = ev->next;
-    return ev;
-}
-
-void FreeEvent(Event* ev)
-{
-    ev->next = eventPool;
-    eventPool = ev;
-}
-
-void FreeTsEvent(Event* ev)
-{
-    ev->next = eventTsPool;
-    eventTsPool = ev;
-    allocatedTsEvents--;
-}
-
 int RegisterEvent(const char *name, TimedCallback callback)
 {
     event_types.push_back(EventType(callback, name));
@@ -138,16 +111,18 @@ void RestoreRegisterEvent(int event_type, const char *name, TimedCallback callba
 
 void UnregisterAllEvents()
 {
-    if (first)
+    if (!event_queue.empty())
         PanicAlert("Cannot unregister events with events pending");
     event_types.clear();
 }
 
 void Init()
 {
-    //currentMIPS->downcount = INITIAL_SLICE_LENGTH;
-    //slicelength = INITIAL_SLICE_LENGTH;
-    globalTimer = 0;
+    event_queue.clear();
+    ts_queue.clear();
+    event_fifo_id = 0;
+    slicelength = INITIAL_SLICE_LENGTH;
+    globalTimer = Core::g_app_core->GetTicks();
     idledCycles = 0;
     hasTsEvents = 0;
 }
@@ -157,28 +132,11 @@ void Shutdown()
     MoveEvents();
     ClearPendingEvents();
     UnregisterAllEvents();
-
-    while (eventPool)
-    {
-        Event *ev = eventPool;
-        eventPool = ev->next;
-        delete ev;
-    }
-
-    std::lock_guard<std::recursive_mutex> lk(externalEventSection);
-    while (eventTsPool)
-    {
-        Event *ev = eventTsPool;
-        eventTsPool = ev->next;
-        delete ev;
-    }
 }
 
 u64 GetTicks()
 {
-    LOG_ERROR(Core, "Unimplemented function!");
-    return 0;
-    //return (u64)globalTimer + slicelength - currentMIPS->downcount;
+    return Core::g_app_core->GetTicks();
 }
 
 u64 GetIdleTicks()
@@ -192,16 +150,12 @@ u64 GetIdleTicks()
 void ScheduleEvent_Threadsafe(s64 cyclesIntoFuture, int event_type, u64 userdata)
 {
     std::lock_guard<std::recursive_mutex> lk(externalEventSection);
-    Event *ne = GetNewTsEvent();
-    ne->time = GetTicks() + cyclesIntoFuture;
-    ne->type = event_type;
-    ne->next = 0;
-    ne->userdata = userdata;
-    if (!tsFirst)
-        tsFirst = ne;
-    if (tsLast)
-        tsLast->next = ne;
-    tsLast = ne;
+    Event ne;
+    ne.time = GetTicks() + cyclesIntoFuture;
+    ne.fifo_order = 0; // Assigned once the event is moved to the main queue
+    ne.type = event_type;
+    ne.userdata = userdata;
+    ts_queue.push_back(ne);
 
     hasTsEvents.store(1, std::memory_order_release);
 }
@@ -221,30 +175,19 @@ void ScheduleEvent_Threadsafe_Immediate(int event_type, u64 userdata)
 
 void ClearPendingEvents()
 {
-    while (first)
-    {
-        Event *e = first->next;
-        FreeEvent(first);
-        first = e;
-    }
+    event_queue.clear();
 }
 
-void AddEventToQueue(Event* ne)
+static void AddEventToQueue(Event ne)
 {
-    Event* prev = nullptr;
-    Event** pNext = &first;
-    for (;;)
-    {
-        Event*& next = *pNext;
-        if (!next || ne->time < next->time)
-        {
-            ne->next = next;
-            next = ne;
-            break;
-        }
-        prev = next;
-        pNext = &prev->next;
-    }
+    ne.fifo_order = event_fifo_id++;
+    event_queue.push_back(ne);
+    std::push_heap(event_queue.begin(), event_queue.end(), EventLater);
+
+    // If the new event is due before the end of the running slice, cut the slice short so that it
+    // is not fired late. This is harmless when called between slices.
+    if (ne.time < globalTimer + slicelength)
+        Core::g_app_core->PrepareReschedule();
 }
 
 // This must be run ONLY from within the cpu thread
@@ -252,107 +195,49 @@ void AddEventToQueue(Event* ne)
 // than Advance
 void ScheduleEvent(s64 cyclesIntoFuture, int event_type, u64 userdata)
 {
-    Event *ne = GetNewEvent();
-    ne->userdata = userdata;
-    ne->type = event_type;
-    ne->time = GetTicks() + cyclesIntoFuture;
+    Event ne;
+    ne.time = GetTicks() + cyclesIntoFuture;
+    ne.type = event_type;
+    ne.userdata = userdata;
     AddEventToQueue(ne);
 }
 
-// Returns cycles left in timer.
-s64 UnscheduleEvent(int event_type, u64 userdata)
+// Removes all events in the queue matching the predicate, returning the cycles left on the last
+// one removed (or 0 if none were removed).
+template <typename Predicate>
+static s64 RemoveMatchingEvents(std::vector<Event>& queue, bool is_heap, Predicate pred)
 {
     s64 result = 0;
-    if (!first)
-        return result;
-    while (first)
-    {
-        if (first->type == event_type && first->userdata == userdata)
-        {
-            result = first->time - globalTimer;
-
-            Event *next = first->next;
-            FreeEvent(first);
-            first = next;
-        }
-        else
-        {
-            break;
-        }
-    }
-    if (!first)
+    auto it = std::remove_if(queue.begin(), queue.end(), [&](const Event& e) {
+        if (!pred(e))
+            return false;
+        result = e.time - GetTicks();
+        return true;
+    });
+
+    if (it == queue.end())
         return result;
-    Event *prev = first;
-    Event *ptr = prev->next;
-    while (ptr)
-    {
-        if (ptr->type == event_type && ptr->userdata == userdata)
-        {
-            result = ptr->time - globalTimer;
-
-            prev->next = ptr->next;
-            FreeEvent(ptr);
-            ptr = prev->next;
-        }
-        else
-        {
-            prev = ptr;
-            ptr = ptr->next;
-        }
-    }
 
+    queue.erase(it, queue.end());
+    if (is_heap)
+        std::make_heap(queue.begin(), queue.end(), EventLater);
     return result;
 }
 
+// Returns cycles left in timer.
+s64 UnscheduleEvent(int event_type, u64 userdata)
+{
+    return RemoveMatchingEvents(event_queue, true, [&](const Event& e) {
+        return e.type == event_type && e.userdata == userdata;
+    });
+}
+
 s64 UnscheduleThreadsafeEvent(int event_type, u64 userdata)
 {
-    s64 result = 0;
     std::lock_guard<std::recursive_mutex> lk(externalEventSection);
-    if (!tsFirst)
-        return result;
-    while (tsFirst)
-    {
-        if (tsFirst->type == event_type && tsFirst->userdata == userdata)
-        {
-            result = tsFirst->time - globalTimer;
-
-            Event *next = tsFirst->next;
-            FreeTsEvent(tsFirst);
-            tsFirst = next;
-        }
-        else
-        {
-            break;
-        }
-    }
-    if (!tsFirst)
-    {
-        tsLast = nullptr;
-        return result;
-    }
-
-    Event *prev = tsFirst;
-    Event *ptr = prev->next;
-    while (ptr)
-    {
-        if (ptr->type == event_type && ptr->userdata == userdata)
-        {
-            result = ptr->time - globalTimer;
-
-            prev->next = ptr->next;
-            if (ptr == tsLast)
-                tsLast = prev;
-            FreeTsEvent(ptr);
-            ptr = prev->next;
-        }
-        else
-        {
-            prev = ptr;
-            ptr = ptr->next;
-        }
-    }
-
-    return result;
+    return RemoveMatchingEvents(ts_queue, false, [&](const Event& e) {
+        return e.type == event_type && e.userdata == userdata;
+    });
 }
 
 // Warning: not included in save state.
@@ -363,97 +248,24 @@ void RegisterAdvanceCallback(void(*callback)(int cyclesExecuted))
 
 bool IsScheduled(int event_type)
 {
-    if (!first)
-        return false;
-    Event *e = first;
-    while (e) {
-        if (e->type == event_type)
-            return true;
-        e = e->next;
-    }
-    return false;
+    return std::any_of(event_queue.begin(), event_queue.end(), [&](const Event& e) {
+        return e.type == event_type;
+    });
 }
 
 void RemoveEvent(int event_type)
 {
-    if (!first)
-        return;
-    while (first)
-    {
-        if (first->type == event_type)
-        {
-            Event *next = first->next;
-            FreeEvent(first);
-            first = next;
-        }
-        else
-        {
-            break;
-        }
-    }
-    if (!first)
-        return;
-    Event *prev = first;
-    Event *ptr = prev->next;
-    while (ptr)
-    {
-        if (ptr->type == event_type)
-        {
-            prev->next = ptr->next;
-            FreeEvent(ptr);
-            ptr = prev->next;
-        }
-        else
-        {
-            prev = ptr;
-            ptr = ptr->next;
-        }
-    }
+    RemoveMatchingEvents(event_queue, true, [&](const Event& e) {
+        return e.type == event_type;
+    });
 }
 
 void RemoveThreadsafeEvent(int event_type)
 {
     std::lock_guard<std::recursive_mutex> lk(externalEventSection);
-    if (!tsFirst)
-    {
-        return;
-    }
-    while (tsFirst)
-    {
-        if (tsFirst->type == event_type)
-        {
-            Event *next = tsFirst->next;
-            FreeTsEvent(tsFirst);
-            tsFirst = next;
-        }
-        else
-        {
-            break;
-        }
-    }
-    if (!tsFirst)
-    {
-        tsLast = nullptr;
-        return;
-    }
-    Event *prev = tsFirst;
-    Event *ptr = prev->next;
-    while (ptr)
-    {
-        if (ptr->type == event_type)
-        {
-            prev->next = ptr->next;
-            if (ptr == tsLast)
-                tsLast = prev;
-            FreeTsEvent(ptr);
-            ptr = prev->next;
-        }
-        else
-        {
-            prev = ptr;
-            ptr = ptr->next;
-        }
-    }
+    RemoveMatchingEvents(ts_queue, false, [&](const Event& e) {
+        return e.type == event_type;
+    });
 }
 
 void RemoveAllEvents(int event_type)
@@ -462,24 +274,20 @@ void RemoveAllEvents(int event_type)
     RemoveEvent(event_type);
 }
 
-//This raise only the events required while the fifo is processing data
+// Fires all events which are due at the current tick count
 void ProcessFifoWaitEvents()
 {
-    while (first)
+    const s64 now = GetTicks();
+    while (!event_queue.empty() && event_queue.front().time <= now)
     {
-        if (first->time <= globalTimer)
-        {
-            //LOG(TIMER, "[Scheduler] %s (%lld, %lld) ",
-            //    first->name ? first->name : "?", (u64)globalTimer, (u64)first->time);
-            Event* evt = first;
-            first = first->next;
-            event_types[evt->type].callback(evt->userdata, (int)(globalTimer - evt->time));
-            FreeEvent(evt);
-        }
-        else
-        {
-            break;
-        }
+        // Pop before calling back, as the callback may schedule new events
+        Event evt = event_queue.front();
+        std::pop_heap(event_queue.begin(), event_queue.end(), EventLater);
+        event_queue.pop_back();
+
+        //LOG(TIMER, "[Scheduler] %s (%lld, %lld) ",
+        //    event_types[evt.type].name, now, evt.time);
+        event_types[evt.type].callback(evt.userdata, (int)(now - evt.time));
     }
 }
 
@@ -489,118 +297,103 @@ void MoveEvents()
 
     std::lock_guard<std::recursive_mutex> lk(externalEventSection);
     // Move events from async queue into main queue
-    while (tsFirst)
-    {
-        Event *next = tsFirst->next;
-        AddEventToQueue(tsFirst);
-        tsFirst = next;
-    }
-    tsLast = nullptr;
+    for (const Event& ev : ts_queue)
+        AddEventToQueue(ev);
+    ts_queue.clear();
+}
 
-    // Move free events to threadsafe pool
-    while (allocatedTsEvents > 0 && eventPool)
-    {
-        Event *ev = eventPool;
-        eventPool = ev->next;
-        ev->next = eventTsPool;
-        eventTsPool = ev;
-        allocatedTsEvents--;
-    }
+int GetDowncount()
+{
+    if (hasTsEvents.load(std::memory_order_acquire))
+        MoveEvents();
+
+    globalTimer = GetTicks();
+
+    s64 downcount = MAX_SLICE_LENGTH;
+    if (!event_queue.empty())
+        downcount = event_queue.front().time - globalTimer;
+
+    // Always run at least one instruction, so that an event which is already due is handled by
+    // the Advance which follows this slice.
+    slicelength = (int)std::max<s64>(1, std::min<s64>(downcount, MAX_SLICE_LENGTH));
+    return slicelength;
 }
 
 void Advance()
 {
-    LOG_ERROR(Core, "Unimplemented function!");
-    //int cyclesExecuted = slicelength - currentMIPS->downcount;
-    //globalTimer += cyclesExecuted;
-    //currentMIPS->downcount = slicelength;
-
-    //if (Common::AtomicLoadAcquire(hasTsEvents))
-    //    MoveEvents();
-    //ProcessFifoWaitEvents();
-
-    //if (!first)
-    //{
-    //    // WARN_LOG(TIMER, "WARNING - no events in queue. Setting currentMIPS->downcount to 10000");
-    //    currentMIPS->downcount += 10000;
-    //}
-    //else
-    //{
-    //    slicelength = (int)(first->time - globalTimer);
-    //    if (slicelength > MAX_SLICE_LENGTH)
-    //        slicelength = MAX_SLICE_LENGTH;
-    //    currentMIPS->downcount = slicelength;
-    //}
-    //if (advanceCallback)
-    //    advanceCallback(cyclesExecuted);
+    int cyclesExecuted = (int)(GetTicks() - globalTimer);
+
+    if (hasTsEvents.load(std::memory_order_acquire))
+        MoveEvents();
+    ProcessFifoWaitEvents();
+
+    globalTimer = GetTicks();
+
+    if (advanceCallback)
+        advanceCallback(cyclesExecuted);
 }
 
 void LogPendingEvents()
 {
-    Event *ptr = first;
-    while (ptr)
+    for (const Event& ev : event_queue)
     {
-        //INFO_LOG(TIMER, "PENDING: Now: %lld Pending: %lld Type: %d", globalTimer, ptr->time, ptr->type);
-        ptr = ptr->next;
+        LOG_INFO(Core, "PENDING: Now: %lld Pending: %lld Type: %s", (long long)GetTicks(),
+                 (long long)ev.time, event_types[ev.type].name);
     }
 }
 
-void Idle(int maxIdle)
+bool HasPendingEvents()
 {
-    LOG_ERROR(Core, "Unimplemented function!");
-    //int cyclesDown = currentMIPS->downcount;
-    //if (maxIdle != 0 && cyclesDown > maxIdle)
-    //    cyclesDown = maxIdle;
+    if (hasTsEvents.load(std::memory_order_acquire))
+        MoveEvents();
+
+    return !event_queue.empty();
+}
 
-    //if (first && cyclesDown > 0)
-    //{
-    //    int cyclesExecuted = slicelength - currentMIPS->downcount;
-    //    int cyclesNextEvent = (int) (first->time - globalTimer);
+void Idle(int maxIdle)
+{
+    // Without any event, nothing but one scheduled from another thread can end the idling. Skip a
+    // full slice then, so that the emulated time still moves on.
+    s64 cyclesDown = MAX_SLICE_LENGTH;
+    if (HasPendingEvents())
+        cyclesDown = event_queue.front().time - (s64)GetTicks();
+    if (maxIdle != 0 && cyclesDown > maxIdle)
+        cyclesDown = maxIdle;
 
-    //    if (cyclesNextEvent < cyclesExecuted + cyclesDown)
-    //    {
-    //        cyclesDown = cyclesNextEvent - cyclesExecuted;
-    //        // Now, now... no time machines, please.
-    //        if (cyclesDown < 0)
-    //            cyclesDown = 0;
-    //    }
-    //}
+    // Now, now... no time machines, please.
+    if (cyclesDown <= 0)
+        return;
 
-    //INFO_LOG(TIME, "Idle for %i cycles! (%f ms)", cyclesDown, cyclesDown / (float)(g_clock_rate_arm11 * 0.001f));
+    LOG_TRACE(Core, "Idle for %lld cycles! (%f ms)", (long long)cyclesDown, cyclesDown / (float)(g_clock_rate_arm11 * 0.001f));
 
-    //idledCycles += cyclesDown;
-    //currentMIPS->downcount -= cyclesDown;
-    //if (currentMIPS->downcount == 0)
-    //    currentMIPS->downcount = -1;
+    idledCycles += cyclesDown;
+    Core::g_app_core->AddTicks(cyclesDown);
 }
 
 std::string GetScheduledEventsSummary()
 {
-    Event *ptr = first;
+    std::vector<Event> events(event_queue);
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+        return EventLater(b, a);
+    });
+
     std::string text = "Scheduled events\n";
     text.reserve(1000);
-    while (ptr)
+    for (const Event& ev : events)
     {
-        unsigned int t = ptr->type;
+        unsigned int t = ev.type;
         if (t >= event_types.size())
             PanicAlert("Invalid event type"); // %i", t);
-        const char *name = event_types[ptr->type].name;
+        const char *name = event_types[ev.type].name;
         if (!name)
             name = "[unknown]";
 
-        text += Common::StringFromFormat("%s : %i %08x%08x\n", name, (int)ptr->time,
-                                        (u32)(ptr->userdata >> 32), (u32)(ptr->userdata));
-
-        ptr = ptr->next;
+        text += Common::StringFromFormat("%s : %i %08x%08x\n", name, (int)ev.time,
+                                        (u32)(ev.userdata >> 32), (u32)(ev.userdata));
     }
     return text;
 }
 
-void Event_DoState(PointerWrap &p, BaseEvent *ev)
-{
-    p.Do(*ev);
-}
-
 void DoState(PointerWrap &p)
 {
     std::lock_guard<std::recursive_mutex> lk(externalEventSection);
@@ -614,8 +407,9 @@ void DoState(PointerWrap &p)
     // These (should) be filled in later by the modules.
     event_types.resize(n, EventType(AntiCrashCallback, "INVALID EVENT"));
 
-    p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoState>(first, (Event **)nullptr);
-    p.DoLinkedList<BaseEvent, GetNewTsEvent, FreeTsEvent, Event_DoState>(tsFirst, &tsLast);
+    p.Do(event_queue);
+    p.Do(event_fifo_id);
+    p.Do(ts_queue);
 
     p.Do(g_clock_rate_arm11);
     p.Do(slicelength);
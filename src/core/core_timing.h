@@ -10,7 +10,8 @@
 // To schedule an event, you first have to register its type. This is where you pass in the
 // callback. You then schedule events using the type id you get back.
 
-// See HW/SystemTimers.cpp for the main part of Dolphin's usage of this scheduler.
+// The CPU runs in slices which end at the next scheduled event (see GetDowncount), after which
+// Advance fires all events which have become due. See HW/GPU.cpp for the vblank event.
 
 // The int cyclesLate that the callbacks get is how many cycles late it was.
 // So to schedule a new event on a regular basis:
@@ -51,6 +52,12 @@ inline s64 usToCycles(u64 us) {
     return (s64)(g_clock_rate_arm11 / 1000000 * us);
 }
 
+inline s64 nsToCycles(s64 ns) {
+    // Split the multiplication so that long timeouts don't overflow
+    return g_clock_rate_arm11 * (ns / 1000000000) +
+           g_clock_rate_arm11 * (ns % 1000000000) / 1000000000;
+}
+
 inline s64 cyclesToUs(s64 cycles) {
     return cycles / (g_clock_rate_arm11 / 1000000);
 }
@@ -83,10 +90,21 @@ void RemoveEvent(int event_type);
 void RemoveThreadsafeEvent(int event_type);
 void RemoveAllEvents(int event_type);
 bool IsScheduled(int event_type);
+
+/**
+ * Gets the number of cycles the CPU should run for before the next call to Advance, i.e. the
+ * number of cycles until the next scheduled event (clamped to a maximum slice length).
+ */
+int GetDowncount();
+
+/// Fires all events which are due, to be called after the CPU has run for a slice
 void Advance();
 void MoveEvents();
 void ProcessFifoWaitEvents();
 
+/// Returns whether any event is scheduled, including those scheduled from other threads
+bool HasPendingEvents();
+
 // Pretend that the main CPU has executed enough cycles to reach the next event.
 void Idle(int maxIdle = 0);
 
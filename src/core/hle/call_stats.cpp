@@ -0,0 +1,138 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "common/file_util.h"
+#include "common/string_util.h"
+
+#include "core/core.h"
+#include "core/hle/call_stats.h"
+
+namespace HLE {
+namespace CallStats {
+
+static std::atomic<bool> enabled(false);
+
+// Calls are recorded on the emulation thread, and snapshots may be taken from a frontend thread
+static std::mutex stats_mutex;
+static std::map<std::pair<std::string, u32>, FunctionStats> function_stats;
+
+static s64 GetHostNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void SetEnabled(bool enable) {
+    enabled.store(enable, std::memory_order_relaxed);
+}
+
+bool IsEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+std::vector<FunctionStats> GetSnapshot() {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+
+    std::vector<FunctionStats> snapshot;
+    snapshot.reserve(function_stats.size());
+    for (const auto& entry : function_stats)
+        snapshot.push_back(entry.second);
+    return snapshot;
+}
+
+void Reset() {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    function_stats.clear();
+}
+
+std::string FormatCSV(const std::vector<FunctionStats>& stats) {
+    std::string csv = "group,name,id,calls,total_host_ns,max_host_ns,total_ticks\n";
+    for (const FunctionStats& function : stats) {
+        csv += Common::StringFromFormat("%s,%s,0x%08X,%llu,%llu,%llu,%llu\n",
+            function.group.c_str(), function.name.c_str(), function.id,
+            (unsigned long long)function.call_count, (unsigned long long)function.total_host_ns,
+            (unsigned long long)function.max_host_ns, (unsigned long long)function.total_ticks);
+    }
+    return csv;
+}
+
+/// Quotes a string for JSON, escaping the characters that would end it
+static std::string QuoteJSON(const std::string& str) {
+    std::string quoted = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+std::string FormatJSON(const std::vector<FunctionStats>& stats) {
+    std::string json = "[\n";
+    for (size_t i = 0; i < stats.size(); ++i) {
+        const FunctionStats& function = stats[i];
+        json += Common::StringFromFormat("  {\"group\": %s, \"name\": %s, \"id\": %u, \"calls\": %llu, "
+            "\"total_host_ns\": %llu, \"max_host_ns\": %llu, \"total_ticks\": %llu}%s\n",
+            QuoteJSON(function.group).c_str(), QuoteJSON(function.name).c_str(), function.id,
+            (unsigned long long)function.call_count, (unsigned long long)function.total_host_ns,
+            (unsigned long long)function.max_host_ns, (unsigned long long)function.total_ticks,
+            (i + 1 < stats.size()) ? "," : "");
+    }
+    return json + "]\n";
+}
+
+bool DumpToFile(const std::string& filename) {
+    const std::string json_extension = ".json";
+    bool json = filename.size() >= json_extension.size() &&
+        filename.compare(filename.size() - json_extension.size(), json_extension.size(), json_extension) == 0;
+
+    std::vector<FunctionStats> snapshot = GetSnapshot();
+    std::string contents = json ? FormatJSON(snapshot) : FormatCSV(snapshot);
+
+    FileUtil::IOFile file(filename, "w");
+    if (!file.IsOpen()) {
+        LOG_ERROR(Kernel, "Could not open %s to dump HLE call statistics", filename.c_str());
+        return false;
+    }
+    file.WriteBytes(contents.data(), contents.size());
+    return file.IsGood();
+}
+
+void ScopedCall::Start() {
+    start_ticks = Core::g_app_core->GetTicks();
+    start_host_ns = GetHostNanoseconds();
+}
+
+void ScopedCall::Finish() {
+    u64 host_ns = static_cast<u64>(GetHostNanoseconds() - start_host_ns);
+    u64 ticks = Core::g_app_core->GetTicks() - start_ticks;
+
+    std::lock_guard<std::mutex> lock(stats_mutex);
+
+    auto inserted = function_stats.insert(std::make_pair(std::make_pair(group, id), FunctionStats()));
+    FunctionStats& function = inserted.first->second;
+    if (inserted.second) {
+        function.group = group;
+        function.name = (name != nullptr) ? name : Common::StringFromFormat("0x%08X", id);
+        function.id = id;
+        function.call_count = 0;
+        function.total_host_ns = 0;
+        function.max_host_ns = 0;
+        function.total_ticks = 0;
+    }
+
+    ++function.call_count;
+    function.total_host_ns += host_ns;
+    function.max_host_ns = std::max(function.max_host_ns, host_ns);
+    function.total_ticks += ticks;
+}
+
+} // namespace
+} // namespace
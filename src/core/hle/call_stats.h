@@ -0,0 +1,93 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "common/common.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Namespace CallStats
+//
+// Records how many times each HLE function (SVCs and IPC commands of services and FS sessions) is
+// called, and how much host time and emulated time it takes. Recording is disabled by default.
+
+namespace HLE {
+namespace CallStats {
+
+/// Accumulated costs of one HLE function
+struct FunctionStats {
+    std::string group;      ///< "SVC", the port name of a service, or the kind of FS session
+    std::string name;       ///< Name of the function, or its id in hex if it has none
+    u32 id;                 ///< SVC number or IPC command header
+    u64 call_count;         ///< Number of calls
+    u64 total_host_ns;      ///< Host time spent in all of the calls, in nanoseconds
+    u64 max_host_ns;        ///< Host time spent in the longest call, in nanoseconds
+    u64 total_ticks;        ///< Emulated CPU ticks spent in all of the calls
+};
+
+/// Starts or stops recording HLE calls
+void SetEnabled(bool enabled);
+
+/// Returns whether HLE calls are being recorded
+bool IsEnabled();
+
+/// Returns the statistics of all the functions called since the last reset, sorted by group and id
+std::vector<FunctionStats> GetSnapshot();
+
+/// Clears the recorded statistics
+void Reset();
+
+/// Formats statistics as CSV, with a header line followed by one line per function
+std::string FormatCSV(const std::vector<FunctionStats>& stats);
+
+/// Formats statistics as a JSON array, with one object per function
+std::string FormatJSON(const std::vector<FunctionStats>& stats);
+
+/**
+ * Writes a snapshot of the statistics to a file
+ * @param filename Path of the file, written as JSON if it ends in ".json" and as CSV otherwise
+ * @return Whether the file could be written
+ */
+bool DumpToFile(const std::string& filename);
+
+/**
+ * Measures an HLE call from its construction to its destruction, and adds it to the statistics of
+ * the function. If recording is disabled, this only checks the flag and stores the pointers.
+ */
+class ScopedCall : NonCopyable {
+public:
+    /**
+     * @param group "SVC", the port name of a service, or the kind of FS session. Has to outlive
+     *        the call.
+     * @param id SVC number or IPC command header
+     * @param name Name of the function, nullptr if it has none
+     */
+    ScopedCall(const char* group, u32 id, const char* name)
+        : active(IsEnabled()), group(group), id(id), name(name) {
+        if (active)
+            Start();
+    }
+
+    ~ScopedCall() {
+        if (active)
+            Finish();
+    }
+
+private:
+    void Start();
+    void Finish();
+
+    bool active;
+    const char* group;
+    u32 id;
+    const char* name;
+    s64 start_host_ns;
+    u64 start_ticks;
+};
+
+} // namespace
+} // namespace
@@ -5,6 +5,7 @@
 #include <vector>
 
 #include "core/mem_map.h"
+#include "core/hle/call_stats.h"
 #include "core/hle/hle.h"
 #include "core/hle/kernel/thread.h"
 #include "core/hle/service/service.h"
@@ -35,6 +36,7 @@ void CallSVC(u32 opcode) {
         return;
     }
     if (info->func) {
+        CallStats::ScopedCall stats("SVC", opcode & 0xFF, info->name.c_str());
         info->func();
     } else {
         LOG_ERROR(Kernel_SVC, "unimplemented SVC function %s(..)", info->name.c_str());
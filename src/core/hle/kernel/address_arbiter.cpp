@@ -39,8 +39,10 @@ ResultCode ArbitrateAddress(Handle handle, ArbitrationType type, u32 address, s3
             ArbitrateAllThreads(handle, address);
         } else {
             // Resume first N threads
-            for(int i = 0; i < value; i++)
-                ArbitrateHighestPriorityThread(handle, address);
+            for(int i = 0; i < value; i++) {
+                if (ArbitrateHighestPriorityThread(handle, address) == 0)
+                    break;
+            }
         }
         break;
 
@@ -27,16 +27,13 @@ public:
 
     bool locked;                            ///< Event signal wait
     bool permanent_locked;                  ///< Hack - to set event permanent state (for easy passthrough)
-    std::vector<Handle> waiting_threads;    ///< Threads that are waiting for the event
+    WaitQueue waiting_threads;              ///< Threads that are waiting for the event
     std::string name;                       ///< Name of event (optional)
 
     ResultVal<bool> WaitSynchronization() override {
         bool wait = locked;
         if (locked) {
-            Handle thread = GetCurrentThreadHandle();
-            if (std::find(waiting_threads.begin(), waiting_threads.end(), thread) == waiting_threads.end()) {
-                waiting_threads.push_back(thread);
-            }
+            waiting_threads.Add(GetCurrentThreadHandle());
             Kernel::WaitCurrentThread(WAITTYPE_EVENT, GetHandle());
         }
         if (reset_type != RESETTYPE_STICKY && !permanent_locked) {
@@ -44,6 +41,17 @@ public:
         }
         return MakeResult<bool>(wait);
     }
+
+    void RemoveWaitingThread(Handle thread) override {
+        waiting_threads.Remove(thread);
+    }
+
+    void UndoAcquire(Handle thread) override {
+        // Acquiring a non-sticky event reset it, so mark it signalled again. Waiting threads are
+        // left alone, the next signal or wait decides which thread gets the event.
+        if (reset_type != RESETTYPE_STICKY && !permanent_locked)
+            locked = false;
+    }
 };
 
 /**
@@ -87,8 +95,8 @@ ResultCode SignalEvent(const Handle handle) {
 
     // Resume threads waiting for event to signal
     bool event_caught = false;
-    for (size_t i = 0; i < evt->waiting_threads.size(); ++i) {
-        ResumeThreadFromWait( evt->waiting_threads[i]);
+    for (Handle thread : evt->waiting_threads.PopAll()) {
+        ResumeThreadFromWaitObject(thread, handle);
 
         // If any thread is signalled awake by this event, assume the event was "caught" and reset
         // the event. This will result in the next thread waiting on the event to block. Otherwise,
@@ -96,7 +104,6 @@ ResultCode SignalEvent(const Handle handle) {
         // not block. Not sure if this is correct behavior, but it seems to work.
         event_caught = true;
     }
-    evt->waiting_threads.clear();
 
     if (!evt->permanent_locked) {
         evt->locked = event_caught;
@@ -66,6 +66,20 @@ public:
         return UnimplementedFunction(ErrorModule::Kernel);
     }
 
+    /**
+     * Stops a thread from waiting on this object, e.g. because its wait timed out or another
+     * object it was waiting on woke it up first.
+     * @param thread Handle of the thread which no longer waits
+     */
+    virtual void RemoveWaitingThread(Handle thread) {}
+
+    /**
+     * Gives the object back after a thread acquired it through a wait which ended without being
+     * satisfied, i.e. a wait on all of several objects which timed out or was only a poll.
+     * @param thread Handle of the thread which acquired the object
+     */
+    virtual void UndoAcquire(Handle thread) {}
+
 private:
     friend void intrusive_ptr_add_ref(Object*);
     friend void intrusive_ptr_release(Object*);
@@ -24,10 +24,16 @@ public:
     bool initial_locked;                        ///< Initial lock state when mutex was created
     bool locked;                                ///< Current locked state
     Handle lock_thread;                         ///< Handle to thread that currently has mutex
-    std::vector<Handle> waiting_threads;        ///< Threads that are waiting for the mutex
+    WaitQueue waiting_threads;                  ///< Threads that are waiting for the mutex
     std::string name;                           ///< Name of mutex (optional)
 
     ResultVal<bool> WaitSynchronization() override;
+
+    void RemoveWaitingThread(Handle thread) override {
+        waiting_threads.Remove(thread);
+    }
+
+    void UndoAcquire(Handle thread) override;
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -47,7 +53,7 @@ void MutexAcquireLock(Mutex* mutex, Handle thread = GetCurrentThreadHandle()) {
 
 bool ReleaseMutexForThread(Mutex* mutex, Handle thread) {
     MutexAcquireLock(mutex, thread);
-    Kernel::ResumeThreadFromWait(thread);
+    Kernel::ResumeThreadFromWaitObject(thread, mutex->GetHandle());
     return true;
 }
 
@@ -57,16 +63,14 @@ bool ReleaseMutexForThread(Mutex* mutex, Handle thread) {
  */
 void ResumeWaitingThread(Mutex* mutex) {
     // Find the next waiting thread for the mutex...
-    if (mutex->waiting_threads.empty()) {
+    if (mutex->waiting_threads.IsEmpty()) {
         // Reset mutex lock thread handle, nothing is waiting
         mutex->locked = false;
         mutex->lock_thread = -1;
     }
     else {
-        // Resume the next waiting thread and re-lock the mutex
-        std::vector<Handle>::iterator iter = mutex->waiting_threads.begin();
-        ReleaseMutexForThread(mutex, *iter);
-        mutex->waiting_threads.erase(iter);
+        // Resume the highest priority waiting thread and re-lock the mutex
+        ReleaseMutexForThread(mutex, mutex->waiting_threads.PopHighestPriority());
     }
 }
 
@@ -168,7 +172,7 @@ Handle CreateMutex(bool initial_locked, const std::string& name) {
 ResultVal<bool> Mutex::WaitSynchronization() {
     bool wait = locked;
     if (locked) {
-        waiting_threads.push_back(GetCurrentThreadHandle());
+        waiting_threads.Add(GetCurrentThreadHandle());
         Kernel::WaitCurrentThread(WAITTYPE_MUTEX, GetHandle());
     } else {
         // Lock the mutex when the first thread accesses it
@@ -178,4 +182,10 @@ ResultVal<bool> Mutex::WaitSynchronization() {
 
     return MakeResult<bool>(wait);
 }
+
+void Mutex::UndoAcquire(Handle thread) {
+    if (locked && lock_thread == thread)
+        ReleaseMutex(this);
+}
+
 } // namespace
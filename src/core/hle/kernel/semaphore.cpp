@@ -2,8 +2,6 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
-#include <queue>
-
 #include "common/common.h"
 
 #include "core/hle/kernel/kernel.h"
@@ -22,7 +20,7 @@ public:
 
     s32 max_count;                              ///< Maximum number of simultaneous holders the semaphore can have
     s32 available_count;                        ///< Number of free slots left in the semaphore
-    std::queue<Handle> waiting_threads;         ///< Threads that are waiting for the semaphore
+    WaitQueue waiting_threads;                  ///< Threads that are waiting for the semaphore
     std::string name;                           ///< Name of semaphore (optional)
 
     /**
@@ -38,13 +36,36 @@ public:
 
         if (wait) {
             Kernel::WaitCurrentThread(WAITTYPE_SEMA, GetHandle());
-            waiting_threads.push(GetCurrentThreadHandle());
+            waiting_threads.Add(GetCurrentThreadHandle());
         } else {
             --available_count;
         }
 
         return MakeResult<bool>(wait);
     }
+
+    void RemoveWaitingThread(Handle thread) override {
+        waiting_threads.Remove(thread);
+    }
+
+    void UndoAcquire(Handle thread) override {
+        Release(1);
+    }
+
+    /**
+     * Frees slots of the semaphore, and hands them to the waiting threads
+     * @param release_count Number of slots to free
+     */
+    void Release(s32 release_count) {
+        available_count += release_count;
+
+        // Notify some of the threads that the semaphore has been released
+        // stop once the semaphore is full again or there are no more waiting threads
+        while (!waiting_threads.IsEmpty() && IsAvailable()) {
+            Kernel::ResumeThreadFromWaitObject(waiting_threads.PopHighestPriority(), GetHandle());
+            --available_count;
+        }
+    }
 };
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -79,15 +100,7 @@ ResultCode ReleaseSemaphore(s32* count, Handle handle, s32 release_count) {
                           ErrorSummary::InvalidArgument, ErrorLevel::Permanent);
 
     *count = semaphore->available_count;
-    semaphore->available_count += release_count;
-
-    // Notify some of the threads that the semaphore has been released
-    // stop once the semaphore is full again or there are no more waiting threads
-    while (!semaphore->waiting_threads.empty() && semaphore->IsAvailable()) {
-        Kernel::ResumeThreadFromWait(semaphore->waiting_threads.front());
-        semaphore->waiting_threads.pop();
-        --semaphore->available_count;
-    }
+    semaphore->Release(release_count);
 
     return RESULT_SUCCESS;
 }
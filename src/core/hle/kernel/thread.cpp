@@ -11,6 +11,7 @@
 #include "common/thread_queue_list.h"
 
 #include "core/core.h"
+#include "core/core_timing.h"
 #include "core/hle/hle.h"
 #include "core/hle/kernel/kernel.h"
 #include "core/hle/kernel/thread.h"
@@ -38,16 +39,17 @@ public:
     ResultVal<bool> WaitSynchronization() override {
         const bool wait = status != THREADSTATUS_DORMANT;
         if (wait) {
-            Handle thread = GetCurrentThreadHandle();
-            if (std::find(waiting_threads.begin(), waiting_threads.end(), thread) == waiting_threads.end()) {
-                waiting_threads.push_back(thread);
-            }
+            waiting_threads.Add(GetCurrentThreadHandle());
             WaitCurrentThread(WAITTYPE_THREADEND, this->GetHandle());
         }
 
         return MakeResult<bool>(wait);
     }
 
+    void RemoveWaitingThread(Handle thread) override {
+        waiting_threads.Remove(thread);
+    }
+
     ThreadContext context;
 
     u32 thread_id;
@@ -66,7 +68,12 @@ public:
     Handle wait_handle;
     VAddr wait_address;
 
-    std::vector<Handle> waiting_threads;
+    std::vector<Handle> wait_objects;   ///< Objects the thread waits on, which haven't signalled it yet
+    std::vector<Handle> acquired_objects; ///< Objects of a wait_all wait which the thread acquired already
+    bool wait_all;                      ///< Whether the thread waits until all of its objects signal it
+    bool wait_return_index;             ///< Whether to return the index of the signalling object in r1
+
+    WaitQueue waiting_threads;          ///< Threads that are waiting for this thread to end
 
     std::string name;
 };
@@ -83,6 +90,11 @@ static Thread* current_thread;
 static const u32 INITIAL_THREAD_ID = 1; ///< The first available thread id at startup
 static u32 next_thread_id; ///< The next available thread id
 
+static int thread_wakeup_event_type = -1; ///< CoreTiming event type used to wake sleeping threads
+
+// Threads waiting on address arbiters, by arbiter and address. Queues are dropped once empty.
+static std::map<std::pair<Handle, VAddr>, WaitQueue> arbiter_queues;
+
 Thread* GetCurrentThread() {
     return current_thread;
 }
@@ -152,14 +164,37 @@ static bool CheckWaitType(const Thread* thread, WaitType type) {
     return (type == thread->wait_type) && (thread->IsWaiting());
 }
 
-/// Check if a thread is blocking on a specified wait type with a specified handle
-static bool CheckWaitType(const Thread* thread, WaitType type, Handle wait_handle) {
-    return CheckWaitType(thread, type) && (wait_handle == thread->wait_handle);
+/// Removes a thread from the waiter lists of all the kernel objects it still waits on
+static void StopWaitingOnObjects(Thread* thread) {
+    for (Handle handle : thread->wait_objects) {
+        Object* object = g_handle_table.GetGeneric(handle);
+        if (object != nullptr)
+            object->RemoveWaitingThread(thread->GetHandle());
+    }
+    thread->wait_objects.clear();
+    thread->acquired_objects.clear();
 }
 
-/// Check if a thread is blocking on a specified wait type with a specified handle and address
-static bool CheckWaitType(const Thread* thread, WaitType type, Handle wait_handle, VAddr wait_address) {
-    return CheckWaitType(thread, type, wait_handle) && (wait_address == thread->wait_address);
+/// Sets a register of a thread, in the CPU if it's the running thread, otherwise in its saved context
+static void SetThreadRegister(Thread* thread, int index, u32 value) {
+    if (thread == GetCurrentThread())
+        Core::g_app_core->SetReg(index, value);
+    else
+        thread->context.cpu_registers[index] = value;
+}
+
+/// Removes a thread which is waiting on an address arbiter from the queue of the arbiter
+static void RemoveFromArbiterQueue(Thread* thread) {
+    if (!CheckWaitType(thread, WAITTYPE_ARB))
+        return;
+
+    auto queue = arbiter_queues.find(std::make_pair(thread->wait_handle, thread->wait_address));
+    if (queue == arbiter_queues.end())
+        return;
+
+    queue->second.Remove(thread->GetHandle());
+    if (queue->second.IsEmpty())
+        arbiter_queues.erase(queue);
 }
 
 /// Stops the current thread
@@ -170,15 +205,14 @@ ResultCode StopThread(Handle handle, const char* reason) {
     // Release all the mutexes that this thread holds
     ReleaseThreadMutexes(handle);
 
+    RemoveFromArbiterQueue(thread);
+    StopWaitingOnObjects(thread);
+    CoreTiming::UnscheduleEvent(thread_wakeup_event_type, handle);
+
     ChangeReadyState(thread, false);
     thread->status = THREADSTATUS_DORMANT;
-    for (Handle waiting_handle : thread->waiting_threads) {
-        Thread* waiting_thread = g_handle_table.Get<Thread>(waiting_handle);
-
-        if (CheckWaitType(waiting_thread, WAITTYPE_THREADEND, handle))
-            ResumeThreadFromWait(waiting_handle);
-    }
-    thread->waiting_threads.clear();
+    for (Handle waiting_handle : thread->waiting_threads.PopAll())
+        ResumeThreadFromWaitObject(waiting_handle, handle);
 
     // Stopped threads are never waiting.
     thread->wait_type = WAITTYPE_NONE;
@@ -205,41 +239,29 @@ void ChangeThreadState(Thread* t, ThreadStatus new_status) {
 
 /// Arbitrate the highest priority thread that is waiting
 Handle ArbitrateHighestPriorityThread(u32 arbiter, u32 address) {
-    Handle highest_priority_thread = 0;
-    s32 priority = THREADPRIO_LOWEST;
-
-    // Iterate through threads, find highest priority thread that is waiting to be arbitrated...
-    for (Handle handle : thread_queue) {
-        Thread* thread = g_handle_table.Get<Thread>(handle);
-
-        if (!CheckWaitType(thread, WAITTYPE_ARB, arbiter, address))
-            continue;
+    auto queue = arbiter_queues.find(std::make_pair(arbiter, address));
+    if (queue == arbiter_queues.end())
+        return 0;
 
-        if (thread == nullptr)
-            continue; // TODO(yuriks): Thread handle will hang around forever. Should clean up.
-
-        if(thread->current_priority <= priority) {
-            highest_priority_thread = handle;
-            priority = thread->current_priority;
-        }
-    }
-    // If a thread was arbitrated, resume it
-    if (0 != highest_priority_thread)
-        ResumeThreadFromWait(highest_priority_thread);
+    Handle highest_priority_thread = queue->second.PopHighestPriority();
+    if (queue->second.IsEmpty())
+        arbiter_queues.erase(queue);
 
+    ResumeThreadFromWait(highest_priority_thread);
     return highest_priority_thread;
 }
 
 /// Arbitrate all threads currently waiting
 void ArbitrateAllThreads(u32 arbiter, u32 address) {
+    auto queue = arbiter_queues.find(std::make_pair(arbiter, address));
+    if (queue == arbiter_queues.end())
+        return;
 
-    // Iterate through threads, find highest priority thread that is waiting to be arbitrated...
-    for (Handle handle : thread_queue) {
-        Thread* thread = g_handle_table.Get<Thread>(handle);
+    std::vector<Handle> waiting_threads = queue->second.PopAll();
+    arbiter_queues.erase(queue);
 
-        if (CheckWaitType(thread, WAITTYPE_ARB, arbiter, address))
-            ResumeThreadFromWait(handle);
-    }
+    for (Handle handle : waiting_threads)
+        ResumeThreadFromWait(handle);
 }
 
 /// Calls a thread by marking it as "ready" (note: will not actually execute until current thread yields)
@@ -293,6 +315,7 @@ Thread* NextThread() {
 
 void WaitCurrentThread(WaitType wait_type, Handle wait_handle) {
     Thread* thread = GetCurrentThread();
+    RemoveFromArbiterQueue(thread);
     thread->wait_type = wait_type;
     thread->wait_handle = wait_handle;
     ChangeThreadState(thread, ThreadStatus(THREADSTATUS_WAIT | (thread->status & THREADSTATUS_SUSPEND)));
@@ -301,12 +324,18 @@ void WaitCurrentThread(WaitType wait_type, Handle wait_handle) {
 void WaitCurrentThread(WaitType wait_type, Handle wait_handle, VAddr wait_address) {
     WaitCurrentThread(wait_type, wait_handle);
     GetCurrentThread()->wait_address = wait_address;
+
+    if (wait_type == WAITTYPE_ARB)
+        arbiter_queues[std::make_pair(wait_handle, wait_address)].Add(GetCurrentThreadHandle());
 }
 
 /// Resumes a thread from waiting by marking it as "ready"
 void ResumeThreadFromWait(Handle handle) {
     Thread* thread = Kernel::g_handle_table.Get<Thread>(handle);
     if (thread) {
+        RemoveFromArbiterQueue(thread);
+        StopWaitingOnObjects(thread);
+        CoreTiming::UnscheduleEvent(thread_wakeup_event_type, handle);
         thread->status &= ~THREADSTATUS_WAIT;
         thread->wait_handle = 0;
         thread->wait_type = WAITTYPE_NONE;
@@ -316,6 +345,162 @@ void ResumeThreadFromWait(Handle handle) {
     }
 }
 
+void ResumeThreadFromWaitObject(Handle handle, Handle object) {
+    Thread* thread = Kernel::g_handle_table.Get<Thread>(handle);
+    if (thread == nullptr)
+        return;
+
+    auto wait_object = std::find(thread->wait_objects.begin(), thread->wait_objects.end(), object);
+    if (wait_object != thread->wait_objects.end()) {
+        if (thread->wait_all) {
+            // Keep waiting until the last object has been signalled as well
+            thread->acquired_objects.push_back(object);
+            thread->wait_objects.erase(wait_object);
+            if (!thread->wait_objects.empty())
+                return;
+        } else if (thread->wait_return_index) {
+            SetThreadRegister(thread, 1, static_cast<u32>(wait_object - thread->wait_objects.begin()));
+        }
+        SetThreadRegister(thread, 0, RESULT_SUCCESS.raw);
+    }
+
+    ResumeThreadFromWait(handle);
+}
+
+/// Callback that will wake up the waiting thread it was scheduled for, once its wait timed out
+static void ThreadWakeupCallback(u64 parameter, int cycles_late) {
+    Handle handle = static_cast<Handle>(parameter);
+    Thread* thread = Kernel::g_handle_table.Get<Thread>(handle);
+    if (thread == nullptr || !thread->IsWaiting())
+        return;
+
+    // Sleeping threads have no objects to wait on, and simply return success
+    if (!thread->wait_objects.empty()) {
+        SetThreadRegister(thread, 0, WaitTimeout().raw);
+
+        // A wait_all wait wasn't satisfied, so the objects it acquired so far are given back
+        std::vector<Handle> acquired_objects = std::move(thread->acquired_objects);
+        StopWaitingOnObjects(thread);
+        UndoAcquireObjects(handle, acquired_objects);
+    }
+
+    ResumeThreadFromWait(handle);
+    HLE::g_reschedule = true;
+}
+
+void WakeThreadAfterDelay(Handle handle, s64 nanoseconds) {
+    // Don't schedule a wakeup if the thread wants to wait forever
+    if (nanoseconds < 0)
+        return;
+
+    // Drop any wakeup left over from an earlier sleep, so it doesn't cut this one short
+    CoreTiming::UnscheduleEvent(thread_wakeup_event_type, handle);
+    CoreTiming::ScheduleEvent(nsToCycles(nanoseconds), thread_wakeup_event_type, handle);
+}
+
+void WaitCurrentThreadOnObjects(const std::vector<Handle>& objects,
+    const std::vector<Handle>& acquired_objects, bool wait_all, bool return_index, s64 nanoseconds) {
+
+    Thread* thread = GetCurrentThread();
+    thread->wait_objects = objects;
+    thread->acquired_objects = acquired_objects;
+    thread->wait_all = wait_all;
+    thread->wait_return_index = return_index;
+
+    WakeThreadAfterDelay(thread->GetHandle(), nanoseconds);
+}
+
+void CancelCurrentThreadWait(const std::vector<Handle>& objects) {
+    Thread* thread = GetCurrentThread();
+    for (Handle handle : objects) {
+        Object* object = g_handle_table.GetGeneric(handle);
+        if (object != nullptr)
+            object->RemoveWaitingThread(thread->GetHandle());
+    }
+
+    // The thread is still the running one, it only leaves the wait state again
+    if (thread->IsWaiting()) {
+        thread->status = (thread->status & ~THREADSTATUS_WAIT) | THREADSTATUS_RUNNING;
+        thread->wait_type = WAITTYPE_NONE;
+        thread->wait_handle = 0;
+    }
+}
+
+void UndoAcquireObjects(Handle thread, const std::vector<Handle>& objects) {
+    for (Handle handle : objects) {
+        Object* object = g_handle_table.GetGeneric(handle);
+        if (object != nullptr)
+            object->UndoAcquire(thread);
+    }
+}
+
+bool IsIdle() {
+    Thread* thread = GetCurrentThread();
+    if (thread == nullptr || (thread->status & (THREADSTATUS_RUNNING | THREADSTATUS_READY)))
+        return false;
+
+    // A thread woken up since the last reschedule is in the ready queue
+    return thread_ready_queue.empty();
+}
+
+/// Gets the current priority of a waiting thread, sorting threads which no longer exist last
+static s32 GetWaitingThreadPriority(Handle handle) {
+    Thread* thread = g_handle_table.Get<Thread>(handle);
+    return thread != nullptr ? thread->current_priority : THREADPRIO_LOWEST + 1;
+}
+
+void WaitQueue::Add(Handle thread) {
+    if (std::find(threads.begin(), threads.end(), thread) != threads.end())
+        return;
+
+    if (g_handle_table.Get<Thread>(thread) == nullptr)
+        return;
+
+    threads.push_back(thread);
+}
+
+bool WaitQueue::Remove(Handle thread) {
+    auto entry = std::find(threads.begin(), threads.end(), thread);
+    if (entry == threads.end())
+        return false;
+
+    threads.erase(entry);
+    return true;
+}
+
+Handle WaitQueue::PopHighestPriority() {
+    if (threads.empty())
+        return 0;
+
+    // The priorities are looked up here rather than when the threads are added, since they may
+    // have changed while waiting. Wait queues are short, so a linear search is fine. The first of
+    // several threads with the same priority is the one which has been waiting the longest.
+    auto best = threads.begin();
+    s32 best_priority = GetWaitingThreadPriority(*best);
+    for (auto it = threads.begin() + 1; it != threads.end(); ++it) {
+        s32 priority = GetWaitingThreadPriority(*it);
+        if (priority < best_priority) {
+            best = it;
+            best_priority = priority;
+        }
+    }
+
+    Handle thread = *best;
+    threads.erase(best);
+    return thread;
+}
+
+std::vector<Handle> WaitQueue::PopAll() {
+    std::vector<Handle> result;
+    result.swap(threads);
+
+    // Stable, which keeps threads with the same priority in the order they started waiting in
+    std::stable_sort(result.begin(), result.end(), [](Handle a, Handle b) {
+        return GetWaitingThreadPriority(a) < GetWaitingThreadPriority(b);
+    });
+    return result;
+}
+
 /// Prints the thread queue for debugging purposes
 void DebugThreadQueue() {
     Thread* thread = GetCurrentThread();
@@ -357,6 +542,8 @@ Thread* CreateThread(Handle& handle, const char* name, u32 entry_point, s32 prio
     thread->wait_type = WAITTYPE_NONE;
     thread->wait_handle = 0;
     thread->wait_address = 0;
+    thread->wait_all = false;
+    thread->wait_return_index = false;
     thread->name = name;
 
     return thread;
@@ -479,6 +666,8 @@ void Reschedule() {
         LOG_TRACE(Kernel, "context switch 0x%08X -> 0x%08X", prev->GetHandle(), next->GetHandle());
         SwitchContext(next);
     } else {
+        // If every thread is blocked, Kernel::IsIdle tells Core::RunLoop not to run the CPU, and
+        // it skips ahead to the next scheduled event instead.
         LOG_TRACE(Kernel, "cannot context switch from 0x%08X, no higher priority thread!", prev->GetHandle());
 
         for (Handle handle : thread_queue) {
@@ -487,14 +676,6 @@ void Reschedule() {
                 thread->GetHandle(), thread->current_priority, thread->status, thread->wait_type, thread->wait_handle);
         }
     }
-
-    // TODO(bunnei): Hack - There is no timing mechanism yet to wake up a thread if it has been put
-    // to sleep. So, we'll just immediately set it to "ready" again after an attempted context
-    // switch has occurred. This results in the current thread yielding on a sleep once, and then it
-    // will immediately be placed back in the queue for execution.
-
-    if (CheckWaitType(prev, WAITTYPE_SLEEP))
-        ResumeThreadFromWait(prev->GetHandle());
 }
 
 ResultCode GetThreadId(u32* thread_id, Handle handle) {
@@ -512,9 +693,11 @@ ResultCode GetThreadId(u32* thread_id, Handle handle) {
 
 void ThreadingInit() {
     next_thread_id = INITIAL_THREAD_ID;
+    thread_wakeup_event_type = CoreTiming::RegisterEvent("ThreadWakeupCallback", ThreadWakeupCallback);
 }
 
 void ThreadingShutdown() {
+    arbiter_queues.clear();
 }
 
 } // namespace
@@ -4,6 +4,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "common/common_types.h"
 
 #include "core/mem_map.h"
@@ -47,6 +49,37 @@ enum WaitType {
 
 namespace Kernel {
 
+/**
+ * Threads waiting on a kernel object. They are woken up by their current priority, such that
+ * priority changes while waiting take effect, and in the order they started waiting in among
+ * threads with the same priority.
+ */
+class WaitQueue {
+public:
+    /// Adds a thread to the queue, unless it's already in it
+    void Add(Handle thread);
+
+    /**
+     * Removes a thread from the queue
+     * @return Whether the thread was in the queue
+     */
+    bool Remove(Handle thread);
+
+    /**
+     * Removes the highest priority thread from the queue
+     * @return Handle of the thread, or 0 if the queue is empty
+     */
+    Handle PopHighestPriority();
+
+    /// Removes all threads from the queue, and returns them from highest to lowest priority
+    std::vector<Handle> PopAll();
+
+    bool IsEmpty() const { return threads.empty(); }
+
+private:
+    std::vector<Handle> threads;    ///< Waiting threads, in the order they started waiting in
+};
+
 /// Creates a new thread - wrapper for external user
 Handle CreateThread(const char* name, u32 entry_point, s32 priority, u32 arg, s32 processor_id,
     u32 stack_top, int stack_size=Kernel::DEFAULT_STACK_SIZE);
@@ -71,6 +104,22 @@ ResultCode GetThreadId(u32* thread_id, Handle handle);
 /// Resumes a thread from waiting by marking it as "ready"
 void ResumeThreadFromWait(Handle handle);
 
+/**
+ * Resumes a thread which is waiting on kernel objects, because one of them was signalled. A thread
+ * waiting for all of its objects keeps waiting until the last one of them signals it.
+ * @param thread Handle of the thread to resume
+ * @param object Handle of the object that was signalled
+ */
+void ResumeThreadFromWaitObject(Handle thread, Handle object);
+
+/**
+ * Schedules an event to wake up the specified thread after the specified delay, if it is still
+ * sleeping by then
+ * @param handle The thread handle
+ * @param nanoseconds The time this thread will be allowed to sleep for, negative to sleep forever
+ */
+void WakeThreadAfterDelay(Handle handle, s64 nanoseconds);
+
 /// Arbitrate the highest priority thread that is waiting
 Handle ArbitrateHighestPriorityThread(u32 arbiter, u32 address);
 
@@ -95,9 +144,39 @@ void WaitCurrentThread(WaitType wait_type, Handle wait_handle=GetCurrentThreadHa
  */
 void WaitCurrentThread(WaitType wait_type, Handle wait_handle, VAddr wait_address);
 
+/**
+ * Makes the current thread wait on kernel objects, which have already put it in their waiter lists
+ * through WaitSynchronization. The thread is resumed by the objects it waits on, or with a timeout
+ * result once the timeout expires.
+ * @param objects Handles of the objects the thread waits on
+ * @param acquired_objects Handles of the objects of a wait_all wait which were acquired right away,
+ *        and are given back if the wait times out
+ * @param wait_all Whether all the objects have to be signalled before the thread resumes
+ * @param return_index Whether to return the index of the signalled object in r1, for svcWaitSynchronizationN
+ * @param nanoseconds Timeout of the wait, negative to wait forever
+ */
+void WaitCurrentThreadOnObjects(const std::vector<Handle>& objects,
+    const std::vector<Handle>& acquired_objects, bool wait_all, bool return_index, s64 nanoseconds);
+
+/**
+ * Stops the current thread from waiting on kernel objects, when it doesn't need to wait after all
+ * @param objects Handles of the objects whose WaitSynchronization put the thread in a wait state
+ */
+void CancelCurrentThreadWait(const std::vector<Handle>& objects);
+
+/**
+ * Gives back objects which a thread acquired through a wait which ended without being satisfied
+ * @param thread Handle of the thread which acquired the objects
+ * @param objects Handles of the objects to give back
+ */
+void UndoAcquireObjects(Handle thread, const std::vector<Handle>& objects);
+
 /// Put current thread in a wait state - on WaitSynchronization
 void WaitThread_Synchronization();
 
+/// Returns whether no thread can run, i.e. the current thread is waiting and none is ready
+bool IsIdle();
+
 /// Get the priority of the thread specified by handle
 ResultVal<u32> GetThreadPriority(const Handle handle);
 
@@ -231,6 +231,11 @@ inline ResultCode InvalidHandle(ErrorModule module) {
     return ResultCode(ErrorDescription::InvalidHandle, module,
             ErrorSummary::InvalidArgument, ErrorLevel::Permanent);
 }
+/// Returned when a wait times out before the objects it waits on are signalled.
+inline ResultCode WaitTimeout() {
+    return ResultCode(ErrorDescription::Timeout, ErrorModule::OS,
+            ErrorSummary::StatusChanged, ErrorLevel::Info);
+}
 
 /**
  * This is an optional value type. It holds a `ResultCode` and, if that code is a success code,
@@ -202,6 +202,7 @@ void GetSharedFont(Service::Interface* self) {
         // TODO(bunnei): This function shouldn't copy the shared font every time it's called.
         // Instead, it should probably map the shared font as RO memory. We don't currently have
         // an easy way to do this, but the copy should be sufficient for now.
+        Memory::PrepareHostWrite(SHARED_FONT_VADDR, (u32)shared_font.size());
         memcpy(Memory::GetPointer(SHARED_FONT_VADDR), shared_font.data(), shared_font.size());
 
         cmd_buff[0] = 0x00440082;
@@ -125,6 +125,7 @@ static void GetConfigInfoBlk2(Service::Interface* self) {
         return;
     }
 
+    Memory::PrepareHostWrite(cmd_buffer[4], size);
     cmd_buffer[1] = Service::CFG::GetConfigInfoBlock(block_id, size, 0x2, data_pointer).raw;
 }
 
@@ -3,6 +3,7 @@
 // Refer to the license.txt file included.
 
 #include "common/log.h"
+#include "core/core_timing.h"
 #include "core/hle/hle.h"
 #include "core/hle/kernel/event.h"
 #include "core/hle/service/dsp_dsp.h"
@@ -15,6 +16,7 @@ namespace DSP_DSP {
 static u32 read_pipe_count    = 0;
 static Handle semaphore_event = 0;
 static Handle interrupt_event = 0;
+static int interrupt_timer    = -1; ///< CoreTiming event type of the faked periodic interrupt
 
 void SignalInterrupt() {
     // TODO(bunnei): This is just a stub, it does not do anything other than signal to the emulated
@@ -30,6 +32,22 @@ void SignalInterrupt() {
     Kernel::SignalEvent(interrupt_event);
 }
 
+/// Number of cycles between two faked DSP interrupts (once per 60Hz frame)
+static s64 InterruptPeriod() {
+    return g_clock_rate_arm11 / 60;
+}
+
+/**
+ * Fires the DSP interrupt periodically.
+ * TODO(bunnei): Until we can emulate DSP interrupts, this is probably the only reasonable thing to
+ * do. Certain games expect this to be periodically signaled.
+ */
+static void InterruptTimerCallback(u64 userdata, int cycles_late) {
+    SignalInterrupt();
+    HLE::g_reschedule = true;
+    CoreTiming::ScheduleEvent(InterruptPeriod() - cycles_late, interrupt_timer);
+}
+
 /**
  * DSP_DSP::ConvertProcessAddressFromDspDram service function
  *  Inputs:
@@ -201,6 +219,9 @@ Interface::Interface() {
     interrupt_event = 0;
     read_pipe_count = 0;
 
+    interrupt_timer = CoreTiming::RegisterEvent("DSP_DSP::InterruptTimer", InterruptTimerCallback);
+    CoreTiming::ScheduleEvent(InterruptPeriod(), interrupt_timer);
+
     Register(FunctionTable, ARRAY_SIZE(FunctionTable));
 }
 
@@ -17,6 +17,7 @@
 #include "core/file_sys/archive_savedatacheck.h"
 #include "core/file_sys/archive_sdmc.h"
 #include "core/file_sys/directory_backend.h"
+#include "core/hle/call_stats.h"
 #include "core/hle/service/fs/archive.h"
 #include "core/hle/kernel/session.h"
 #include "core/hle/result.h"
@@ -95,6 +96,7 @@ public:
 
     ResultVal<bool> SyncRequest() override {
         u32* cmd_buff = Kernel::GetCommandBuffer();
+        HLE::CallStats::ScopedCall stats("File", cmd_buff[0], nullptr);
         FileCommand cmd = static_cast<FileCommand>(cmd_buff[0]);
         switch (cmd) {
 
@@ -106,6 +108,7 @@ public:
             u32 address = cmd_buff[5];
             LOG_TRACE(Service_FS, "Read %s %s: offset=0x%llx length=%d address=0x%x",
                       GetTypeName().c_str(), GetName().c_str(), offset, length, address);
+            Memory::PrepareHostWrite(address, length);
             cmd_buff[2] = backend->Read(offset, length, Memory::GetPointer(address));
             break;
         }
@@ -201,6 +204,7 @@ public:
 
     ResultVal<bool> SyncRequest() override {
         u32* cmd_buff = Kernel::GetCommandBuffer();
+        HLE::CallStats::ScopedCall stats("Directory", cmd_buff[0], nullptr);
         DirectoryCommand cmd = static_cast<DirectoryCommand>(cmd_buff[0]);
         switch (cmd) {
 
@@ -214,6 +218,7 @@ public:
                     GetTypeName().c_str(), GetName().c_str(), count);
 
             // Number of entries actually read
+            Memory::PrepareHostWrite(address, count * sizeof(FileSys::Entry));
             cmd_buff[2] = backend->Read(count, entries);
             break;
         }
@@ -12,7 +12,9 @@
 #include "gsp_gpu.h"
 #include "core/hw/gpu.h"
 
+#include "video_core/command_processor.h"
 #include "video_core/gpu_debugger.h"
+#include "video_core/texture_cache.h"
 
 // Main graphics debugger object - TODO: Here is probably not the best place for this
 GraphicsDebugger g_debugger;
@@ -99,6 +101,7 @@ static void ReadHWRegs(Service::Interface* self) {
         return;
     }
 
+    Memory::PrepareHostWrite(cmd_buff[0x41], size);
     u32* dst = (u32*)Memory::GetPointer(cmd_buff[0x41]);
 
     while (size > 0) {
@@ -200,6 +203,9 @@ static void RegisterInterruptRelayQueue(Service::Interface* self) {
  * @todo This probably does not belong in the GSP module, instead move to video_core
  */
 void SignalInterrupt(InterruptId interrupt_id) {
+    // The guest may look at the results of the submitted command lists once it gets an interrupt
+    Pica::CommandProcessor::WaitForIdle();
+
     if (0 == g_interrupt_event) {
         LOG_WARNING(Service_GSP, "cannot synchronize until GSP event has been created!");
         return;
@@ -233,9 +239,14 @@ static void ExecuteCommand(const Command& command, u32 thread_id) {
 
     // GX request DMA - typically used for copying memory from GSP heap to VRAM
     case CommandId::REQUEST_DMA:
+        // The copied memory may still be rendered to by the GPU thread
+        Pica::CommandProcessor::WaitForIdle();
+
         memcpy(Memory::GetPointer(command.dma_request.dest_address),
                Memory::GetPointer(command.dma_request.source_address),
                command.dma_request.size);
+        Pica::TextureCache::InvalidateRegion(Memory::VirtualToPhysicalAddress(command.dma_request.dest_address),
+                                             command.dma_request.size);
         SignalInterrupt(InterruptId::DMA);
         break;
 
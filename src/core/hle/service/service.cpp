@@ -58,7 +58,8 @@ Manager::~Manager() {
 /// Add a service to the manager (does not create it though)
 void Manager::AddService(Interface* service) {
     // TOOD(yuriks): Fix error reporting
-    m_port_map[service->GetPortName()] = Kernel::g_handle_table.Create(service).ValueOr(INVALID_HANDLE);
+    service->m_port_name = service->GetPortName();
+    m_port_map[service->m_port_name] = Kernel::g_handle_table.Create(service).ValueOr(INVALID_HANDLE);
     m_services.push_back(service);
 }
 
@@ -6,13 +6,14 @@
 
 #include <algorithm>
 #include <vector>
-#include <map>
 #include <string>
+#include <unordered_map>
 
 #include "common/common.h"
 #include "common/string_util.h"
 #include "core/mem_map.h"
 
+#include "core/hle/call_stats.h"
 #include "core/hle/kernel/kernel.h"
 #include "core/hle/kernel/session.h"
 #include "core/hle/svc.h"
@@ -69,9 +70,15 @@ public:
 
     ResultVal<bool> SyncRequest() override {
         u32* cmd_buff = Kernel::GetCommandBuffer();
-        auto itr = m_functions.find(cmd_buff[0]);
+        FunctionSlot* slot = GetFunctionSlot(cmd_buff[0]);
+        if (slot != nullptr) {
+            ++slot->call_count;
+        }
+
+        HLE::CallStats::ScopedCall stats(m_port_name.c_str(), cmd_buff[0],
+            (slot != nullptr) ? slot->info->name.c_str() : nullptr);
 
-        if (itr == m_functions.end() || itr->second.func == nullptr) {
+        if (slot == nullptr || slot->info->func == nullptr) {
             // Number of params == bits 0-5 + bits 6-11
             int num_params = (cmd_buff[0] & 0x3F) + ((cmd_buff[0] >> 6) & 0x3F);
 
@@ -80,7 +87,7 @@ public:
                 error += Common::StringFromFormat(", cmd_buff[%i]=%u", i, cmd_buff[i]);
             }
 
-            std::string name = (itr == m_functions.end()) ? Common::StringFromFormat("0x%08X", cmd_buff[0]) : itr->second.name;
+            std::string name = (slot == nullptr) ? Common::StringFromFormat("0x%08X", cmd_buff[0]) : slot->info->name;
 
             LOG_ERROR(Service, error.c_str(), name.c_str(), GetPortName().c_str());
 
@@ -89,26 +96,66 @@ public:
             return MakeResult<bool>(false);
         }
 
-        itr->second.func(this);
+        slot->info->func(this);
 
         return MakeResult<bool>(false); // TODO: Implement return from actual function
     }
 
+    /**
+     * Gets the number of times a function of the service has been requested
+     * @param id Command header of the function
+     * @return Number of requests, 0 if the function isn't registered
+     */
+    u64 GetCallCount(u32 id) {
+        FunctionSlot* slot = GetFunctionSlot(id);
+        return (slot != nullptr) ? slot->call_count : 0;
+    }
+
 protected:
 
     /**
      * Registers the functions in the service
+     * @param functions Function table of the service, which has to outlive it
+     * @param len Number of functions in the table
      */
     void Register(const FunctionInfo* functions, int len) {
         for (int i = 0; i < len; i++) {
-            m_functions[functions[i].id] = functions[i];
+            u32 command_id = functions[i].id >> 16;
+            if (command_id >= m_functions.size()) {
+                m_functions.resize(command_id + 1);
+            }
+            m_functions[command_id].info = &functions[i];
         }
     }
 
 private:
 
+    /// A registered function of the service, and the number of times it has been requested
+    struct FunctionSlot {
+        const FunctionInfo* info = nullptr;
+        u64 call_count = 0;
+    };
+
+    /**
+     * Looks up the registered function for a command header. The command id in its upper 16 bits
+     * indexes the function table, the full header has to match the registered one.
+     * @param header Command header of the request
+     * @return The slot of the function, or nullptr if no function is registered for the header
+     */
+    FunctionSlot* GetFunctionSlot(u32 header) {
+        u32 command_id = header >> 16;
+        if (command_id >= m_functions.size())
+            return nullptr;
+
+        FunctionSlot& slot = m_functions[command_id];
+        if (slot.info == nullptr || slot.info->id != header)
+            return nullptr;
+        return &slot;
+    }
+
     std::vector<Handle>         m_handles;
-    std::map<u32, FunctionInfo> m_functions;
+    std::vector<FunctionSlot>   m_functions;    ///< Registered functions, indexed by command id
+    std::string                 m_port_name;    ///< Port name, cached by the Manager for call statistics
 
 };
 
@@ -134,8 +181,8 @@ public:
 
 private:
 
-    std::vector<Interface*>     m_services;
-    std::map<std::string, u32>  m_port_map;
+    std::vector<Interface*>                     m_services;
+    std::unordered_map<std::string, Handle>     m_port_map;
 
 };
 
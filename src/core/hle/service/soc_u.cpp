@@ -521,12 +521,14 @@ static void RecvFrom(Service::Interface* self) {
     u32 flags = cmd_buffer[3];
     socklen_t addr_len = static_cast<socklen_t>(cmd_buffer[4]);
 
+    Memory::PrepareHostWrite(cmd_buffer[0x104 >> 2], len);
     u8* output_buff = Memory::GetPointer(cmd_buffer[0x104 >> 2]);
     sockaddr src_addr;
     socklen_t src_addr_len = sizeof(src_addr);
     int ret = ::recvfrom(socket_handle, (char*)output_buff, len, flags, &src_addr, &src_addr_len);
 
     if (cmd_buffer[0x1A0 >> 2] != 0) {
+        Memory::PrepareHostWrite(cmd_buffer[0x1A0 >> 2], sizeof(CTRSockAddr));
         CTRSockAddr* ctr_src_addr = reinterpret_cast<CTRSockAddr*>(Memory::GetPointer(cmd_buffer[0x1A0 >> 2]));
         *ctr_src_addr = CTRSockAddr::FromPlatform(src_addr);
     }
@@ -548,6 +550,7 @@ static void Poll(Service::Interface* self) {
     u32 nfds = cmd_buffer[1];
     int timeout = cmd_buffer[2];
     CTRPollFD* input_fds = reinterpret_cast<CTRPollFD*>(Memory::GetPointer(cmd_buffer[6]));
+    Memory::PrepareHostWrite(cmd_buffer[0x104 >> 2], nfds * sizeof(CTRPollFD));
     CTRPollFD* output_fds = reinterpret_cast<CTRPollFD*>(Memory::GetPointer(cmd_buffer[0x104 >> 2]));
 
     // The 3ds_pollfd and the pollfd structures may be different (Windows/Linux have different sizes)
@@ -584,6 +587,7 @@ static void GetSockName(Service::Interface* self) {
     int ret = ::getsockname(socket_handle, &dest_addr, &dest_addr_len);
 
     if (ctr_dest_addr != nullptr) {
+        Memory::PrepareHostWrite(cmd_buffer[0x104 >> 2], sizeof(CTRSockAddr));
         *ctr_dest_addr = CTRSockAddr::FromPlatform(dest_addr);
     } else {
         cmd_buffer[1] = -1; // TODO(Subv): Verify error
@@ -623,6 +627,7 @@ static void GetPeerName(Service::Interface* self) {
     int ret = ::getpeername(socket_handle, &dest_addr, &dest_addr_len);
 
     if (ctr_dest_addr != nullptr) {
+        Memory::PrepareHostWrite(cmd_buffer[0x104 >> 2], sizeof(CTRSockAddr));
         *ctr_dest_addr = CTRSockAddr::FromPlatform(dest_addr);
     } else {
         cmd_buffer[1] = -1;
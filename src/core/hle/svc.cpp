@@ -3,6 +3,8 @@
 // Refer to the license.txt file included.
 
 #include <map>
+#include <vector>
+
 
 #include "common/string_util.h"
 #include "common/symbols.h"
@@ -116,9 +118,6 @@ static Result CloseHandle(Handle handle) {
 
 /// Wait for a handle to synchronize, timeout after the specified nanoseconds
 static Result WaitSynchronization1(Handle handle, s64 nano_seconds) {
-    // TODO(bunnei): Do something with nano_seconds, currently ignoring this
-    bool wait_infinite = (nano_seconds == -1); // Used to wait until a thread has terminated
-
     Kernel::Object* object = Kernel::g_handle_table.GetGeneric(handle);
     if (object == nullptr)
         return InvalidHandle(ErrorModule::Kernel).raw;
@@ -127,21 +126,31 @@ static Result WaitSynchronization1(Handle handle, s64 nano_seconds) {
             object->GetName().c_str(), nano_seconds);
 
     ResultVal<bool> wait = object->WaitSynchronization();
+    if (wait.Failed() || !*wait)
+        return wait.Code().raw;
 
-    // Check for next thread to schedule
-    if (wait.Succeeded() && *wait) {
-        HLE::Reschedule(__func__);
+    std::vector<Handle> objects(1, handle);
+
+    // A zero timeout only polls the object
+    if (nano_seconds == 0) {
+        Kernel::CancelCurrentThreadWait(objects);
+        return WaitTimeout().raw;
     }
 
-    return wait.Code().raw;
+    // The object resumes the thread once it is signalled, unless the timeout expires first
+    Kernel::WaitCurrentThreadOnObjects(objects, std::vector<Handle>(), false, false, nano_seconds);
+    HLE::Reschedule(__func__);
+
+    return RESULT_SUCCESS.raw;
 }
 
 /// Wait for the given handles to synchronize, timeout after the specified nanoseconds
 static Result WaitSynchronizationN(s32* out, Handle* handles, s32 handle_count, bool wait_all,
     s64 nano_seconds) {
-    // TODO(bunnei): Do something with nano_seconds, currently ignoring this
-    bool unlock_all = true;
-    bool wait_infinite = (nano_seconds == -1); // Used to wait until a thread has terminated
+    // Objects which put the thread in their waiter lists, because they can't be acquired yet
+    std::vector<Handle> wait_objects;
+    // Objects acquired right away by a wait_all wait, which are given back unless it is satisfied
+    std::vector<Handle> acquired_objects;
 
     LOG_TRACE(Kernel_SVC, "called handle_count=%d, wait_all=%s, nanoseconds=%lld",
         handle_count, (wait_all ? "true" : "false"), nano_seconds);
@@ -149,8 +158,11 @@ static Result WaitSynchronizationN(s32* out, Handle* handles, s32 handle_count,
     // Iterate through each handle, synchronize kernel object
     for (s32 i = 0; i < handle_count; i++) {
         Kernel::Object* object = Kernel::g_handle_table.GetGeneric(handles[i]);
-        if (object == nullptr)
+        if (object == nullptr) {
+            Kernel::CancelCurrentThreadWait(wait_objects);
+            Kernel::UndoAcquireObjects(Kernel::GetCurrentThreadHandle(), acquired_objects);
             return InvalidHandle(ErrorModule::Kernel).raw;
+        }
 
         LOG_TRACE(Kernel_SVC, "\thandle[%d] = 0x%08X(%s:%s)", i, handles[i], object->GetTypeName().c_str(),
             object->GetName().c_str());
@@ -159,20 +171,34 @@ static Result WaitSynchronizationN(s32* out, Handle* handles, s32 handle_count,
         ResultVal<bool> wait_result = object->WaitSynchronization();
         bool wait = wait_result.Succeeded() && *wait_result;
 
-        if (!wait && !wait_all) {
+        if (wait) {
+            wait_objects.push_back(handles[i]);
+        } else if (!wait_all) {
+            // The thread doesn't need to wait on the objects before this one anymore
+            Kernel::CancelCurrentThreadWait(wait_objects);
             *out = i;
             return RESULT_SUCCESS.raw;
         } else {
-            unlock_all = false;
+            acquired_objects.push_back(handles[i]);
         }
     }
 
-    if (wait_all && unlock_all) {
+    if (wait_all && wait_objects.empty()) {
         *out = handle_count;
         return RESULT_SUCCESS.raw;
     }
 
-    // Check for next thread to schedule
+    // A zero timeout only polls the objects
+    if (nano_seconds == 0) {
+        Kernel::CancelCurrentThreadWait(wait_objects);
+        Kernel::UndoAcquireObjects(Kernel::GetCurrentThreadHandle(), acquired_objects);
+        return WaitTimeout().raw;
+    }
+
+    // The objects resume the thread once they are signalled, unless the timeout expires first. As
+    // every object is waited on when wait_all is false, the index of an object in wait_objects is
+    // also its index in handles.
+    Kernel::WaitCurrentThreadOnObjects(wait_objects, acquired_objects, wait_all, true, nano_seconds);
     HLE::Reschedule(__func__);
 
     return RESULT_SUCCESS.raw;
@@ -344,6 +370,10 @@ static void SleepThread(s64 nanoseconds) {
 
     // Sleep current thread and check for next thread to schedule
     Kernel::WaitCurrentThread(WAITTYPE_SLEEP);
+
+    // Create an event to wake the thread up after the specified nanosecond delay has passed
+    Kernel::WakeThreadAfterDelay(Kernel::GetCurrentThreadHandle(), nanoseconds);
+
     HLE::Reschedule(__func__);
 }
 
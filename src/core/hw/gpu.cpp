@@ -6,15 +6,16 @@
 
 #include "core/settings.h"
 #include "core/core.h"
+#include "core/core_timing.h"
 #include "core/mem_map.h"
 
 #include "core/hle/hle.h"
 #include "core/hle/service/gsp_gpu.h"
-#include "core/hle/service/dsp_dsp.h"
 
 #include "core/hw/gpu.h"
 
 #include "video_core/command_processor.h"
+#include "video_core/texture_cache.h"
 #include "video_core/video_core.h"
 
 
@@ -24,10 +25,8 @@ Regs g_regs;
 
 bool g_skip_frame = false;              ///< True if the current frame was skipped
 
-static u64 frame_ticks      = 0;        ///< 268MHz / gpu_refresh_rate frames per second
-static u64 line_ticks       = 0;        ///< Number of ticks for a screen line
-static u32 cur_line         = 0;        ///< Current screen line
-static u64 last_update_tick = 0;        ///< CPU ticl count from last GPU update
+static s64 frame_ticks      = 0;        ///< 268MHz / gpu_refresh_rate frames per second
+static int vblank_event     = -1;       ///< CoreTiming event type of the vertical blank
 static u64 frame_count      = 0;        ///< Number of frames drawn
 static bool last_skip_frame = false;    ///< True if the last frame was skipped
 
@@ -42,6 +41,9 @@ inline void Read(T &var, const u32 raw_addr) {
         return;
     }
 
+    // Register values read by the guest shouldn't run ahead of the command lists it submitted
+    Pica::CommandProcessor::WaitForIdle();
+
     var = g_regs[addr / 4];
 }
 
@@ -70,11 +72,15 @@ inline void Write(u32 addr, const T data) {
 
         // TODO: Not sure if this check should be done at GSP level instead
         if (config.address_start) {
+            // The filled memory may still be rendered to by the GPU thread
+            Pica::CommandProcessor::WaitForIdle();
+
             // TODO: Not sure if this algorithm is correct, particularly because it doesn't use the size member at all
             u32* start = (u32*)Memory::GetPointer(Memory::PhysicalToVirtualAddress(config.GetStartAddress()));
             u32* end = (u32*)Memory::GetPointer(Memory::PhysicalToVirtualAddress(config.GetEndAddress()));
             for (u32* ptr = start; ptr < end; ++ptr)
                 *ptr = bswap32(config.value); // TODO: This is just a workaround to missing framebuffer format emulation
+            Pica::TextureCache::InvalidateRegion(config.GetStartAddress(), config.GetEndAddress() - config.GetStartAddress());
 
             LOG_TRACE(HW_GPU, "MemoryFill from 0x%08x to 0x%08x", config.GetStartAddress(), config.GetEndAddress());
         }
@@ -85,6 +91,9 @@ inline void Write(u32 addr, const T data) {
     {
         const auto& config = g_regs.display_transfer_config;
         if (config.trigger & 1) {
+            // The source framebuffer may still be rendered to by the GPU thread
+            Pica::CommandProcessor::WaitForIdle();
+
             u8* source_pointer = Memory::GetPointer(Memory::PhysicalToVirtualAddress(config.GetPhysicalInputAddress()));
             u8* dest_pointer = Memory::GetPointer(Memory::PhysicalToVirtualAddress(config.GetPhysicalOutputAddress()));
 
@@ -145,6 +154,10 @@ inline void Write(u32 addr, const T data) {
                 }
             }
 
+            // Conservatively assume four bytes per pixel, which covers all supported output formats
+            Pica::TextureCache::InvalidateRegion(config.GetPhysicalOutputAddress(),
+                                                 config.output_height * config.output_width * 4);
+
             LOG_TRACE(HW_GPU, "DisplayTriggerTransfer: 0x%08x bytes from 0x%08x(%ux%u)-> 0x%08x(%ux%u), dst format %x",
                       config.output_height * config.output_width * 4,
                       config.GetPhysicalInputAddress(), (u32)config.input_width, (u32)config.input_height,
@@ -161,7 +174,7 @@ inline void Write(u32 addr, const T data) {
         if (config.trigger & 1)
         {
             u32* buffer = (u32*)Memory::GetPointer(Memory::PhysicalToVirtualAddress(config.GetPhysicalAddress()));
-            Pica::CommandProcessor::ProcessCommandList(buffer, config.size);
+            Pica::CommandProcessor::SubmitCommandList(buffer, config.size);
         }
         break;
     }
@@ -183,52 +196,35 @@ template void Write<u32>(u32 addr, const u32 data);
 template void Write<u16>(u32 addr, const u16 data);
 template void Write<u8>(u32 addr, const u8 data);
 
-/// Update hardware
-void Update() {
-    auto& framebuffer_top = g_regs.framebuffer_config[0];
-
-    // Synchronize GPU on a thread reschedule: Because we cannot accurately predict a vertical
-    // blank, we need to simulate it. Based on testing, it seems that retail applications work more
-    // accurately when this is signalled between thread switches.
-
-    if (HLE::g_reschedule) {
-        u64 current_ticks = Core::g_app_core->GetTicks();
-        u32 num_lines = static_cast<u32>((current_ticks - last_update_tick) / line_ticks);
-
-        // Synchronize line...
-        if (num_lines > 0) {
-            GSP_GPU::SignalInterrupt(GSP_GPU::InterruptId::PDC0);
-            cur_line += num_lines;
-            last_update_tick += (num_lines * line_ticks);
-        }
+/// Vertical blank, fired once every frame_ticks
+static void VBlankCallback(u64 userdata, int cycles_late) {
+    // Finish the frame's command lists before it is displayed and frame skipping changes
+    Pica::CommandProcessor::WaitForIdle();
+
+    frame_count++;
+    last_skip_frame = g_skip_frame;
+    g_skip_frame = (frame_count & Settings::values.frame_skip) != 0;
+
+    // Swap buffers based on the frameskip mode, which is a little bit tricky. When
+    // a frame is being skipped, nothing is being rendered to the internal framebuffer(s).
+    // So, we should only swap frames if the last frame was rendered. The rules are:
+    //  - If frameskip == 0 (disabled), always swap buffers
+    //  - If frameskip == 1, swap buffers every other frame (starting from the first frame)
+    //  - If frameskip > 1, swap buffers every frameskip^n frames (starting from the second frame)
+    if ((((Settings::values.frame_skip != 1) ^ last_skip_frame) && last_skip_frame != g_skip_frame) || 
+           Settings::values.frame_skip == 0) {
+        VideoCore::g_renderer->SwapBuffers();
+    }
 
-        // Synchronize frame...
-        if (cur_line >= framebuffer_top.height) {
-            cur_line = 0;
-            frame_count++;
-            last_skip_frame = g_skip_frame;
-            g_skip_frame = (frame_count & Settings::values.frame_skip) != 0;
-
-            // Swap buffers based on the frameskip mode, which is a little bit tricky. When
-            // a frame is being skipped, nothing is being rendered to the internal framebuffer(s).
-            // So, we should only swap frames if the last frame was rendered. The rules are:
-            //  - If frameskip == 0 (disabled), always swap buffers
-            //  - If frameskip == 1, swap buffers every other frame (starting from the first frame)
-            //  - If frameskip > 1, swap buffers every frameskip^n frames (starting from the second frame)
-            if ((((Settings::values.frame_skip != 1) ^ last_skip_frame) && last_skip_frame != g_skip_frame) || 
-                   Settings::values.frame_skip == 0) {
-                VideoCore::g_renderer->SwapBuffers();
-            }
+    // Signal to GSP that the vertical blank of both screens has occurred
+    GSP_GPU::SignalInterrupt(GSP_GPU::InterruptId::PDC0);
+    GSP_GPU::SignalInterrupt(GSP_GPU::InterruptId::PDC1);
 
-            // Signal to GSP that GPU interrupt has occurred
-            GSP_GPU::SignalInterrupt(GSP_GPU::InterruptId::PDC1);
+    // Wake up any threads waiting on the interrupts
+    HLE::g_reschedule = true;
 
-            // TODO(bunnei): Fake a DSP interrupt on each frame. This does not belong here, but
-            // until we can emulate DSP interrupts, this is probably the only reasonable place to do
-            // this. Certain games expect this to be periodically signaled.
-            DSP_DSP::SignalInterrupt();
-        }
-    }
+    // Reschedule relative to when this frame should have ended, so that lateness doesn't accumulate
+    CoreTiming::ScheduleEvent(frame_ticks - cycles_late, vblank_event);
 }
 
 /// Initialize hardware
@@ -261,13 +257,13 @@ void Init() {
     framebuffer_sub.color_format = Regs::PixelFormat::RGB8;
     framebuffer_sub.active_fb = 0;
 
-    frame_ticks = 268123480 / Settings::values.gpu_refresh_rate;
-    line_ticks = (GPU::frame_ticks / framebuffer_top.height);
-    cur_line = 0;
-    last_update_tick = Core::g_app_core->GetTicks();
+    frame_ticks = g_clock_rate_arm11 / Settings::values.gpu_refresh_rate;
     last_skip_frame = false;
     g_skip_frame = false;
 
+    vblank_event = CoreTiming::RegisterEvent("GPU::VBlank", VBlankCallback);
+    CoreTiming::ScheduleEvent(frame_ticks, vblank_event);
+
     LOG_DEBUG(HW_GPU, "initialized OK");
 }
 
@@ -2,10 +2,19 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
+#include <iterator>
+
 #include "common/common.h"
 #include "common/mem_arena.h"
 
 #include "core/mem_map.h"
+#include "core/settings.h"
+
+#ifdef MEMORY_FASTMEM
+#include <signal.h>
+#include <sys/mman.h>
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -64,6 +73,178 @@ static MemoryView g_views[] = {
 
 static const int kNumMemViews = sizeof(g_views) / sizeof(MemoryView);    ///< Number of mem views
 
+u8* g_read_page_table[PAGE_TABLE_NUM_ENTRIES];
+u8* g_fast_read_page_table[PAGE_TABLE_NUM_ENTRIES];
+u8* g_write_page_table[PAGE_TABLE_NUM_ENTRIES];
+u8 g_page_write_tracking[PAGE_TABLE_NUM_ENTRIES];
+
+#ifdef MEMORY_FASTMEM
+u8* g_fastmem_base = nullptr;
+
+static struct sigaction previous_segv_action;
+
+/// Instructions used by the Fastmem* accessors in mem_map.h
+struct FastmemAccess {
+    u8 code[4];
+    unsigned code_size;
+    unsigned access_size;
+    bool is_write;
+};
+
+static const FastmemAccess fastmem_accesses[] = {
+    { { 0x0F, 0xB6, 0x04, 0x0A }, 4, 8,  false }, // movzx eax, byte ptr [rdx+rcx]
+    { { 0x0F, 0xB7, 0x04, 0x0A }, 4, 16, false }, // movzx eax, word ptr [rdx+rcx]
+    { { 0x8B, 0x04, 0x0A },       3, 32, false }, // mov eax, dword ptr [rdx+rcx]
+    { { 0x88, 0x04, 0x0A },       3, 8,  true  }, // mov byte ptr [rdx+rcx], al
+    { { 0x66, 0x89, 0x04, 0x0A }, 4, 16, true  }, // mov word ptr [rdx+rcx], ax
+    { { 0x89, 0x04, 0x0A },       3, 32, true  }, // mov dword ptr [rdx+rcx], eax
+};
+
+/**
+ * Emulates fastmem accesses to unmapped or tracked memory using the slow path, and then
+ * resumes execution after the faulting instruction.
+ */
+static void FastmemFaultHandler(int sig, siginfo_t* info, void* raw_context) {
+    greg_t* regs = static_cast<ucontext_t*>(raw_context)->uc_mcontext.gregs;
+    const u8* fault_address = static_cast<const u8*>(info->si_addr);
+    const u8* code = reinterpret_cast<const u8*>(regs[REG_RIP]);
+
+    if (g_fastmem_base != nullptr && fault_address >= g_fastmem_base &&
+        fault_address < g_fastmem_base + 0x100000000ULL) {
+
+        for (const auto& access : fastmem_accesses) {
+            if (memcmp(code, access.code, access.code_size) != 0)
+                continue;
+
+            const VAddr addr = static_cast<VAddr>(regs[REG_RCX]);
+            if (access.is_write) {
+                switch (access.access_size) {
+                case 8:  Write8(addr, static_cast<u8>(regs[REG_RAX]));   break;
+                case 16: Write16(addr, static_cast<u16>(regs[REG_RAX])); break;
+                case 32: Write32(addr, static_cast<u32>(regs[REG_RAX])); break;
+                }
+            } else {
+                switch (access.access_size) {
+                case 8:  regs[REG_RAX] = Read8(addr);  break;
+                case 16: regs[REG_RAX] = Read16(addr); break;
+                case 32: regs[REG_RAX] = Read32(addr); break;
+                }
+            }
+
+            regs[REG_RIP] += access.code_size;
+            return;
+        }
+    }
+
+    // Not caused by a guest memory access: Restore the previous handler, which will then handle
+    // the fault when the instruction is retried.
+    sigaction(SIGSEGV, &previous_segv_action, nullptr);
+}
+
+static void InitFastmem() {
+    if (!Settings::values.use_fastmem || g_base == nullptr)
+        return;
+
+    struct sigaction action = {};
+    action.sa_sigaction = FastmemFaultHandler;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGSEGV, &action, &previous_segv_action) != 0) {
+        LOG_ERROR(HW_Memory, "Failed to install the fastmem fault handler, using the slow path");
+        return;
+    }
+
+    g_fastmem_base = g_base;
+}
+
+static void ShutdownFastmem() {
+    if (g_fastmem_base == nullptr)
+        return;
+
+    sigaction(SIGSEGV, &previous_segv_action, nullptr);
+    g_fastmem_base = nullptr;
+}
+#endif
+
+/**
+ * Points the page table entries of a virtual memory region at its host memory
+ * @param vaddr Virtual address of the region, needs to be page aligned
+ * @param size Size of the region in bytes, needs to be a multiple of the page size
+ * @param memory Host memory backing the region
+ */
+static void MapPages(VAddr vaddr, u32 size, u8* memory) {
+    _dbg_assert_(HW_Memory, (vaddr & PAGE_MASK) == 0 && (size & PAGE_MASK) == 0);
+
+    for (u32 offset = 0; offset < size; offset += PAGE_MASK + 1) {
+        u32 page = (vaddr + offset) >> PAGE_BITS;
+        g_read_page_table[page] = memory + offset;
+        g_fast_read_page_table[page] = memory + offset;
+        g_write_page_table[page] = memory + offset;
+    }
+}
+
+/**
+ * Adds or removes a reason for tracking CPU accesses to a page of virtual memory. Writes go through
+ * the slow path as long as there is any reason left, reads only as long as TRACK_GPU_TARGET is.
+ * @param vaddr Virtual address within the page
+ * @param reason PageWriteTracking flag to add or remove
+ * @param tracked Whether to add or remove the reason
+ */
+static void UpdatePageWriteTracking(VAddr vaddr, u8 reason, bool tracked) {
+    const u32 page = vaddr >> PAGE_BITS;
+    u8* memory = g_read_page_table[page];
+    if (memory == nullptr)
+        return;
+
+    const bool was_write_tracked = g_page_write_tracking[page] != 0;
+    const bool was_read_tracked = (g_page_write_tracking[page] & TRACK_GPU_TARGET) != 0;
+    if (tracked)
+        g_page_write_tracking[page] |= reason;
+    else
+        g_page_write_tracking[page] &= ~reason;
+
+    const bool is_write_tracked = g_page_write_tracking[page] != 0;
+    const bool is_read_tracked = (g_page_write_tracking[page] & TRACK_GPU_TARGET) != 0;
+    if (was_write_tracked == is_write_tracked && was_read_tracked == is_read_tracked)
+        return;
+
+    g_write_page_table[page] = is_write_tracked ? nullptr : memory;
+    g_fast_read_page_table[page] = is_read_tracked ? nullptr : memory;
+
+#ifdef MEMORY_FASTMEM
+    if (g_fastmem_base != nullptr)
+        mprotect(g_fastmem_base + (page << PAGE_BITS), PAGE_MASK + 1,
+                 is_read_tracked ? PROT_NONE : is_write_tracked ? PROT_READ : (PROT_READ | PROT_WRITE));
+#endif
+}
+
+/// Tracks a page of physical memory which the GPU accesses, through its mapping in the linear heap
+static void UpdatePhysicalPageTracking(PAddr address, u8 reason, bool tracked) {
+    // Only memory which the GPU accesses needs to be tracked
+    VAddr vaddr;
+    if (address >= VRAM_PADDR && address < VRAM_PADDR_END) {
+        vaddr = address - VRAM_PADDR + VRAM_VADDR;
+    } else if (address >= FCRAM_PADDR && address < FCRAM_PADDR_END) {
+        vaddr = address - FCRAM_PADDR + HEAP_LINEAR_VADDR;
+    } else {
+        return;
+    }
+
+    UpdatePageWriteTracking(vaddr, reason, tracked);
+}
+
+void SetPageWriteTracking(PAddr address, bool tracked) {
+    UpdatePhysicalPageTracking(address, TRACK_TEXTURES, tracked);
+}
+
+void SetCodePageWriteTracking(VAddr address, PageWriteTracking reason, bool tracked) {
+    UpdatePageWriteTracking(address, reason, tracked);
+}
+
+void SetGPUPageTracking(PAddr address, PageWriteTracking reason, bool tracked) {
+    UpdatePhysicalPageTracking(address, reason, tracked);
+}
+
 void Init() {
     int flags = 0;
 
@@ -74,13 +255,40 @@ void Init() {
 
     g_base = MemoryMap_Setup(g_views, kNumMemViews, flags, &arena);
 
+    // Configuration memory is not mapped, since reads from it are emulated by ConfigMem.
+    // The page tables point at the second view of each region rather than at the one within the
+    // 4 GB range, since pages of the latter get write protected for fastmem write tracking. Slow
+    // path accesses and host code can thus always write to the memory they get from the tables.
+    MapPages(KERNEL_MEMORY_VADDR, KERNEL_MEMORY_SIZE, physical_kernel_mem);
+    MapPages(EXEFS_CODE_VADDR, EXEFS_CODE_SIZE, physical_exefs_code);
+    MapPages(HEAP_LINEAR_VADDR, HEAP_LINEAR_SIZE, physical_heap_gsp);
+    MapPages(HEAP_VADDR, HEAP_SIZE, physical_fcram);
+    MapPages(SHARED_MEMORY_VADDR, SHARED_MEMORY_SIZE, physical_shared_mem);
+    MapPages(SYSTEM_MEMORY_VADDR, SYSTEM_MEMORY_SIZE, physical_system_mem);
+    MapPages(DSP_MEMORY_VADDR, DSP_MEMORY_SIZE, physical_dsp_mem);
+    MapPages(VRAM_VADDR, VRAM_SIZE, physical_vram);
+
+#ifdef MEMORY_FASTMEM
+    InitFastmem();
+#endif
+
     LOG_DEBUG(HW_Memory, "initialized OK, RAM at %p (mirror at 0 @ %p)", g_heap,
         physical_fcram);
 }
 
 void Shutdown() {
+#ifdef MEMORY_FASTMEM
+    ShutdownFastmem();
+#endif
+
     u32 flags = 0;
     MemoryMap_Shutdown(g_views, kNumMemViews, flags, &arena);
+    MemArena::Release4GBBase(g_base);
+
+    std::fill(std::begin(g_read_page_table), std::end(g_read_page_table), nullptr);
+    std::fill(std::begin(g_fast_read_page_table), std::end(g_fast_read_page_table), nullptr);
+    std::fill(std::begin(g_write_page_table), std::end(g_write_page_table), nullptr);
+    std::fill(std::begin(g_page_write_tracking), std::end(g_page_write_tracking), 0);
 
     arena.ReleaseSpace();
     g_base = nullptr;
@@ -7,6 +7,10 @@
 #include "common/common.h"
 #include "common/common_types.h"
 
+#if defined(__linux__) && defined(__x86_64__) && !defined(_M_GENERIC)
+#define MEMORY_FASTMEM
+#endif
+
 namespace Memory {
 
 // TODO: It would be nice to eventually replace these with strong types that prevent accidental
@@ -138,6 +142,47 @@ extern u8* g_dsp_mem;       ///< DSP memory
 extern u8* g_system_mem;    ///< System memory
 extern u8* g_exefs_code;    ///< ExeFS:/.code is loaded here
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/// Virtual memory is tracked in pages of (1 << PAGE_BITS) bytes
+const int PAGE_BITS = 12;
+const u32 PAGE_MASK = (1 << PAGE_BITS) - 1;
+const u32 PAGE_TABLE_NUM_ENTRIES = 1 << (32 - PAGE_BITS);
+
+// Host pointers to each page of the virtual address space, such that memory can be accessed
+// without first working out which region an address belongs to. Pages which need special handling
+// are nullptr, so that accesses to them fall back to the slow path. This is also done in the write
+// table for pages which are write tracked (see SetPageWriteTracking), and in the fast read table
+// for pages whose CPU reads are tracked (see SetGPUPageTracking). The fast read table is only used
+// by the Fast* accessors below, host code always reads through g_read_page_table.
+//
+// The page tables (and g_page_write_tracking) are owned by the CPU thread, which reads them
+// without any locking. Hence they must only be modified by the CPU thread, which includes all
+// calls to the Set*Tracking functions. The GPU thread defers its changes to the CPU thread.
+extern u8* g_read_page_table[PAGE_TABLE_NUM_ENTRIES];
+extern u8* g_fast_read_page_table[PAGE_TABLE_NUM_ENTRIES];
+extern u8* g_write_page_table[PAGE_TABLE_NUM_ENTRIES];
+
+/// Reasons for which CPU accesses to a page are tracked
+enum PageWriteTracking : u8 {
+    TRACK_TEXTURES   = 1 << 0,  ///< Textures cached from the page need to be invalidated
+    TRACK_CODE       = 1 << 1,  ///< Code translated by the interpreter needs to be invalidated
+    TRACK_JIT_CODE   = 1 << 2,  ///< Code compiled by the JIT needs to be invalidated
+    TRACK_GPU_INPUT  = 1 << 3,  ///< Queued command lists read the page, writes wait for the GPU thread
+    TRACK_GPU_TARGET = 1 << 4,  ///< Queued command lists render to the page, reads wait for the GPU thread too
+};
+
+/// Combination of PageWriteTracking flags for each page of the virtual address space
+extern u8 g_page_write_tracking[PAGE_TABLE_NUM_ENTRIES];
+
+#ifdef MEMORY_FASTMEM
+// Base of the reserved host address range into which each memory region is mapped at its virtual
+// address, or nullptr if fastmem is disabled. Accesses to parts of the range which aren't backed
+// by a region, writes to write tracked pages and reads from read tracked pages fault and are then
+// forwarded to the slow path by a signal handler.
+extern u8* g_fastmem_base;
+#endif
+
 void Init();
 void Shutdown();
 
@@ -163,6 +208,146 @@ void WriteBlock(VAddr addr, const u8* data, size_t size);
 
 u8* GetPointer(VAddr virtual_address);
 
+/**
+ * Needs to be called before host code writes to guest memory through a pointer from GetPointer.
+ * Such writes bypass the slow path for tracked pages, so this does its work up front: it waits
+ * for the GPU thread and drops the textures and translated code cached from the range.
+ */
+void PrepareHostWrite(VAddr addr, u32 size);
+
+/**
+ * Sets whether CPU writes to the given page of physical memory need to go through the slow path,
+ * which invalidates textures cached from it, rather than accessing memory directly.
+ */
+void SetPageWriteTracking(PAddr address, bool tracked);
+
+/**
+ * Sets whether CPU writes to the given page of virtual memory need to go through the slow path,
+ * which drops the code translated from it by the CPU core.
+ * @param reason TRACK_CODE or TRACK_JIT_CODE, depending on which CPU core translated the code
+ */
+void SetCodePageWriteTracking(VAddr address, PageWriteTracking reason, bool tracked);
+
+/**
+ * Sets whether CPU accesses to the given page of physical memory need to go through the slow path,
+ * which waits for the GPU thread to finish the command lists that use the page.
+ * @param reason TRACK_GPU_INPUT or TRACK_GPU_TARGET, depending on how the command lists use the page
+ */
+void SetGPUPageTracking(PAddr address, PageWriteTracking reason, bool tracked);
+
+#ifdef MEMORY_FASTMEM
+// Accesses to the fastmem range. These always use the same instruction encoding, with the address
+// in RCX and the value in RAX, such that the fault handler can emulate them when they fault.
+
+inline u32 FastmemRead8(const VAddr addr) {
+    u32 value;
+    asm volatile("movzbl (%%rdx,%%rcx), %%eax" : "=a"(value) : "d"(g_fastmem_base), "c"((u64)addr) : "memory");
+    return value;
+}
+
+inline u32 FastmemRead16(const VAddr addr) {
+    u32 value;
+    asm volatile("movzwl (%%rdx,%%rcx), %%eax" : "=a"(value) : "d"(g_fastmem_base), "c"((u64)addr) : "memory");
+    return value;
+}
+
+inline u32 FastmemRead32(const VAddr addr) {
+    u32 value;
+    asm volatile("movl (%%rdx,%%rcx), %%eax" : "=a"(value) : "d"(g_fastmem_base), "c"((u64)addr) : "memory");
+    return value;
+}
+
+inline void FastmemWrite8(const VAddr addr, const u8 data) {
+    asm volatile("movb %%al, (%%rdx,%%rcx)" : : "a"(data), "d"(g_fastmem_base), "c"((u64)addr) : "memory");
+}
+
+inline void FastmemWrite16(const VAddr addr, const u16 data) {
+    asm volatile("movw %%ax, (%%rdx,%%rcx)" : : "a"(data), "d"(g_fastmem_base), "c"((u64)addr) : "memory");
+}
+
+inline void FastmemWrite32(const VAddr addr, const u32 data) {
+    asm volatile("movl %%eax, (%%rdx,%%rcx)" : : "a"(data), "d"(g_fastmem_base), "c"((u64)addr) : "memory");
+}
+#endif
+
+// Fast paths for accesses by the CPU cores, which only call out to the regular functions above if
+// the page isn't directly backed by host memory or an access needs special treatment.
+
+inline u8 FastRead8(const VAddr addr) {
+#ifdef MEMORY_FASTMEM
+    if (g_fastmem_base != nullptr)
+        return FastmemRead8(addr);
+#endif
+    const u8* page = g_fast_read_page_table[addr >> PAGE_BITS];
+    if (page != nullptr)
+        return page[addr & PAGE_MASK];
+    return Read8(addr);
+}
+
+inline u16 FastRead16(const VAddr addr) {
+#ifdef MEMORY_FASTMEM
+    if (g_fastmem_base != nullptr && (addr & 1) == 0)
+        return FastmemRead16(addr);
+#endif
+    const u8* page = g_fast_read_page_table[addr >> PAGE_BITS];
+    if (page != nullptr && (addr & 1) == 0)
+        return *(const u16_le*)&page[addr & PAGE_MASK];
+    return Read16(addr);
+}
+
+inline u32 FastRead32(const VAddr addr) {
+#ifdef MEMORY_FASTMEM
+    if (g_fastmem_base != nullptr && (addr & 3) == 0)
+        return FastmemRead32(addr);
+#endif
+    const u8* page = g_fast_read_page_table[addr >> PAGE_BITS];
+    if (page != nullptr && (addr & 3) == 0)
+        return *(const u32_le*)&page[addr & PAGE_MASK];
+    return Read32(addr);
+}
+
+inline void FastWrite8(const VAddr addr, const u8 data) {
+#ifdef MEMORY_FASTMEM
+    if (g_fastmem_base != nullptr) {
+        FastmemWrite8(addr, data);
+        return;
+    }
+#endif
+    u8* page = g_write_page_table[addr >> PAGE_BITS];
+    if (page != nullptr)
+        page[addr & PAGE_MASK] = data;
+    else
+        Write8(addr, data);
+}
+
+inline void FastWrite16(const VAddr addr, const u16 data) {
+#ifdef MEMORY_FASTMEM
+    if (g_fastmem_base != nullptr) {
+        FastmemWrite16(addr, data);
+        return;
+    }
+#endif
+    u8* page = g_write_page_table[addr >> PAGE_BITS];
+    if (page != nullptr)
+        *(u16_le*)&page[addr & PAGE_MASK] = data;
+    else
+        Write16(addr, data);
+}
+
+inline void FastWrite32(const VAddr addr, const u32 data) {
+#ifdef MEMORY_FASTMEM
+    if (g_fastmem_base != nullptr) {
+        FastmemWrite32(addr, data);
+        return;
+    }
+#endif
+    u8* page = g_write_page_table[addr >> PAGE_BITS];
+    if (page != nullptr)
+        *(u32_le*)&page[addr & PAGE_MASK] = data;
+    else
+        Write32(addr, data);
+}
+
 /**
  * Maps a block of memory on the heap
  * @param size Size of block in bytes
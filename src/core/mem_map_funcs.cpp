@@ -2,14 +2,20 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
 #include <map>
 
 #include "common/common.h"
 
 #include "core/mem_map.h"
+#include "core/arm/dyncom/arm_dyncom_interpreter.h"
+#include "core/arm/dyncom/arm_dyncom_jit_x64.h"
 #include "core/hw/hw.h"
 #include "hle/config_mem.h"
 
+#include "video_core/command_processor.h"
+#include "video_core/texture_cache.h"
+
 namespace Memory {
 
 static std::map<u32, MemoryBlock> heap_map;
@@ -50,85 +56,64 @@ PAddr VirtualToPhysicalAddress(const VAddr addr) {
 
 template <typename T>
 inline void Read(T &var, const VAddr vaddr) {
-    // TODO: Figure out the fastest order of tests for both read and write (they are probably different).
     // TODO: Make sure this represents the mirrors in a correct way.
-    // Could just do a base-relative read, too.... TODO
-
-    // Kernel memory command buffer
-    if (vaddr >= KERNEL_MEMORY_VADDR && vaddr < KERNEL_MEMORY_VADDR_END) {
-        var = *((const T*)&g_kernel_mem[vaddr - KERNEL_MEMORY_VADDR]);
-
-    // ExeFS:/.code is loaded here
-    } else if ((vaddr >= EXEFS_CODE_VADDR)  && (vaddr < EXEFS_CODE_VADDR_END)) {
-        var = *((const T*)&g_exefs_code[vaddr - EXEFS_CODE_VADDR]);
-
-    // FCRAM - linear heap
-    } else if ((vaddr >= HEAP_LINEAR_VADDR) && (vaddr < HEAP_LINEAR_VADDR_END)) {
-        var = *((const T*)&g_heap_linear[vaddr - HEAP_LINEAR_VADDR]);
 
-    // FCRAM - application heap
-    } else if ((vaddr >= HEAP_VADDR)  && (vaddr < HEAP_VADDR_END)) {
-        var = *((const T*)&g_heap[vaddr - HEAP_VADDR]);
+    // Pages which queued command lists render to are only up to date once these have finished
+    if (g_page_write_tracking[vaddr >> PAGE_BITS] & TRACK_GPU_TARGET)
+        Pica::CommandProcessor::WaitForIdle();
 
-    // Shared memory
-    } else if ((vaddr >= SHARED_MEMORY_VADDR)  && (vaddr < SHARED_MEMORY_VADDR_END)) {
-        var = *((const T*)&g_shared_mem[vaddr - SHARED_MEMORY_VADDR]);
-
-    // System memory
-    } else if ((vaddr >= SYSTEM_MEMORY_VADDR)  && (vaddr < SYSTEM_MEMORY_VADDR_END)) {
-        var = *((const T*)&g_system_mem[vaddr - SYSTEM_MEMORY_VADDR]);
+    const u8* page = g_read_page_table[vaddr >> PAGE_BITS];
+    if (page != nullptr) {
+        var = *((const T*)&page[vaddr & PAGE_MASK]);
 
     // Config memory
     } else if ((vaddr >= CONFIG_MEMORY_VADDR)  && (vaddr < CONFIG_MEMORY_VADDR_END)) {
         ConfigMem::Read<T>(var, vaddr);
 
-    // DSP memory
-    } else if ((vaddr >= DSP_MEMORY_VADDR)  && (vaddr < DSP_MEMORY_VADDR_END)) {
-        var = *((const T*)&g_dsp_mem[vaddr - DSP_MEMORY_VADDR]);
-
-    // VRAM
-    } else if ((vaddr >= VRAM_VADDR)  && (vaddr < VRAM_VADDR_END)) {
-        var = *((const T*)&g_vram[vaddr - VRAM_VADDR]);
-
     } else {
         LOG_ERROR(HW_Memory, "unknown Read%lu @ 0x%08X", sizeof(var) * 8, vaddr);
     }
 }
 
-template <typename T>
-inline void Write(const VAddr vaddr, const T data) {
-
-    // Kernel memory command buffer
-    if (vaddr >= KERNEL_MEMORY_VADDR && vaddr < KERNEL_MEMORY_VADDR_END) {
-        *(T*)&g_kernel_mem[vaddr - KERNEL_MEMORY_VADDR] = data;
-
-    // ExeFS:/.code is loaded here
-    } else if ((vaddr >= EXEFS_CODE_VADDR)  && (vaddr < EXEFS_CODE_VADDR_END)) {
-        *(T*)&g_exefs_code[vaddr - EXEFS_CODE_VADDR] = data;
-
-    // FCRAM - linear heap
-    } else if ((vaddr >= HEAP_LINEAR_VADDR)  && (vaddr < HEAP_LINEAR_VADDR_END)) {
-        *(T*)&g_heap_linear[vaddr - HEAP_LINEAR_VADDR] = data;
+/**
+ * Prepares a write to a range within a single tracked page: waits for the GPU thread if it may
+ * still use the page and drops the textures and translated code cached from the range.
+ */
+static void PrepareTrackedWrite(const VAddr vaddr, const u32 size) {
+    // Queued command lists and the texture cache may still read the page on the GPU thread,
+    // so the write has to wait for them. This also drops the tracking for the command lists.
+    if (g_page_write_tracking[vaddr >> PAGE_BITS] & (TRACK_TEXTURES | TRACK_GPU_INPUT | TRACK_GPU_TARGET))
+        Pica::CommandProcessor::WaitForIdle();
+
+    const u8 tracking = g_page_write_tracking[vaddr >> PAGE_BITS];
+
+    if (tracking & TRACK_TEXTURES) {
+        if ((vaddr >= HEAP_LINEAR_VADDR) && (vaddr < HEAP_LINEAR_VADDR_END))
+            Pica::TextureCache::InvalidateRegion(vaddr - HEAP_LINEAR_VADDR + FCRAM_PADDR, size);
+        else if ((vaddr >= VRAM_VADDR) && (vaddr < VRAM_VADDR_END))
+            Pica::TextureCache::InvalidateRegion(vaddr - VRAM_VADDR + VRAM_PADDR, size);
+    }
 
-    // FCRAM - application heap
-    } else if ((vaddr >= HEAP_VADDR)  && (vaddr < HEAP_VADDR_END)) {
-        *(T*)&g_heap[vaddr - HEAP_VADDR] = data;
+    if (tracking & TRACK_CODE)
+        InterpreterInvalidateCodePage(vaddr);
 
-    // Shared memory
-    } else if ((vaddr >= SHARED_MEMORY_VADDR)  && (vaddr < SHARED_MEMORY_VADDR_END)) {
-        *(T*)&g_shared_mem[vaddr - SHARED_MEMORY_VADDR] = data;
+#ifdef ARM_JIT_X64
+    if (tracking & TRACK_JIT_CODE)
+        JitInvalidateCodePage(vaddr);
+#endif
+}
 
-    // System memory
-    } else if ((vaddr >= SYSTEM_MEMORY_VADDR)  && (vaddr < SYSTEM_MEMORY_VADDR_END)) {
-        *(T*)&g_system_mem[vaddr - SYSTEM_MEMORY_VADDR] = data;
+template <typename T>
+inline void Write(const VAddr vaddr, const T data) {
 
-    // VRAM
-    } else if ((vaddr >= VRAM_VADDR)  && (vaddr < VRAM_VADDR_END)) {
-        *(T*)&g_vram[vaddr - VRAM_VADDR] = data;
+    u8* page = g_write_page_table[vaddr >> PAGE_BITS];
+    if (page != nullptr) {
+        *(T*)&page[vaddr & PAGE_MASK] = data;
 
-    // DSP memory
-    } else if ((vaddr >= DSP_MEMORY_VADDR)  && (vaddr < DSP_MEMORY_VADDR_END)) {
-        *(T*)&g_dsp_mem[vaddr - DSP_MEMORY_VADDR] = data;
+    // Write tracked pages
+    } else if (g_page_write_tracking[vaddr >> PAGE_BITS] != 0) {
+        PrepareTrackedWrite(vaddr, sizeof(T));
+        *(T*)&g_read_page_table[vaddr >> PAGE_BITS][vaddr & PAGE_MASK] = data;
 
     //} else if ((vaddr & 0xFFFF0000) == 0x1FF80000) {
     //    _assert_msg_(MEMMAP, false, "umimplemented write to Configuration Memory");
@@ -142,38 +127,12 @@ inline void Write(const VAddr vaddr, const T data) {
 }
 
 u8 *GetPointer(const VAddr vaddr) {
-    // Kernel memory command buffer
-    if (vaddr >= KERNEL_MEMORY_VADDR && vaddr < KERNEL_MEMORY_VADDR_END) {
-        return g_kernel_mem + (vaddr - KERNEL_MEMORY_VADDR);
-
-    // ExeFS:/.code is loaded here
-    } else if ((vaddr >= EXEFS_CODE_VADDR)  && (vaddr < EXEFS_CODE_VADDR_END)) {
-        return g_exefs_code + (vaddr - EXEFS_CODE_VADDR);
-
-    // FCRAM - linear heap
-    } else if ((vaddr >= HEAP_LINEAR_VADDR)  && (vaddr < HEAP_LINEAR_VADDR_END)) {
-        return g_heap_linear + (vaddr - HEAP_LINEAR_VADDR);
-
-    // FCRAM - application heap
-    } else if ((vaddr >= HEAP_VADDR)  && (vaddr < HEAP_VADDR_END)) {
-        return g_heap + (vaddr - HEAP_VADDR);
-
-    // Shared memory
-    } else if ((vaddr >= SHARED_MEMORY_VADDR)  && (vaddr < SHARED_MEMORY_VADDR_END)) {
-        return g_shared_mem + (vaddr - SHARED_MEMORY_VADDR);
+    u8* page = g_read_page_table[vaddr >> PAGE_BITS];
+    if (page != nullptr)
+        return page + (vaddr & PAGE_MASK);
 
-    // System memory
-    } else if ((vaddr >= SYSTEM_MEMORY_VADDR)  && (vaddr < SYSTEM_MEMORY_VADDR_END)) {
-        return g_system_mem + (vaddr - SYSTEM_MEMORY_VADDR);
-
-    // VRAM
-    } else if ((vaddr >= VRAM_VADDR)  && (vaddr < VRAM_VADDR_END)) {
-        return g_vram + (vaddr - VRAM_VADDR);
-
-    } else {
-        LOG_ERROR(HW_Memory, "unknown GetPointer @ 0x%08x", vaddr);
-        return 0;
-    }
+    LOG_ERROR(HW_Memory, "unknown GetPointer @ 0x%08x", vaddr);
+    return 0;
 }
 
 /**
@@ -298,4 +257,16 @@ void WriteBlock(const VAddr addr, const u8* data, const size_t size) {
         Write8(addr + offset, data[offset]);
 }
 
+void PrepareHostWrite(const VAddr addr, const u32 size) {
+    // 64-bit, so that ranges ending at the top of the address space don't wrap around
+    u64 vaddr = addr;
+    const u64 end = (u64)addr + size;
+    while (vaddr < end) {
+        const u64 page_end = std::min<u64>((vaddr | PAGE_MASK) + 1, end);
+        if (g_page_write_tracking[vaddr >> PAGE_BITS] != 0)
+            PrepareTrackedWrite((VAddr)vaddr, (u32)(page_end - vaddr));
+        vaddr = page_end;
+    }
+}
+
 } // namespace
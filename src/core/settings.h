@@ -30,8 +30,18 @@ struct Values {
 
     // Core
     int cpu_core;
+    bool use_fastmem;
+    int translation_cache_size;
     int gpu_refresh_rate;
     int frame_skip;
+    int rasterizer_threads;
+    bool rasterizer_sse2_verify;
+    int vertex_cache_size;
+    int vertex_shader_threads;
+    int vertex_shader_parallel_threshold;
+    bool use_shader_jit;
+    bool shader_jit_verify;
+    bool use_gpu_thread;
 
     // Data Storage
     bool use_virtual_sd;
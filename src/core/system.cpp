@@ -21,11 +21,11 @@ void UpdateState(State state) {
 
 void Init(EmuWindow* emu_window) {
     Core::Init();
+    CoreTiming::Init();
     Memory::Init();
     HW::Init();
     Kernel::Init();
     HLE::Init();
-    CoreTiming::Init();
     VideoCore::Init(emu_window);
 }
 
@@ -2,14 +2,31 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/make_unique.h"
+#include "common/spsc_queue.h"
+#include "common/thread_pool.h"
+
 #include "clipper.h"
 #include "command_processor.h"
 #include "math.h"
 #include "pica.h"
 #include "primitive_assembly.h"
+#include "rasterizer.h"
+#include "texture_cache.h"
 #include "vertex_shader.h"
 #include "core/hle/service/gsp_gpu.h"
 #include "core/hw/gpu.h"
+#include "core/settings.h"
 
 #include "debug_utils/debug_utils.h"
 
@@ -27,6 +44,242 @@ static u32 uniform_write_buffer[4];
 static u32 vs_binary_write_offset = 0;
 static u32 vs_swizzle_write_offset = 0;
 
+// Post-transform vertex cache for indexed draws. The cache is direct-mapped by vertex index and
+// only valid within a single draw, since register and shader state may change between draws.
+struct VertexCacheEntry {
+    u32 vertex; // Index of the cached vertex, or INVALID_VERTEX
+    u32 pending; // Position in the current batch's loaded vertices if not shaded yet, or NOT_PENDING
+    VertexShader::InputVertex input;
+    VertexShader::OutputVertex output;
+};
+static const u32 INVALID_VERTEX = 0xFFFFFFFF;
+static const u32 NOT_PENDING = 0xFFFFFFFF;
+static std::vector<VertexCacheEntry> vertex_cache;
+static VertexCacheStats vertex_cache_stats = {};
+
+// Vertices are processed in batches: First, the attributes of all vertices in the batch which
+// are not in the vertex cache are decoded, then these vertices are shaded, and finally the
+// results are passed to primitive assembly as a contiguous array.
+static const unsigned VERTEX_BATCH_SIZE = 1024;
+
+static struct {
+    // Indices of the vertices loaded and shaded in this batch
+    std::array<u32, VERTEX_BATCH_SIZE> loaded_vertices;
+    std::array<VertexShader::InputVertex, VERTEX_BATCH_SIZE> inputs;
+    std::array<VertexShader::OutputVertex, VERTEX_BATCH_SIZE> outputs;
+
+    // For each index in the batch, the cache entry holding its vertex, or nullptr if the vertex
+    // is to be taken from the loaded vertices at loaded_index instead
+    std::array<const VertexCacheEntry*, VERTEX_BATCH_SIZE> cache_entries;
+    std::array<u32, VERTEX_BATCH_SIZE> loaded_index;
+
+    // Vertices in the order submitted to primitive assembly
+    std::array<VertexShader::OutputVertex, VERTEX_BATCH_SIZE> assembled;
+    std::array<DebugUtils::GeometryDumper::Vertex, VERTEX_BATCH_SIZE> dumped;
+} batch;
+
+// Worker threads for shading large batches of vertices. Shader invocations are independent of
+// each other and only read shader state, which does not change during a draw.
+static std::unique_ptr<Common::ThreadPool> shader_thread_pool;
+
+// Command lists submitted to the GPU thread are copied into this queue. The mutex and condition
+// variables are only used to put either thread to sleep while it waits for the other one.
+static const size_t MAX_QUEUED_COMMAND_LISTS = 16;
+static Common::SPSCQueue<std::vector<u32>, MAX_QUEUED_COMMAND_LISTS> command_list_queue;
+static std::thread gpu_thread;
+static std::mutex gpu_thread_mutex;
+static std::condition_variable command_list_submitted;
+static std::condition_variable command_list_processed;
+static bool gpu_thread_enabled = false;
+static bool gpu_thread_running = false;   ///< Cleared under gpu_thread_mutex to stop the GPU thread
+static u64 submitted_command_lists = 0; ///< Only accessed by the CPU thread
+static std::atomic<u64> processed_command_lists(0);
+
+// The kernel can't be accessed from the GPU thread, so the P3D interrupts raised by command lists
+// are counted there and signalled by the CPU thread once it waits for the command lists
+static std::atomic<u32> pending_p3d_interrupts(0);
+
+// Register state after all command lists submitted to the GPU thread so far. The CPU thread updates
+// it while submitting a command list, to find the memory which the list's draws are going to use.
+static Regs submitted_registers;
+
+// Pages of physical memory used by queued command lists, with the PageWriteTracking flags set for
+// them. CPU accesses to these pages wait for the GPU thread until WaitForIdle drops the tracking.
+// Only accessed by the CPU thread.
+static std::unordered_map<PAddr, u8> gpu_tracked_pages;
+
+// Number of vertices shaded by each job when a batch is distributed across threads
+static const unsigned VERTICES_PER_SHADER_JOB = 64;
+
+/// Location and format of the data of one vertex attribute, resolved once per draw
+struct AttributeSource {
+    const u8* data = nullptr; // nullptr if the attribute data is not in GPU-accessible memory
+    u32 size = 0;             // Number of bytes accessible through data
+    u32 stride;
+    u32 format;
+    u32 num_elements;
+    u32 element_size;
+};
+
+/// Returns a host pointer to the given physical address and the number of bytes accessible from it
+static const u8* GetAttributeData(PAddr addr, u32& size) {
+    if (addr >= Memory::VRAM_PADDR && addr < Memory::VRAM_PADDR + Memory::VRAM_SIZE) {
+        size = Memory::VRAM_PADDR + Memory::VRAM_SIZE - addr;
+    } else if (addr >= Memory::FCRAM_PADDR && addr < Memory::FCRAM_PADDR + Memory::FCRAM_SIZE) {
+        size = Memory::FCRAM_PADDR + Memory::FCRAM_SIZE - addr;
+    } else {
+        size = 0;
+        return nullptr;
+    }
+    return Memory::GetPointer(PAddrToVAddr(addr));
+}
+
+/**
+ * Makes CPU accesses to a range of physical memory wait for the queued command lists
+ * @param reason TRACK_GPU_INPUT if the command lists read the range, TRACK_GPU_TARGET if they render to it
+ */
+static void TrackGPUMemory(PAddr addr, u64 size, Memory::PageWriteTracking reason) {
+    u32 accessible_size;
+    if (GetAttributeData(addr, accessible_size) == nullptr)
+        return;
+
+    const u64 end = addr + std::min<u64>(size, accessible_size);
+    for (u64 page = addr & ~Memory::PAGE_MASK; page < end; page += Memory::PAGE_MASK + 1) {
+        u8& tracking = gpu_tracked_pages[static_cast<PAddr>(page)];
+        if (tracking & reason)
+            continue;
+
+        tracking |= reason;
+        Memory::SetGPUPageTracking(static_cast<PAddr>(page), reason, true);
+    }
+}
+
+/// Drops the tracking of the memory used by command lists, once the GPU thread has finished them
+static void UntrackGPUMemory() {
+    for (const auto& page : gpu_tracked_pages) {
+        if (page.second & Memory::TRACK_GPU_INPUT)
+            Memory::SetGPUPageTracking(page.first, Memory::TRACK_GPU_INPUT, false);
+        if (page.second & Memory::TRACK_GPU_TARGET)
+            Memory::SetGPUPageTracking(page.first, Memory::TRACK_GPU_TARGET, false);
+    }
+    gpu_tracked_pages.clear();
+}
+
+/// Tracks the memory which a draw with the given register state reads from and renders to
+static void TrackDrawMemory(const Regs& regs, bool is_indexed) {
+    // Render targets, laid out as the rasterizer accesses them
+    const u64 num_pixels = regs.framebuffer.GetWidth() * regs.framebuffer.GetHeight();
+    TrackGPUMemory(regs.framebuffer.GetColorBufferPhysicalAddress(), num_pixels * 4, Memory::TRACK_GPU_TARGET);
+    TrackGPUMemory(regs.framebuffer.GetDepthBufferPhysicalAddress(), num_pixels * 2, Memory::TRACK_GPU_TARGET);
+
+    for (const auto& texture : regs.GetTextures()) {
+        if (!texture.enabled)
+            continue;
+
+        const u64 size = static_cast<u64>(texture.config.width) * texture.config.height * Regs::NibblesPerPixel(texture.format) / 2;
+        TrackGPUMemory(texture.config.GetPhysicalAddress(), size, Memory::TRACK_GPU_INPUT);
+    }
+
+    // Vertices are loaded by index, so the attribute data of all vertices up to the largest index
+    // may be read. The indices can't change until the draw is done, so they can be read right away.
+    const auto& attribute_config = regs.vertex_attributes;
+    const u32 base_address = attribute_config.GetPhysicalBaseAddress();
+    u64 num_vertices = regs.num_vertices;
+
+    if (is_indexed) {
+        const PAddr index_address = base_address + regs.index_array.offset;
+        const bool index_u16 = regs.index_array.format != 0;
+        const u32 index_size = index_u16 ? 2 : 1;
+        TrackGPUMemory(index_address, static_cast<u64>(regs.num_vertices) * index_size, Memory::TRACK_GPU_INPUT);
+
+        u32 accessible_size;
+        const u8* indices = GetAttributeData(index_address, accessible_size);
+        const u32 num_indices = indices ? std::min(regs.num_vertices, accessible_size / index_size) : 0;
+
+        num_vertices = 0;
+        for (u32 i = 0; i < num_indices; ++i) {
+            const u32 vertex = index_u16 ? ((const u16*)indices)[i] : indices[i];
+            num_vertices = std::max<u64>(num_vertices, vertex + 1);
+        }
+    }
+
+    if (num_vertices == 0)
+        return;
+
+    for (int loader = 0; loader < 12; ++loader) {
+        const auto& loader_config = attribute_config.attribute_loaders[loader];
+
+        // Number of bytes read for each vertex, starting at the loader's offset
+        u32 vertex_size = 0;
+        for (unsigned component = 0; component < loader_config.component_count; ++component)
+            vertex_size += attribute_config.GetStride(loader_config.GetComponent(component));
+
+        if (vertex_size == 0)
+            continue;
+
+        const u64 size = loader_config.byte_count * (num_vertices - 1) + vertex_size;
+        TrackGPUMemory(base_address + loader_config.data_offset, size, Memory::TRACK_GPU_INPUT);
+    }
+}
+
+template<typename T>
+static void LoadAttribute(const AttributeSource& source, int attribute, const u32* vertices,
+                          unsigned count, VertexShader::InputVertex* inputs) {
+    for (unsigned i = 0; i < count; ++i) {
+        u32 offset = source.stride * vertices[i];
+        for (unsigned comp = 0; comp < source.num_elements; ++comp, offset += source.element_size) {
+            // Components outside of the source buffer read as (0, 0, 0, 1), so that the slot
+            // doesn't keep the data of a vertex previously loaded into it
+            if (offset + sizeof(T) > source.size) {
+                inputs[i].attr[attribute][comp] = float24::FromFloat32(comp == 3 ? 1.0f : 0.0f);
+                continue;
+            }
+
+            inputs[i].attr[attribute][comp] = float24::FromFloat32(static_cast<float>(*(const T*)(source.data + offset)));
+        }
+    }
+}
+
+/// Decodes the input attributes of the given vertices
+static void LoadVertices(const AttributeSource* sources, int num_attributes, const u32* vertices,
+                         unsigned count, VertexShader::InputVertex* inputs) {
+    // Load a debugging token to check whether this gets loaded by the running
+    // application or not.
+    static const float24 debug_token = float24::FromRawFloat24(0x00abcdef);
+    for (unsigned i = 0; i < count; ++i)
+        inputs[i].attr[0].w = debug_token;
+
+    // Attributes are decoded one at a time so that the format only needs to be dispatched once
+    for (int attribute = 0; attribute < num_attributes; ++attribute) {
+        const AttributeSource& source = sources[attribute];
+
+        // TODO(neobrain): Ocarina of Time 3D has GetNumTotalAttributes return 8,
+        // yet only provides 2 valid source data addresses. Need to figure out
+        // what's wrong there, until then we just skip attributes whose address lookup fails
+        if (source.data == nullptr)
+            continue;
+
+        switch (source.format) {
+        case 0: LoadAttribute<s8>(source, attribute, vertices, count, inputs); break;
+        case 1: LoadAttribute<u8>(source, attribute, vertices, count, inputs); break;
+        case 2: LoadAttribute<s16>(source, attribute, vertices, count, inputs); break;
+        default: LoadAttribute<float>(source, attribute, vertices, count, inputs); break;
+        }
+    }
+
+    // HACK: Some games do not initialize the vertex position's w component. This leads
+    //       to critical issues since it messes up perspective division. As a
+    //       workaround, we force the fourth component to 1.0 if we find this to be the
+    //       case.
+    //       To do this, we additionally have to assume that the first input attribute
+    //       is the vertex position, since there's no information about this other than
+    //       the empiric observation that this is usually the case.
+    for (unsigned i = 0; i < count; ++i) {
+        if (inputs[i].attr[0].w == debug_token)
+            inputs[i].attr[0].w = float24::FromFloat32(1.0);
+    }
+}
+
 static inline void WritePicaReg(u32 id, u32 value, u32 mask) {
 
     if (id >= registers.NumIds())
@@ -48,7 +301,10 @@ static inline void WritePicaReg(u32 id, u32 value, u32 mask) {
     switch(id) {
         // Trigger IRQ
         case PICA_REG_INDEX(trigger_irq):
-            GSP_GPU::SignalInterrupt(GSP_GPU::InterruptId::P3D);
+            if (gpu_thread_enabled)
+                ++pending_p3d_interrupts;
+            else
+                GSP_GPU::SignalInterrupt(GSP_GPU::InterruptId::P3D);
             return;
 
         // It seems like these trigger vertex rendering
@@ -64,12 +320,8 @@ static inline void WritePicaReg(u32 id, u32 value, u32 mask) {
             const u32 base_address = attribute_config.GetPhysicalBaseAddress();
 
             // Information about internal vertex attributes
-            u32 vertex_attribute_sources[16];
-            std::fill(vertex_attribute_sources, &vertex_attribute_sources[16], 0xdeadbeef);
-            u32 vertex_attribute_strides[16];
-            u32 vertex_attribute_formats[16];
-            u32 vertex_attribute_elements[16];
-            u32 vertex_attribute_element_size[16];
+            const int num_attributes = attribute_config.GetNumTotalAttributes();
+            AttributeSource attribute_sources[16];
 
             // Setup attribute data from loaders
             for (int loader = 0; loader < 12; ++loader) {
@@ -80,100 +332,131 @@ static inline void WritePicaReg(u32 id, u32 value, u32 mask) {
                 // TODO: What happens if a loader overwrites a previous one's data?
                 for (unsigned component = 0; component < loader_config.component_count; ++component) {
                     u32 attribute_index = loader_config.GetComponent(component);
-                    vertex_attribute_sources[attribute_index] = load_address;
-                    vertex_attribute_strides[attribute_index] = static_cast<u32>(loader_config.byte_count);
-                    vertex_attribute_formats[attribute_index] = static_cast<u32>(attribute_config.GetFormat(attribute_index));
-                    vertex_attribute_elements[attribute_index] = attribute_config.GetNumElements(attribute_index);
-                    vertex_attribute_element_size[attribute_index] = attribute_config.GetElementSizeInBytes(attribute_index);
+                    AttributeSource& source = attribute_sources[attribute_index];
+                    source.data = GetAttributeData(load_address, source.size);
+                    source.stride = static_cast<u32>(loader_config.byte_count);
+                    source.format = static_cast<u32>(attribute_config.GetFormat(attribute_index));
+                    source.num_elements = attribute_config.GetNumElements(attribute_index);
+                    source.element_size = attribute_config.GetElementSizeInBytes(attribute_index);
+                    LOG_TRACE(HW_GPU, "Loading attribute %x from 0x%08x + 0x%08x with stride 0x%x",
+                              attribute_index, base_address, load_address - base_address, source.stride);
                     load_address += attribute_config.GetStride(attribute_index);
                 }
             }
 
             // Load vertices
             bool is_indexed = (id == PICA_REG_INDEX(trigger_draw_indexed));
+            bool use_cache = false;
 
             const auto& index_info = registers.index_array;
             const u8* index_address_8 = Memory::GetPointer(PAddrToVAddr(base_address + index_info.offset));
             const u16* index_address_16 = (u16*)index_address_8;
             bool index_u16 = index_info.format != 0;
 
+            if (is_indexed) {
+                vertex_cache.resize(std::max(0, Settings::values.vertex_cache_size));
+                for (auto& entry : vertex_cache) {
+                    entry.vertex = INVALID_VERTEX;
+                    entry.pending = NOT_PENDING;
+                }
+                use_cache = !vertex_cache.empty();
+            }
+
+            VertexShader::Setup();
+
             DebugUtils::GeometryDumper geometry_dumper;
             PrimitiveAssembler<VertexShader::OutputVertex> clipper_primitive_assembler(registers.triangle_topology.Value());
             PrimitiveAssembler<DebugUtils::GeometryDumper::Vertex> dumping_primitive_assembler(registers.triangle_topology.Value());
 
-            for (unsigned int index = 0; index < registers.num_vertices; ++index)
-            {
-                unsigned int vertex = is_indexed ? (index_u16 ? index_address_16[index] : index_address_8[index]) : index;
+            using namespace std::placeholders;
+            const PrimitiveAssembler<VertexShader::OutputVertex>::TriangleHandler clipper_handler = Clipper::ProcessTriangle;
+            const PrimitiveAssembler<DebugUtils::GeometryDumper::Vertex>::TriangleHandler dumper_handler =
+                    std::bind(&DebugUtils::GeometryDumper::AddTriangle, &geometry_dumper, _1, _2, _3);
+
+            for (unsigned batch_start = 0; batch_start < registers.num_vertices; batch_start += VERTEX_BATCH_SIZE) {
+                const unsigned batch_size = std::min<unsigned>(VERTEX_BATCH_SIZE, registers.num_vertices - batch_start);
+
+                // Determine which vertices need to be loaded. Lookups happen in submission order
+                // so that hits and evictions match processing the vertices one at a time.
+                unsigned num_loaded = 0;
+                for (unsigned i = 0; i < batch_size; ++i) {
+                    const unsigned index = batch_start + i;
+                    const u32 vertex = is_indexed ? (index_u16 ? index_address_16[index] : index_address_8[index]) : index;
+
+                    batch.cache_entries[i] = nullptr;
+
+                    if (use_cache) {
+                        VertexCacheEntry& entry = vertex_cache[vertex % vertex_cache.size()];
+                        if (entry.vertex == vertex) {
+                            ++vertex_cache_stats.hits;
+                            if (entry.pending == NOT_PENDING)
+                                batch.cache_entries[i] = &entry;
+                            else
+                                batch.loaded_index[i] = entry.pending;
+                            continue;
+                        }
+
+                        ++vertex_cache_stats.misses;
+                        entry.vertex = vertex;
+                        entry.pending = num_loaded;
+                    }
 
-                if (is_indexed) {
-                    // TODO: Implement some sort of vertex cache!
+                    batch.loaded_vertices[num_loaded] = vertex;
+                    batch.loaded_index[i] = num_loaded++;
                 }
 
-                // Initialize data for the current vertex
-                VertexShader::InputVertex input;
+                LoadVertices(attribute_sources, num_attributes, batch.loaded_vertices.data(),
+                             num_loaded, batch.inputs.data());
 
-                // Load a debugging token to check whether this gets loaded by the running
-                // application or not.
-                static const float24 debug_token = float24::FromRawFloat24(0x00abcdef);
-                input.attr[0].w = debug_token;
+                // Send to vertex shader
+                if (shader_thread_pool && num_loaded >= (unsigned)Settings::values.vertex_shader_parallel_threshold) {
+                    const size_t num_jobs = (num_loaded + VERTICES_PER_SHADER_JOB - 1) / VERTICES_PER_SHADER_JOB;
+                    shader_thread_pool->ParallelFor(num_jobs, [num_loaded, num_attributes](size_t job) {
+                        const unsigned end = std::min<unsigned>(num_loaded, (unsigned)(job + 1) * VERTICES_PER_SHADER_JOB);
+                        for (unsigned i = (unsigned)job * VERTICES_PER_SHADER_JOB; i < end; ++i)
+                            batch.outputs[i] = VertexShader::RunShader(batch.inputs[i], num_attributes);
+                    });
+                } else {
+                    for (unsigned i = 0; i < num_loaded; ++i)
+                        batch.outputs[i] = VertexShader::RunShader(batch.inputs[i], num_attributes);
+                }
 
-                for (int i = 0; i < attribute_config.GetNumTotalAttributes(); ++i) {
-                    for (unsigned int comp = 0; comp < vertex_attribute_elements[i]; ++comp) {
-                        const u8* srcdata = Memory::GetPointer(PAddrToVAddr(vertex_attribute_sources[i] + vertex_attribute_strides[i] * vertex + comp * vertex_attribute_element_size[i]));
+                for (unsigned i = 0; i < batch_size; ++i) {
+                    const VertexCacheEntry* entry = batch.cache_entries[i];
+                    const VertexShader::InputVertex& input = entry ? entry->input : batch.inputs[batch.loaded_index[i]];
 
-                        // TODO(neobrain): Ocarina of Time 3D has GetNumTotalAttributes return 8,
-                        // yet only provides 2 valid source data addresses. Need to figure out
-                        // what's wrong there, until then we just continue when address lookup fails
-                        if (srcdata == nullptr)
-                            continue;
+                    if (g_debug_context)
+                        g_debug_context->OnEvent(DebugContext::Event::VertexLoaded, (void*)&input);
 
-                        const float srcval = (vertex_attribute_formats[i] == 0) ? *(s8*)srcdata :
-                                             (vertex_attribute_formats[i] == 1) ? *(u8*)srcdata :
-                                             (vertex_attribute_formats[i] == 2) ? *(s16*)srcdata :
-                                                                                  *(float*)srcdata;
-                        input.attr[i][comp] = float24::FromFloat32(srcval);
-                        LOG_TRACE(HW_GPU, "Loaded component %x of attribute %x for vertex %x (index %x) from 0x%08x + 0x%08lx + 0x%04lx: %f",
-                                  comp, i, vertex, index,
-                                  attribute_config.GetPhysicalBaseAddress(),
-                                  vertex_attribute_sources[i] - base_address,
-                                  vertex_attribute_strides[i] * vertex + comp * vertex_attribute_element_size[i],
-                                  input.attr[i][comp].ToFloat32());
-                    }
-                }
+                    // NOTE: When dumping geometry, we simply assume that the first input attribute
+                    //       corresponds to the position for now.
+                    batch.dumped[i] = {
+                        input.attr[0][0].ToFloat32(), input.attr[0][1].ToFloat32(), input.attr[0][2].ToFloat32()
+                    };
 
-                // HACK: Some games do not initialize the vertex position's w component. This leads
-                //       to critical issues since it messes up perspective division. As a
-                //       workaround, we force the fourth component to 1.0 if we find this to be the
-                //       case.
-                //       To do this, we additionally have to assume that the first input attribute
-                //       is the vertex position, since there's no information about this other than
-                //       the empiric observation that this is usually the case.
-                if (input.attr[0].w == debug_token)
-                    input.attr[0].w = float24::FromFloat32(1.0);
-
-                if (g_debug_context)
-                    g_debug_context->OnEvent(DebugContext::Event::VertexLoaded, (void*)&input);
-
-                // NOTE: When dumping geometry, we simply assume that the first input attribute
-                //       corresponds to the position for now.
-                DebugUtils::GeometryDumper::Vertex dumped_vertex = {
-                    input.attr[0][0].ToFloat32(), input.attr[0][1].ToFloat32(), input.attr[0][2].ToFloat32()
-                };
-                using namespace std::placeholders;
-                dumping_primitive_assembler.SubmitVertex(dumped_vertex,
-                                                         std::bind(&DebugUtils::GeometryDumper::AddTriangle,
-                                                                   &geometry_dumper, _1, _2, _3));
+                    batch.assembled[i] = entry ? entry->output : batch.outputs[batch.loaded_index[i]];
+                }
 
-                // Send to vertex shader
-                VertexShader::OutputVertex output = VertexShader::RunShader(input, attribute_config.GetNumTotalAttributes());
+                // Entries claimed by this batch only become usable once their vertex has been
+                // shaded. Entries claimed again by a later vertex of the batch are skipped.
+                if (use_cache) {
+                    for (unsigned i = 0; i < num_loaded; ++i) {
+                        VertexCacheEntry& entry = vertex_cache[batch.loaded_vertices[i] % vertex_cache.size()];
+                        if (entry.pending != i)
+                            continue;
 
-                if (is_indexed) {
-                    // TODO: Add processed vertex to vertex cache!
+                        entry.pending = NOT_PENDING;
+                        entry.input = batch.inputs[i];
+                        entry.output = batch.outputs[i];
+                    }
                 }
 
+                dumping_primitive_assembler.SubmitVertices(batch.dumped.data(), batch_size, dumper_handler);
+
                 // Send to triangle clipper
-                clipper_primitive_assembler.SubmitVertex(output, Clipper::ProcessTriangle);
+                clipper_primitive_assembler.SubmitVertices(batch.assembled.data(), batch_size, clipper_handler);
             }
+            Rasterizer::Flush();
             geometry_dumper.Dump();
 
             if (g_debug_context)
@@ -300,6 +583,27 @@ static inline void WritePicaReg(u32 id, u32 value, u32 mask) {
         g_debug_context->OnEvent(DebugContext::Event::CommandProcessed, reinterpret_cast<void*>(&id));
 }
 
+/**
+ * Applies a register write of a command list to submitted_registers, and tracks the memory used
+ * by the draws it triggers. The state is kept the same as the one WritePicaReg will produce.
+ */
+static void ScanPicaReg(u32 id, u32 value, u32 mask) {
+    if (id >= submitted_registers.NumIds())
+        return;
+
+    // g_skip_frame only changes while the GPU thread is idle, so the write is skipped there as well
+    if (GPU::g_skip_frame && id != PICA_REG_INDEX(trigger_irq))
+        return;
+
+    u32 old_value = submitted_registers[id];
+    submitted_registers[id] = (old_value & ~mask) | (value & mask);
+
+    if (id == PICA_REG_INDEX(trigger_draw) || id == PICA_REG_INDEX(trigger_draw_indexed))
+        TrackDrawMemory(submitted_registers, id == PICA_REG_INDEX(trigger_draw_indexed));
+}
+
+/// Passes the register writes of the command block at first_command_word to WriteReg
+template<void (*WriteReg)(u32 id, u32 value, u32 mask)>
 static std::ptrdiff_t ExecuteCommandBlock(const u32* first_command_word) {
     const CommandHeader& header = *(const CommandHeader*)(&first_command_word[1]);
 
@@ -310,12 +614,12 @@ static std::ptrdiff_t ExecuteCommandBlock(const u32* first_command_word) {
                            ((header.parameter_mask & 0x4) ? (0xFFu << 16) : 0u) |
                            ((header.parameter_mask & 0x8) ? (0xFFu << 24) : 0u);
 
-    WritePicaReg(header.cmd_id, *read_pointer, write_mask);
+    WriteReg(header.cmd_id, *read_pointer, write_mask);
     read_pointer += 2;
 
     for (unsigned int i = 1; i < 1+header.extra_data_length; ++i) {
         u32 cmd = header.cmd_id + ((header.group_commands) ? i : 0);
-        WritePicaReg(cmd, *read_pointer, write_mask);
+        WriteReg(cmd, *read_pointer, write_mask);
         ++read_pointer;
     }
 
@@ -326,12 +630,128 @@ static std::ptrdiff_t ExecuteCommandBlock(const u32* first_command_word) {
     return read_pointer - first_command_word;
 }
 
+/// Processes the submitted command lists in order, until the GPU thread is stopped
+static void GPUThreadMain() {
+    std::vector<u32> list;
+    while (true) {
+        if (!command_list_queue.TryPop(list)) {
+            std::unique_lock<std::mutex> lock(gpu_thread_mutex);
+            command_list_submitted.wait(lock, [] {
+                return !command_list_queue.IsEmpty() || !gpu_thread_running;
+            });
+            if (command_list_queue.IsEmpty())
+                return;
+            continue;
+        }
+
+        ProcessCommandList(list.data(), static_cast<u32>(list.size() * sizeof(u32)));
+
+        {
+            std::lock_guard<std::mutex> lock(gpu_thread_mutex);
+            ++processed_command_lists;
+        }
+        command_list_processed.notify_all();
+    }
+}
+
+void Init() {
+    if (Settings::values.vertex_shader_threads > 1) {
+        shader_thread_pool = Common::make_unique<Common::ThreadPool>(Settings::values.vertex_shader_threads);
+        LOG_INFO(HW_GPU, "Shading vertices on %d threads", Settings::values.vertex_shader_threads);
+    }
+
+    if (Settings::values.use_gpu_thread) {
+        for (unsigned id = 0; id < Regs::NumIds(); ++id)
+            submitted_registers[id] = registers[id];
+        gpu_thread_enabled = true;
+        gpu_thread_running = true;
+        gpu_thread = std::thread(GPUThreadMain);
+        LOG_INFO(HW_GPU, "Processing command lists on the GPU thread");
+    }
+}
+
+void Shutdown() {
+    if (gpu_thread_enabled) {
+        // The GPU thread finishes the queued command lists before it stops
+        {
+            std::lock_guard<std::mutex> lock(gpu_thread_mutex);
+            gpu_thread_running = false;
+        }
+        command_list_submitted.notify_one();
+        gpu_thread.join();
+        TextureCache::UpdatePageTracking();
+        UntrackGPUMemory();
+
+        gpu_thread_enabled = false;
+        submitted_command_lists = 0;
+        processed_command_lists = 0;
+        pending_p3d_interrupts = 0;
+    }
+
+    shader_thread_pool.reset();
+}
+
+void SubmitCommandList(const u32* list, u32 size) {
+    if (!gpu_thread_enabled) {
+        ProcessCommandList(list, size);
+        TextureCache::UpdatePageTracking();
+        return;
+    }
+
+    std::vector<u32> copy(list, list + size / sizeof(u32));
+    while (!command_list_queue.TryPush(std::move(copy))) {
+        // The queue is full, let the GPU thread catch up
+        WaitForIdle();
+    }
+    ++submitted_command_lists;
+
+    // Taking the lock makes sure the GPU thread either sees the new list or is already waiting
+    {
+        std::lock_guard<std::mutex> lock(gpu_thread_mutex);
+    }
+    command_list_submitted.notify_one();
+
+    // The CPU thread can't access memory before this returns, so the list may already be running
+    const u32* read_pointer = list;
+    while (read_pointer < list + size / sizeof(u32))
+        read_pointer += ExecuteCommandBlock<ScanPicaReg>(read_pointer);
+}
+
+void WaitForIdle() {
+    if (!gpu_thread_enabled)
+        return;
+
+    if (processed_command_lists != submitted_command_lists) {
+        std::unique_lock<std::mutex> lock(gpu_thread_mutex);
+        command_list_processed.wait(lock, [] {
+            return processed_command_lists == submitted_command_lists;
+        });
+    }
+
+    // Track the pages of the textures cached by the command lists before dropping the tracking for
+    // the command lists, so that CPU writes to those pages go through the slow path throughout
+    TextureCache::UpdatePageTracking();
+    UntrackGPUMemory();
+
+    // Signalling an interrupt waits for the GPU thread again, which returns right away now
+    for (u32 count = pending_p3d_interrupts.exchange(0); count > 0; --count)
+        GSP_GPU::SignalInterrupt(GSP_GPU::InterruptId::P3D);
+}
+
+const VertexCacheStats& GetVertexCacheStats() {
+    return vertex_cache_stats;
+}
+
+void ResetVertexCacheStats() {
+    vertex_cache_stats = {};
+}
+
 void ProcessCommandList(const u32* list, u32 size) {
     u32* read_pointer = (u32*)list;
     u32 list_length = size / sizeof(u32);
 
     while (read_pointer < list + list_length) {
-        read_pointer += ExecuteCommandBlock(read_pointer);
+        read_pointer += ExecuteCommandBlock<WritePicaReg>(read_pointer);
     }
 }
 
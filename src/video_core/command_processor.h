@@ -35,8 +35,42 @@ static_assert(std::is_standard_layout<CommandHeader>::value == true,
               "CommandHeader does not use standard layout");
 static_assert(sizeof(CommandHeader) == sizeof(u32), "CommandHeader has incorrect size!");
 
+/// Sets up the GPU thread and the worker threads used for vertex shading according to the current settings
+void Init();
+
+/// Finishes the submitted command lists and stops the GPU thread and the vertex shading worker threads
+void Shutdown();
+
 void ProcessCommandList(const u32* list, u32 size);
 
+/**
+ * Processes a command list on the GPU thread if it is enabled, otherwise right away. The list is
+ * copied, so its memory may be reused as soon as this returns. The memory which the list's draws
+ * read from and render to is tracked, so that CPU accesses to it wait for the GPU thread.
+ */
+void SubmitCommandList(const u32* list, u32 size);
+
+/**
+ * Blocks until the GPU thread has processed all the submitted command lists, then signals the
+ * interrupts they raised. CPU accesses through the memory functions to memory that the submitted
+ * command lists use wait on their own, since that memory is tracked until this is called. Host
+ * code needs to call this before it accesses such memory directly, or signals another GPU
+ * interrupt. Does nothing if the GPU thread is disabled.
+ */
+void WaitForIdle();
+
+/// Statistics of the post-transform vertex cache used for indexed draws
+struct VertexCacheStats {
+    u64 hits;   ///< Number of vertices taken from the cache
+    u64 misses; ///< Number of vertices which had to be loaded and shaded
+};
+
+/// Returns the vertex cache statistics accumulated since the last reset
+const VertexCacheStats& GetVertexCacheStats();
+
+/// Resets the vertex cache statistics to zero
+void ResetVertexCacheStats();
+
 } // namespace
 
 } // namespace
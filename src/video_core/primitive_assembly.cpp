@@ -16,7 +16,7 @@ PrimitiveAssembler<VertexType>::PrimitiveAssembler(Regs::TriangleTopology topolo
 }
 
 template<typename VertexType>
-void PrimitiveAssembler<VertexType>::SubmitVertex(VertexType& vtx, TriangleHandler triangle_handler)
+void PrimitiveAssembler<VertexType>::SubmitVertex(VertexType& vtx, const TriangleHandler& triangle_handler)
 {
     switch (topology) {
         case Regs::TriangleTopology::List:
@@ -55,6 +55,13 @@ void PrimitiveAssembler<VertexType>::SubmitVertex(VertexType& vtx, TriangleHandl
     }
 }
 
+template<typename VertexType>
+void PrimitiveAssembler<VertexType>::SubmitVertices(VertexType* vertices, size_t count, const TriangleHandler& triangle_handler)
+{
+    for (size_t i = 0; i < count; ++i)
+        SubmitVertex(vertices[i], triangle_handler);
+}
+
 // explicitly instantiate use cases
 template
 struct PrimitiveAssembler<VertexShader::OutputVertex>;
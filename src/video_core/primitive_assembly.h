@@ -30,7 +30,13 @@ struct PrimitiveAssembler {
      * NOTE: We could specify the triangle handler in the constructor, but this way we can
      * keep event and handler code next to each other.
      */
-    void SubmitVertex(VertexType& vtx, TriangleHandler triangle_handler);
+    void SubmitVertex(VertexType& vtx, const TriangleHandler& triangle_handler);
+
+    /*
+     * Queues a contiguous array of vertices in order. Equivalent to calling SubmitVertex for
+     * each of them, but avoids constructing a triangle handler per vertex.
+     */
+    void SubmitVertices(VertexType* vertices, size_t count, const TriangleHandler& triangle_handler);
 
 private:
     Regs::TriangleTopology topology;
@@ -3,16 +3,33 @@
 // Refer to the license.txt file included.
 
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "common/common_types.h"
+#include "common/cpu_detect.h"
+#include "common/hash.h"
+#include "common/make_unique.h"
+#include "common/thread_pool.h"
+
+#include "core/settings.h"
 
 #include "math.h"
 #include "pica.h"
 #include "rasterizer.h"
+#include "texture_cache.h"
 #include "vertex_shader.h"
 
 #include "debug_utils/debug_utils.h"
 
+#if defined(__SSE2__) || (defined(_MSC_VER) && (defined(_M_X64) || _M_IX86_FP >= 2))
+#define RASTERIZER_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace Pica {
 
 namespace Rasterizer {
@@ -90,9 +107,69 @@ static int SignedArea (const Math::Vec2<Fix12P4>& vtx1,
     return Math::Cross(vec1, vec2).z;
 };
 
-void ProcessTriangle(const VertexShader::OutputVertex& v0,
-                     const VertexShader::OutputVertex& v1,
-                     const VertexShader::OutputVertex& v2)
+/**
+ * Edge function of a triangle, i.e. the signed area of the triangle spanned by an edge and a
+ * given point, plus a constant bias. Being linear, it can be evaluated incrementally when
+ * stepping from one pixel to the next.
+ */
+struct EdgeEquation {
+    EdgeEquation() = default;
+
+    EdgeEquation(const Math::Vec2<Fix12P4>& vtx1, const Math::Vec2<Fix12P4>& vtx2, int bias)
+        : origin_x(vtx1.x), origin_y(vtx1.y), bias(bias) {
+        // Expanded form of bias + SignedArea(vtx1, vtx2, {x, y})
+        dx = (int)vtx1.y - (int)vtx2.y;
+        dy = (int)vtx2.x - (int)vtx1.x;
+        step_x = dx * 0x10;
+        step_y = dy * 0x10;
+    }
+
+    /// Evaluates the edge function at the given point in rasterizer coordinates
+    int Evaluate(unsigned x, unsigned y) const {
+        // Like SignedArea, this works on differences to vtx1, but products of two differences
+        // between 12.4 coordinates may still exceed the range of int, hence the 64-bit math.
+        return (int)(bias + (s64)dx * ((int)x - origin_x) + (s64)dy * ((int)y - origin_y));
+    }
+
+    int dx, dy;
+    int origin_x, origin_y; // Position of vtx1
+    int bias;
+
+    // Increments of the edge function when moving by one pixel along the x or y axis
+    int step_x, step_y;
+};
+
+struct FragmentPipeline;
+
+/// Per-triangle data computed once during setup and shared by all screen tiles it covers
+struct TriangleSetup {
+    VertexShader::OutputVertex v0, v1, v2;
+
+    // vertex positions in rasterizer coordinates
+    Math::Vec3<Fix12P4> vtxpos[3];
+
+    // Bounding box in rasterizer coordinates; max_x and max_y are exclusive
+    u16 min_x, min_y;
+    u16 max_x, max_y;
+
+    // Edge functions yielding the barycentric coordinates w0, w1 and w2, respectively
+    std::array<EdgeEquation, 3> edges;
+
+    // Fragment pipeline for the register state the triangle was submitted with
+    const FragmentPipeline* pipeline;
+
+    // Decoded texture data for each texture unit, or nullptr if the unit is disabled
+    std::array<const TextureCache::CachedTexture*, 3> textures;
+};
+
+/**
+ * Computes the rasterizer setup data for the given triangle.
+ * @return false if the triangle got culled, true otherwise
+ */
+static bool SetupTriangle(const VertexShader::OutputVertex& v0,
+                          const VertexShader::OutputVertex& v1,
+                          const VertexShader::OutputVertex& v2,
+                          TriangleSetup& setup)
 {
     // vertex positions in rasterizer coordinates
     auto FloatToFix = [](float24 flt) {
@@ -102,9 +179,10 @@ void ProcessTriangle(const VertexShader::OutputVertex& v0,
                                              return Math::Vec3<Fix12P4>{FloatToFix(vec.x), FloatToFix(vec.y), FloatToFix(vec.z)};
                                          };
 
-    Math::Vec3<Fix12P4> vtxpos[3]{ ScreenToRasterizerCoordinates(v0.screenpos),
-                                   ScreenToRasterizerCoordinates(v1.screenpos),
-                                   ScreenToRasterizerCoordinates(v2.screenpos) };
+    auto& vtxpos = setup.vtxpos;
+    vtxpos[0] = ScreenToRasterizerCoordinates(v0.screenpos);
+    vtxpos[1] = ScreenToRasterizerCoordinates(v1.screenpos);
+    vtxpos[2] = ScreenToRasterizerCoordinates(v2.screenpos);
 
     if (registers.cull_mode == Regs::CullMode::KeepClockWise) {
         // Reverse vertex order and use the CCW code path.
@@ -115,7 +193,7 @@ void ProcessTriangle(const VertexShader::OutputVertex& v0,
         // Cull away triangles which are wound clockwise.
         // TODO: A check for degenerate triangles ("== 0") should be considered for CullMode::KeepAll
         if (SignedArea(vtxpos[0].xy(), vtxpos[1].xy(), vtxpos[2].xy()) <= 0)
-            return;
+            return false;
     }
 
     // TODO: Proper scissor rect test!
@@ -150,398 +228,1431 @@ void ProcessTriangle(const VertexShader::OutputVertex& v0,
     int bias1 = IsRightSideOrFlatBottomEdge(vtxpos[1].xy(), vtxpos[2].xy(), vtxpos[0].xy()) ? -1 : 0;
     int bias2 = IsRightSideOrFlatBottomEdge(vtxpos[2].xy(), vtxpos[0].xy(), vtxpos[1].xy()) ? -1 : 0;
 
-    auto w_inverse = Math::MakeVec(v0.pos.w, v1.pos.w, v2.pos.w);
+    // The barycentric coordinates w0, w1 and w2 of a pixel are given by the signed areas of the
+    // triangles spanned by the pixel and the edges opposite of each vertex.
+    setup.edges[0] = EdgeEquation(vtxpos[1].xy(), vtxpos[2].xy(), bias0);
+    setup.edges[1] = EdgeEquation(vtxpos[2].xy(), vtxpos[0].xy(), bias1);
+    setup.edges[2] = EdgeEquation(vtxpos[0].xy(), vtxpos[1].xy(), bias2);
 
-    auto textures = registers.GetTextures();
-    auto tev_stages = registers.GetTevStages();
+    setup.min_x = min_x;
+    setup.min_y = min_y;
+    setup.max_x = max_x;
+    setup.max_y = max_y;
 
-    // TODO: Not sure if looping through x first might be faster
-    for (u16 y = min_y; y < max_y; y += 0x10) {
-        for (u16 x = min_x; x < max_x; x += 0x10) {
+    setup.v0 = v0;
+    setup.v1 = v1;
+    setup.v2 = v2;
 
-            // Calculate the barycentric coordinates w0, w1 and w2
-            int w0 = bias0 + SignedArea(vtxpos[1].xy(), vtxpos[2].xy(), {x, y});
-            int w1 = bias1 + SignedArea(vtxpos[2].xy(), vtxpos[0].xy(), {x, y});
-            int w2 = bias2 + SignedArea(vtxpos[0].xy(), vtxpos[1].xy(), {x, y});
-            int wsum = w0 + w1 + w2;
+    return true;
+}
 
-            // If current pixel is not covered by the current primitive
-            if (w0 < 0 || w1 < 0 || w2 < 0)
-                continue;
+/**
+ * Looks up the color of the given texture at the given texel coordinates, applying the
+ * configured texture coordinate wrapping modes.
+ */
+static const Math::Vec4<u8>& SampleTexture(const Regs::FullTextureConfig& texture,
+                                           const TextureCache::CachedTexture& texture_data,
+                                           int s, int t) {
+    auto GetWrappedTexCoord = [](Regs::TextureConfig::WrapMode mode, int val, unsigned size) {
+        switch (mode) {
+            case Regs::TextureConfig::ClampToEdge:
+                val = std::max(val, 0);
+                val = std::min(val, (int)size - 1);
+                return val;
+
+            case Regs::TextureConfig::Repeat:
+                return (int)(((unsigned)val) % size);
+
+            default:
+                LOG_ERROR(HW_GPU, "Unknown texture coordinate wrapping mode %x\n", (int)mode);
+                _dbg_assert_(HW_GPU, 0);
+                return 0;
+        }
+    };
+    s = GetWrappedTexCoord(texture.config.wrap_s, s, texture.config.width);
+    t = texture.config.height - 1 - GetWrappedTexCoord(texture.config.wrap_t, t, texture.config.height);
 
-            auto baricentric_coordinates = Math::MakeVec(float24::FromFloat32(static_cast<float>(w0)),
-                                                float24::FromFloat32(static_cast<float>(w1)),
-                                                float24::FromFloat32(static_cast<float>(w2)));
-            float24 interpolated_w_inverse = float24::FromFloat32(1.0f) / Math::Dot(w_inverse, baricentric_coordinates);
-
-            // Perspective correct attribute interpolation:
-            // Attribute values cannot be calculated by simple linear interpolation since
-            // they are not linear in screen space. For example, when interpolating a
-            // texture coordinate across two vertices, something simple like
-            //     u = (u0*w0 + u1*w1)/(w0+w1)
-            // will not work. However, the attribute value divided by the
-            // clipspace w-coordinate (u/w) and and the inverse w-coordinate (1/w) are linear
-            // in screenspace. Hence, we can linearly interpolate these two independently and
-            // calculate the interpolated attribute by dividing the results.
-            // I.e.
-            //     u_over_w   = ((u0/v0.pos.w)*w0 + (u1/v1.pos.w)*w1)/(w0+w1)
-            //     one_over_w = (( 1/v0.pos.w)*w0 + ( 1/v1.pos.w)*w1)/(w0+w1)
-            //     u = u_over_w / one_over_w
-            //
-            // The generalization to three vertices is straightforward in baricentric coordinates.
-            auto GetInterpolatedAttribute = [&](float24 attr0, float24 attr1, float24 attr2) {
-                auto attr_over_w = Math::MakeVec(attr0, attr1, attr2);
-                float24 interpolated_attr_over_w = Math::Dot(attr_over_w, baricentric_coordinates);
-                return interpolated_attr_over_w * interpolated_w_inverse;
-            };
-
-            Math::Vec4<u8> primary_color{
-                (u8)(GetInterpolatedAttribute(v0.color.r(), v1.color.r(), v2.color.r()).ToFloat32() * 255),
-                (u8)(GetInterpolatedAttribute(v0.color.g(), v1.color.g(), v2.color.g()).ToFloat32() * 255),
-                (u8)(GetInterpolatedAttribute(v0.color.b(), v1.color.b(), v2.color.b()).ToFloat32() * 255),
-                (u8)(GetInterpolatedAttribute(v0.color.a(), v1.color.a(), v2.color.a()).ToFloat32() * 255)
-            };
-
-            Math::Vec2<float24> uv[3];
-            uv[0].u() = GetInterpolatedAttribute(v0.tc0.u(), v1.tc0.u(), v2.tc0.u());
-            uv[0].v() = GetInterpolatedAttribute(v0.tc0.v(), v1.tc0.v(), v2.tc0.v());
-            uv[1].u() = GetInterpolatedAttribute(v0.tc1.u(), v1.tc1.u(), v2.tc1.u());
-            uv[1].v() = GetInterpolatedAttribute(v0.tc1.v(), v1.tc1.v(), v2.tc1.v());
-            uv[2].u() = GetInterpolatedAttribute(v0.tc2.u(), v1.tc2.u(), v2.tc2.u());
-            uv[2].v() = GetInterpolatedAttribute(v0.tc2.v(), v1.tc2.v(), v2.tc2.v());
-
-            Math::Vec4<u8> texture_color[3]{};
-            for (int i = 0; i < 3; ++i) {
-                const auto& texture = textures[i];
-                if (!texture.enabled)
-                    continue;
+    return texture_data.GetTexel(s, t);
+}
 
-                _dbg_assert_(HW_GPU, 0 != texture.config.address);
+#ifdef RASTERIZER_SSE2
 
-                int s = (int)(uv[i].u() * float24::FromFloat32(static_cast<float>(texture.config.width))).ToFloat32();
-                int t = (int)(uv[i].v() * float24::FromFloat32(static_cast<float>(texture.config.height))).ToFloat32();
-                auto GetWrappedTexCoord = [](Regs::TextureConfig::WrapMode mode, int val, unsigned size) {
-                    switch (mode) {
-                        case Regs::TextureConfig::ClampToEdge:
-                            val = std::max(val, 0);
-                            val = std::min(val, (int)size - 1);
-                            return val;
+// Whether spans of pixels are shaded using SSE2 instead of pixel by pixel, decided at startup
+static bool use_sse2 = false;
 
-                        case Regs::TextureConfig::Repeat:
-                            return (int)(((unsigned)val) % size);
+/// Color values of four pixels, with each channel stored in one 32-bit lane per pixel
+struct ColorSSE2 {
+    __m128i r, g, b, a;
+};
 
-                        default:
-                            LOG_ERROR(HW_GPU, "Unknown texture coordinate wrapping mode %x\n", (int)mode);
-                            _dbg_assert_(HW_GPU, 0);
-                            return 0;
-                    }
-                };
-                s = GetWrappedTexCoord(texture.config.wrap_s, s, texture.config.width);
-                t = texture.config.height - 1 - GetWrappedTexCoord(texture.config.wrap_t, t, texture.config.height);
+/// Divides each lane by 255, rounding towards zero. Only exact for values up to 65534.
+static inline __m128i Div255SSE2(__m128i value) {
+    // value / 255 == (value + 1 + (value >> 8)) >> 8 for all value <= 65534
+    __m128i tmp = _mm_add_epi32(_mm_add_epi32(value, _mm_set1_epi32(1)), _mm_srli_epi32(value, 8));
+    return _mm_srli_epi32(tmp, 8);
+}
+
+/// Multiplies each lane of a by the corresponding lane of b. Lanes must be within [0, 255].
+static inline __m128i MultiplySSE2(__m128i a, __m128i b) {
+    // With the upper halves of all lanes being zero, this is a plain 32-bit multiplication
+    return _mm_madd_epi16(a, b);
+}
+
+/// Converts normalized color values to 8 bit, truncating just like the scalar (u8) cast does
+static inline __m128i ColorToU8SSE2(__m128 value) {
+    return _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(value, _mm_set1_ps(255.f))), _mm_set1_epi32(0xFF));
+}
+
+#endif // RASTERIZER_SSE2
+
+// Color values available as inputs to the TEV stages of a pixel
+enum CombinerSource : u8 {
+    SOURCE_PRIMARY_COLOR,
+    SOURCE_TEXTURE0,
+    SOURCE_TEXTURE1,
+    SOURCE_TEXTURE2,
+    SOURCE_CONSTANT,
+    SOURCE_PREVIOUS,
+    SOURCE_ZERO, // stand-in for unknown sources
+
+    NUM_COMBINER_SOURCES
+};
+
+using CombinerInputs = std::array<Math::Vec4<u8>, NUM_COMBINER_SOURCES>;
+
+/// TEV stage configuration resolved to a form which can be applied without any branches
+struct PipelineStage {
+    std::array<CombinerSource, 3> color_sources;
+    std::array<CombinerSource, 3> alpha_sources;
+
+    // Modifiers are applied as (value ^ modifier_xor) & modifier_and, where value is either the
+    // RGB or (for color modifiers with alpha_to_rgb set) the replicated alpha component of the
+    // source. This covers inversion as well as yielding zero for unknown modifiers.
+    std::array<bool, 3> color_modifier_alpha_to_rgb;
+    std::array<u8, 3> color_modifier_xor;
+    std::array<u8, 3> color_modifier_and;
+    std::array<u8, 3> alpha_modifier_xor;
+    std::array<u8, 3> alpha_modifier_and;
+
+    Math::Vec4<u8> constant;
+
+    // Applies this stage, writing the result to inputs[SOURCE_PREVIOUS]. These are specialized
+    // for the combiner operations of the stage.
+    void (*run)(const PipelineStage& stage, CombinerInputs& inputs);
+#ifdef RASTERIZER_SSE2
+    void (*run_sse2)(const PipelineStage& stage, ColorSSE2 inputs[NUM_COMBINER_SOURCES]);
+#endif
+};
+
+/// Raw register words determining the behavior of a FragmentPipeline
+struct PipelineKey {
+    u32 tev_stages[6][4];
+    u32 output_merger[sizeof(Regs::output_merger) / sizeof(u32)];
+
+    bool operator == (const PipelineKey& other) const {
+        return 0 == memcmp(this, &other, sizeof(PipelineKey));
+    }
+};
+
+/**
+ * Texture environment and output merger configuration, decoded from the GPU registers.
+ *
+ * Games tend to reuse a handful of configurations for thousands of draws, so rather than
+ * decoding the registers and switching over their values for every pixel, pipelines are built
+ * once per configuration and cached. Shading a pixel then only requires table lookups and calls
+ * to TEV stage functions specialized for the configured combiner operations.
+ */
+struct FragmentPipeline {
+    PipelineKey key;
+
+    std::array<PipelineStage, 6> stages;
+
+    bool depth_test_enable;
+    bool depth_write_enable;
+
+    // Whether the depth test passes if the fragment depth is less than, equal to or greater than
+    // the value in the depth buffer, respectively
+    bool depth_pass_less;
+    bool depth_pass_equal;
+    bool depth_pass_greater;
+
+    // False if the configured output merger mode is not implemented, yet
+    bool blend_supported;
+
+    // Blend factors are computed as (source_alpha & factor_and) ^ factor_xor.
+    // Indices: 0 = source RGB, 1 = source alpha, 2 = destination RGB, 3 = destination alpha
+    std::array<u8, 4> blend_factor_and;
+    std::array<u8, 4> blend_factor_xor;
+};
+
+template <Regs::TevStageConfig::Operation op>
+static Math::Vec3<u8> ColorCombine(const Math::Vec3<u8> input[3]) {
+    using Operation = Regs::TevStageConfig::Operation;
+
+    switch (op) {
+    case Operation::Replace:
+        return input[0];
+
+    case Operation::Modulate:
+        return ((input[0] * input[1]) / 255).Cast<u8>();
+
+    case Operation::Add:
+    {
+        auto result = input[0] + input[1];
+        result.r() = std::min(255, result.r());
+        result.g() = std::min(255, result.g());
+        result.b() = std::min(255, result.b());
+        return result.Cast<u8>();
+    }
+
+    case Operation::Lerp:
+        return ((input[0] * input[2] + input[1] * (Math::MakeVec<u8>(255, 255, 255) - input[2]).Cast<u8>()) / 255).Cast<u8>();
+
+    case Operation::Subtract:
+    {
+        auto result = input[0].Cast<int>() - input[1].Cast<int>();
+        result.r() = std::max(0, result.r());
+        result.g() = std::max(0, result.g());
+        result.b() = std::max(0, result.b());
+        return result.Cast<u8>();
+    }
+
+    default:
+        // Unknown operations have been reported when building the pipeline
+        return {};
+    }
+}
+
+template <Regs::TevStageConfig::Operation op>
+static u8 AlphaCombine(const std::array<u8,3>& input) {
+    using Operation = Regs::TevStageConfig::Operation;
+
+    switch (op) {
+    case Operation::Replace:
+        return input[0];
 
-                u8* texture_data = Memory::GetPointer(PAddrToVAddr(texture.config.GetPhysicalAddress()));
-                auto info = DebugUtils::TextureInfo::FromPicaRegister(texture.config, texture.format);
+    case Operation::Modulate:
+        return input[0] * input[1] / 255;
 
-                texture_color[i] = DebugUtils::LookupTexture(texture_data, s, t, info);
-                DebugUtils::DumpTexture(texture.config, texture_data);
+    case Operation::Add:
+        return std::min(255, input[0] + input[1]);
+
+    case Operation::Lerp:
+        return (input[0] * input[2] + input[1] * (255 - input[2])) / 255;
+
+    case Operation::Subtract:
+        return std::max(0, (int)input[0] - (int)input[1]);
+
+    default:
+        // Unknown operations have been reported when building the pipeline
+        return 0;
+    }
+}
+
+#ifdef RASTERIZER_SSE2
+
+/// Applies a TEV combiner operation to one channel of four pixels
+template <Regs::TevStageConfig::Operation op>
+static __m128i CombineSSE2(__m128i in0, __m128i in1, __m128i in2) {
+    using Operation = Regs::TevStageConfig::Operation;
+
+    // NOTE: All inputs are within [0, 255], so intermediate results fit into the lower 16 bits
+    //       of each lane (with the upper half being the sign extension), which allows using the
+    //       16-bit min/max instructions for clamping.
+    switch (op) {
+    case Operation::Replace:
+        return in0;
+
+    case Operation::Modulate:
+        return Div255SSE2(MultiplySSE2(in0, in1));
+
+    case Operation::Add:
+        return _mm_min_epi16(_mm_add_epi32(in0, in1), _mm_set1_epi32(255));
+
+    case Operation::Lerp:
+    {
+        __m128i inv_in2 = _mm_sub_epi32(_mm_set1_epi32(255), in2);
+        return Div255SSE2(_mm_add_epi32(MultiplySSE2(in0, in2), MultiplySSE2(in1, inv_in2)));
+    }
+
+    case Operation::Subtract:
+        return _mm_max_epi16(_mm_sub_epi32(in0, in1), _mm_setzero_si128());
+
+    default:
+        // Unknown operations have been reported when building the pipeline
+        return _mm_setzero_si128();
+    }
+}
+
+#endif // RASTERIZER_SSE2
+
+template <Regs::TevStageConfig::Operation color_op, Regs::TevStageConfig::Operation alpha_op>
+struct TevStage {
+    static void Run(const PipelineStage& stage, CombinerInputs& inputs) {
+        inputs[SOURCE_CONSTANT] = stage.constant;
+
+        // NOTE: Not sure if the alpha combiner might use the color output of the previous
+        //       stage as input. Hence, we currently don't directly write the result to
+        //       the previous stage output, but instead store it in a temporary variable until
+        //       alpha combining has been done.
+        Math::Vec3<u8> color_result[3];
+        std::array<u8,3> alpha_result;
+        for (int i = 0; i < 3; ++i) {
+            const auto& color = inputs[stage.color_sources[i]];
+            const u8 modifier_xor = stage.color_modifier_xor[i];
+            const u8 modifier_and = stage.color_modifier_and[i];
+            auto value = stage.color_modifier_alpha_to_rgb[i] ? Math::MakeVec(color.a(), color.a(), color.a())
+                                                              : color.rgb();
+            color_result[i] = Math::MakeVec<u8>((value.r() ^ modifier_xor) & modifier_and,
+                                                (value.g() ^ modifier_xor) & modifier_and,
+                                                (value.b() ^ modifier_xor) & modifier_and);
+
+            alpha_result[i] = (inputs[stage.alpha_sources[i]].a() ^ stage.alpha_modifier_xor[i]) & stage.alpha_modifier_and[i];
+        }
+
+        inputs[SOURCE_PREVIOUS] = Math::MakeVec(ColorCombine<color_op>(color_result),
+                                                AlphaCombine<alpha_op>(alpha_result));
+    }
+
+#ifdef RASTERIZER_SSE2
+    static void RunSSE2(const PipelineStage& stage, ColorSSE2 inputs[NUM_COMBINER_SOURCES]) {
+        inputs[SOURCE_CONSTANT] = { _mm_set1_epi32(stage.constant.r()), _mm_set1_epi32(stage.constant.g()),
+                                    _mm_set1_epi32(stage.constant.b()), _mm_set1_epi32(stage.constant.a()) };
+
+        __m128i color_result[3][3];
+        __m128i alpha_result[3];
+        for (int i = 0; i < 3; ++i) {
+            const auto& color = inputs[stage.color_sources[i]];
+            const __m128i modifier_xor = _mm_set1_epi32(stage.color_modifier_xor[i]);
+            const __m128i modifier_and = _mm_set1_epi32(stage.color_modifier_and[i]);
+            const bool alpha_to_rgb = stage.color_modifier_alpha_to_rgb[i];
+            color_result[0][i] = _mm_and_si128(_mm_xor_si128(alpha_to_rgb ? color.a : color.r, modifier_xor), modifier_and);
+            color_result[1][i] = _mm_and_si128(_mm_xor_si128(alpha_to_rgb ? color.a : color.g, modifier_xor), modifier_and);
+            color_result[2][i] = _mm_and_si128(_mm_xor_si128(alpha_to_rgb ? color.a : color.b, modifier_xor), modifier_and);
+
+            alpha_result[i] = _mm_and_si128(_mm_xor_si128(inputs[stage.alpha_sources[i]].a,
+                                                          _mm_set1_epi32(stage.alpha_modifier_xor[i])),
+                                            _mm_set1_epi32(stage.alpha_modifier_and[i]));
+        }
+
+        inputs[SOURCE_PREVIOUS] = {
+            CombineSSE2<color_op>(color_result[0][0], color_result[0][1], color_result[0][2]),
+            CombineSSE2<color_op>(color_result[1][0], color_result[1][1], color_result[1][2]),
+            CombineSSE2<color_op>(color_result[2][0], color_result[2][1], color_result[2][2]),
+            CombineSSE2<alpha_op>(alpha_result[0], alpha_result[1], alpha_result[2])
+        };
+    }
+#endif
+};
+
+template <Regs::TevStageConfig::Operation color_op, Regs::TevStageConfig::Operation alpha_op>
+static void SetTevStageFunctions(PipelineStage& stage) {
+    stage.run = &TevStage<color_op, alpha_op>::Run;
+#ifdef RASTERIZER_SSE2
+    stage.run_sse2 = &TevStage<color_op, alpha_op>::RunSSE2;
+#endif
+}
+
+// NOTE: AddSigned is not implemented, yet, and hence yields zero just like unknown operations.
+//       It's used as the stand-in for the latter to keep the number of instantiations down.
+template <Regs::TevStageConfig::Operation color_op>
+static void SetTevStageFunctions(PipelineStage& stage, Regs::TevStageConfig::Operation alpha_op) {
+    using Operation = Regs::TevStageConfig::Operation;
+
+    switch (alpha_op) {
+    case Operation::Replace:
+        return SetTevStageFunctions<color_op, Operation::Replace>(stage);
+
+    case Operation::Modulate:
+        return SetTevStageFunctions<color_op, Operation::Modulate>(stage);
+
+    case Operation::Add:
+        return SetTevStageFunctions<color_op, Operation::Add>(stage);
+
+    case Operation::Lerp:
+        return SetTevStageFunctions<color_op, Operation::Lerp>(stage);
+
+    case Operation::Subtract:
+        return SetTevStageFunctions<color_op, Operation::Subtract>(stage);
+
+    default:
+        LOG_ERROR(HW_GPU, "Unknown alpha combiner operation %d\n", (int)alpha_op);
+        _dbg_assert_(HW_GPU, 0);
+        return SetTevStageFunctions<color_op, Operation::AddSigned>(stage);
+    }
+}
+
+static void SetTevStageFunctions(PipelineStage& stage, Regs::TevStageConfig::Operation color_op,
+                                 Regs::TevStageConfig::Operation alpha_op) {
+    using Operation = Regs::TevStageConfig::Operation;
+
+    switch (color_op) {
+    case Operation::Replace:
+        return SetTevStageFunctions<Operation::Replace>(stage, alpha_op);
+
+    case Operation::Modulate:
+        return SetTevStageFunctions<Operation::Modulate>(stage, alpha_op);
+
+    case Operation::Add:
+        return SetTevStageFunctions<Operation::Add>(stage, alpha_op);
+
+    case Operation::Lerp:
+        return SetTevStageFunctions<Operation::Lerp>(stage, alpha_op);
+
+    case Operation::Subtract:
+        return SetTevStageFunctions<Operation::Subtract>(stage, alpha_op);
+
+    default:
+        LOG_ERROR(HW_GPU, "Unknown color combiner operation %d\n", (int)color_op);
+        _dbg_assert_(HW_GPU, 0);
+        return SetTevStageFunctions<Operation::AddSigned>(stage, alpha_op);
+    }
+}
+
+/// Builds the fragment pipeline for the current register state, which must match the given key
+static std::unique_ptr<FragmentPipeline> BuildPipeline(const PipelineKey& key) {
+    using Source = Regs::TevStageConfig::Source;
+    using ColorModifier = Regs::TevStageConfig::ColorModifier;
+    using AlphaModifier = Regs::TevStageConfig::AlphaModifier;
+
+    auto pipeline = Common::make_unique<FragmentPipeline>();
+    pipeline->key = key;
+
+    auto GetSource = [](Source source, const char* type) -> CombinerSource {
+        switch (source) {
+        case Source::PrimaryColor:
+            return SOURCE_PRIMARY_COLOR;
+
+        case Source::Texture0:
+            return SOURCE_TEXTURE0;
+
+        case Source::Texture1:
+            return SOURCE_TEXTURE1;
+
+        case Source::Texture2:
+            return SOURCE_TEXTURE2;
+
+        case Source::Constant:
+            return SOURCE_CONSTANT;
+
+        case Source::Previous:
+            return SOURCE_PREVIOUS;
+
+        default:
+            LOG_ERROR(HW_GPU, "Unknown %s combiner source %d\n", type, (int)source);
+            _dbg_assert_(HW_GPU, 0);
+            return SOURCE_ZERO;
+        }
+    };
+
+    const auto tev_stages = registers.GetTevStages();
+    for (unsigned i = 0; i < tev_stages.size(); ++i) {
+        const auto& tev_stage = tev_stages[i];
+        auto& stage = pipeline->stages[i];
+
+        const Source color_sources[3] = { tev_stage.color_source1, tev_stage.color_source2, tev_stage.color_source3 };
+        const Source alpha_sources[3] = { tev_stage.alpha_source1, tev_stage.alpha_source2, tev_stage.alpha_source3 };
+        const ColorModifier color_modifiers[3] = { tev_stage.color_modifier1, tev_stage.color_modifier2, tev_stage.color_modifier3 };
+        const AlphaModifier alpha_modifiers[3] = { tev_stage.alpha_modifier1, tev_stage.alpha_modifier2, tev_stage.alpha_modifier3 };
+
+        for (int input = 0; input < 3; ++input) {
+            stage.color_sources[input] = GetSource(color_sources[input], "color");
+            stage.alpha_sources[input] = GetSource(alpha_sources[input], "alpha");
+
+            stage.color_modifier_alpha_to_rgb[input] = false;
+            stage.color_modifier_xor[input] = 0;
+            stage.color_modifier_and[input] = 0xFF;
+            switch (color_modifiers[input]) {
+            case ColorModifier::SourceColor:
+                break;
+
+            case ColorModifier::OneMinusSourceColor:
+                stage.color_modifier_xor[input] = 0xFF;
+                break;
+
+            case ColorModifier::SourceAlpha:
+                stage.color_modifier_alpha_to_rgb[input] = true;
+                break;
+
+            default:
+                LOG_ERROR(HW_GPU, "Unknown color factor %d\n", (int)color_modifiers[input]);
+                _dbg_assert_(HW_GPU, 0);
+                stage.color_modifier_and[input] = 0;
+                break;
             }
 
-            // Texture environment - consists of 6 stages of color and alpha combining.
-            //
-            // Color combiners take three input color values from some source (e.g. interpolated
-            // vertex color, texture color, previous stage, etc), perform some very simple
-            // operations on each of them (e.g. inversion) and then calculate the output color
-            // with some basic arithmetic. Alpha combiners can be configured separately but work
-            // analogously.
-            Math::Vec4<u8> combiner_output;
-            for (const auto& tev_stage : tev_stages) {
-                using Source = Regs::TevStageConfig::Source;
-                using ColorModifier = Regs::TevStageConfig::ColorModifier;
-                using AlphaModifier = Regs::TevStageConfig::AlphaModifier;
-                using Operation = Regs::TevStageConfig::Operation;
-
-                auto GetColorSource = [&](Source source) -> Math::Vec4<u8> {
-                    switch (source) {
-                    case Source::PrimaryColor:
-                        return primary_color;
-
-                    case Source::Texture0:
-                        return texture_color[0];
-
-                    case Source::Texture1:
-                        return texture_color[1];
-
-                    case Source::Texture2:
-                        return texture_color[2];
-
-                    case Source::Constant:
-                        return {tev_stage.const_r, tev_stage.const_g, tev_stage.const_b, tev_stage.const_a};
-
-                    case Source::Previous:
-                        return combiner_output;
-
-                    default:
-                        LOG_ERROR(HW_GPU, "Unknown color combiner source %d\n", (int)source);
-                        _dbg_assert_(HW_GPU, 0);
-                        return {};
-                    }
-                };
+            stage.alpha_modifier_xor[input] = 0;
+            stage.alpha_modifier_and[input] = 0xFF;
+            switch (alpha_modifiers[input]) {
+            case AlphaModifier::SourceAlpha:
+                break;
+
+            case AlphaModifier::OneMinusSourceAlpha:
+                stage.alpha_modifier_xor[input] = 0xFF;
+                break;
+
+            default:
+                LOG_ERROR(HW_GPU, "Unknown alpha factor %d\n", (int)alpha_modifiers[input]);
+                _dbg_assert_(HW_GPU, 0);
+                stage.alpha_modifier_and[input] = 0;
+                break;
+            }
+        }
 
-                auto GetAlphaSource = [&](Source source) -> u8 {
-                    switch (source) {
-                    case Source::PrimaryColor:
-                        return primary_color.a();
+        stage.constant = Math::MakeVec<u8>(tev_stage.const_r, tev_stage.const_g, tev_stage.const_b, tev_stage.const_a);
+        SetTevStageFunctions(stage, tev_stage.color_op, tev_stage.alpha_op);
+    }
 
-                    case Source::Texture0:
-                        return texture_color[0].a();
+    const auto& output_merger = registers.output_merger;
+
+    pipeline->depth_test_enable = output_merger.depth_test_enable != 0;
+    pipeline->depth_write_enable = output_merger.depth_write_enable != 0;
+    pipeline->depth_pass_less = false;
+    pipeline->depth_pass_equal = false;
+    pipeline->depth_pass_greater = false;
+    switch (output_merger.depth_test_func) {
+    case output_merger.Always:
+        pipeline->depth_pass_less = pipeline->depth_pass_equal = pipeline->depth_pass_greater = true;
+        break;
+
+    case output_merger.LessThan:
+        pipeline->depth_pass_less = true;
+        break;
+
+    case output_merger.GreaterThan:
+        pipeline->depth_pass_greater = true;
+        break;
+
+    default:
+        // Fails for all pixels
+        if (pipeline->depth_test_enable)
+            LOG_ERROR(HW_GPU, "Unknown depth test function %x", output_merger.depth_test_func.Value());
+        break;
+    }
 
-                    case Source::Texture1:
-                        return texture_color[1].a();
+    auto params = output_merger.alpha_blending;
+    pipeline->blend_supported = output_merger.alphablend_enable && params.blend_equation_rgb == params.Add;
 
-                    case Source::Texture2:
-                        return texture_color[2].a();
+    const decltype(params)::BlendFactor factors[4] = {
+        params.factor_source_rgb, params.factor_source_a, params.factor_dest_rgb, params.factor_dest_a
+    };
+    for (int i = 0; i < 4; ++i) {
+        switch (factors[i]) {
+        case params.Zero:
+            pipeline->blend_factor_and[i] = 0;
+            pipeline->blend_factor_xor[i] = 0;
+            break;
+
+        case params.One:
+            pipeline->blend_factor_and[i] = 0;
+            pipeline->blend_factor_xor[i] = 0xFF;
+            break;
+
+        case params.SourceAlpha:
+            pipeline->blend_factor_and[i] = 0xFF;
+            pipeline->blend_factor_xor[i] = 0;
+            break;
+
+        case params.OneMinusSourceAlpha:
+            pipeline->blend_factor_and[i] = 0xFF;
+            pipeline->blend_factor_xor[i] = 0xFF;
+            break;
+
+        default:
+            pipeline->blend_supported = false;
+            break;
+        }
+    }
 
-                    case Source::Constant:
-                        return tev_stage.const_a;
+    return pipeline;
+}
 
-                    case Source::Previous:
-                        return combiner_output.a();
+/**
+ * Reports the unsupported output merger configuration of the given pipeline and terminates.
+ * This is deferred until a pixel actually reaches the output merger, since games may well issue
+ * draws which end up not touching any pixels.
+ */
+static void ReportUnsupportedOutputMerger() {
+    const auto& output_merger = registers.output_merger;
+
+    if (output_merger.alphablend_enable) {
+        auto params = output_merger.alpha_blending;
+
+        auto CheckFactor = [&](decltype(params)::BlendFactor factor, const char* type) {
+            switch(factor) {
+            case params.Zero:
+            case params.One:
+            case params.SourceAlpha:
+            case params.OneMinusSourceAlpha:
+                break;
+
+            default:
+                LOG_CRITICAL(HW_GPU, "Unknown %s blend factor %x", type, factor);
+                exit(0);
+                break;
+            }
+        };
+        CheckFactor(params.factor_source_rgb, "color");
+        CheckFactor(params.factor_source_a, "alpha");
+        CheckFactor(params.factor_dest_rgb, "color");
+        CheckFactor(params.factor_dest_a, "alpha");
+
+        LOG_CRITICAL(HW_GPU, "Unknown RGB blend equation %x", params.blend_equation_rgb.Value());
+        exit(0);
+    } else {
+        LOG_CRITICAL(HW_GPU, "logic op: %x", output_merger.logic_op);
+        exit(0);
+    }
+}
 
-                    default:
-                        LOG_ERROR(HW_GPU, "Unknown alpha combiner source %d\n", (int)source);
-                        _dbg_assert_(HW_GPU, 0);
-                        return 0;
-                    }
-                };
+// Pipelines are only looked up from the thread submitting triangles, while no tiles are being
+// shaded. Hence, the cache doesn't need any synchronization.
+static std::unordered_map<u64, std::unique_ptr<FragmentPipeline>> pipeline_cache;
 
-                static auto GetColorModifier = [](ColorModifier factor, const Math::Vec4<u8>& values) -> Math::Vec3<u8> {
-                    switch (factor)
-                    {
-                    case ColorModifier::SourceColor:
-                        return values.rgb();
+// Maximal number of pipelines to keep around before starting over with an empty cache
+static const size_t MAX_CACHED_PIPELINES = 1024;
 
-                    case ColorModifier::OneMinusSourceColor:
-                        return (Math::Vec3<u8>(255, 255, 255) - values.rgb()).Cast<u8>();
+// Pipeline for the current register state, valid until the next Flush
+static const FragmentPipeline* current_pipeline = nullptr;
 
-                    case ColorModifier::SourceAlpha:
-                        return { values.a(), values.a(), values.a() };
+/// Returns the key of the fragment pipeline for the current register state
+static PipelineKey GetPipelineKey() {
+    PipelineKey key;
+    const auto tev_stages = registers.GetTevStages();
+    for (unsigned i = 0; i < tev_stages.size(); ++i)
+        memcpy(key.tev_stages[i], &tev_stages[i], sizeof(key.tev_stages[i]));
+    memcpy(key.output_merger, &registers.output_merger, sizeof(key.output_merger));
+    return key;
+}
 
-                    default:
-                        LOG_ERROR(HW_GPU, "Unknown color factor %d\n", (int)factor);
-                        _dbg_assert_(HW_GPU, 0);
-                        return {};
-                    }
-                };
+/// Returns the fragment pipeline for the current register state, building it if necessary
+static const FragmentPipeline* GetPipeline() {
+    if (current_pipeline)
+        return current_pipeline;
 
-                static auto GetAlphaModifier = [](AlphaModifier factor, u8 value) -> u8 {
-                    switch (factor) {
-                    case AlphaModifier::SourceAlpha:
-                        return value;
+    const PipelineKey key = GetPipelineKey();
+    u64 hash = GetHash64(reinterpret_cast<const u8*>(&key), sizeof(key), 0);
 
-                    case AlphaModifier::OneMinusSourceAlpha:
-                        return 255 - value;
+    if (pipeline_cache.size() >= MAX_CACHED_PIPELINES && !pipeline_cache.count(hash))
+        pipeline_cache.clear();
 
-                    default:
-                        LOG_ERROR(HW_GPU, "Unknown alpha factor %d\n", (int)factor);
-                        _dbg_assert_(HW_GPU, 0);
-                        return 0;
-                    }
-                };
+    // On hash collisions, the previously cached pipeline just gets replaced
+    auto& pipeline = pipeline_cache[hash];
+    if (!pipeline || !(pipeline->key == key))
+        pipeline = BuildPipeline(key);
 
-                static auto ColorCombine = [](Operation op, const Math::Vec3<u8> input[3]) -> Math::Vec3<u8> {
-                    switch (op) {
-                    case Operation::Replace:
-                        return input[0];
-
-                    case Operation::Modulate:
-                        return ((input[0] * input[1]) / 255).Cast<u8>();
-
-                    case Operation::Add:
-                    {
-                        auto result = input[0] + input[1];
-                        result.r() = std::min(255, result.r());
-                        result.g() = std::min(255, result.g());
-                        result.b() = std::min(255, result.b());
-                        return result.Cast<u8>();
-                    }
+    current_pipeline = pipeline.get();
+    return current_pipeline;
+}
 
-                    case Operation::Lerp:
-                        return ((input[0] * input[2] + input[1] * (Math::MakeVec<u8>(255, 255, 255) - input[2]).Cast<u8>()) / 255).Cast<u8>();
+/**
+ * Shades a single pixel covered by the given triangle and writes the result to the framebuffer.
+ * @param x,y Pixel position in rasterizer coordinates
+ * @param w0,w1,w2 (Unnormalized) barycentric coordinates of the pixel, all of them non-negative
+ */
+static void ShadePixel(const TriangleSetup& setup, u16 x, u16 y, int w0, int w1, int w2,
+                       const std::array<Regs::FullTextureConfig, 3>& textures)
+{
+    const auto& v0 = setup.v0;
+    const auto& v1 = setup.v1;
+    const auto& v2 = setup.v2;
+    const auto& pipeline = *setup.pipeline;
 
-                    case Operation::Subtract:
-                    {
-                        auto result = input[0].Cast<int>() - input[1].Cast<int>();
-                        result.r() = std::max(0, result.r());
-                        result.g() = std::max(0, result.g());
-                        result.b() = std::max(0, result.b());
-                        return result.Cast<u8>();
-                    }
+    int wsum = w0 + w1 + w2;
 
-                    default:
-                        LOG_ERROR(HW_GPU, "Unknown color combiner operation %d\n", (int)op);
-                        _dbg_assert_(HW_GPU, 0);
-                        return {};
-                    }
-                };
+    auto w_inverse = Math::MakeVec(v0.pos.w, v1.pos.w, v2.pos.w);
 
-                static auto AlphaCombine = [](Operation op, const std::array<u8,3>& input) -> u8 {
-                    switch (op) {
-                    case Operation::Replace:
-                        return input[0];
+    auto baricentric_coordinates = Math::MakeVec(float24::FromFloat32(static_cast<float>(w0)),
+                                        float24::FromFloat32(static_cast<float>(w1)),
+                                        float24::FromFloat32(static_cast<float>(w2)));
+    float24 interpolated_w_inverse = float24::FromFloat32(1.0f) / Math::Dot(w_inverse, baricentric_coordinates);
+
+
+    // Perspective correct attribute interpolation:
+    // Attribute values cannot be calculated by simple linear interpolation since
+    // they are not linear in screen space. For example, when interpolating a
+    // texture coordinate across two vertices, something simple like
+    //     u = (u0*w0 + u1*w1)/(w0+w1)
+    // will not work. However, the attribute value divided by the
+    // clipspace w-coordinate (u/w) and and the inverse w-coordinate (1/w) are linear
+    // in screenspace. Hence, we can linearly interpolate these two independently and
+    // calculate the interpolated attribute by dividing the results.
+    // I.e.
+    //     u_over_w   = ((u0/v0.pos.w)*w0 + (u1/v1.pos.w)*w1)/(w0+w1)
+    //     one_over_w = (( 1/v0.pos.w)*w0 + ( 1/v1.pos.w)*w1)/(w0+w1)
+    //     u = u_over_w / one_over_w
+    //
+    // The generalization to three vertices is straightforward in baricentric coordinates.
+    auto GetInterpolatedAttribute = [&](float24 attr0, float24 attr1, float24 attr2) {
+        auto attr_over_w = Math::MakeVec(attr0, attr1, attr2);
+        float24 interpolated_attr_over_w = Math::Dot(attr_over_w, baricentric_coordinates);
+        return interpolated_attr_over_w * interpolated_w_inverse;
+    };
 
-                    case Operation::Modulate:
-                        return input[0] * input[1] / 255;
+    CombinerInputs combiner_inputs{};
+    combiner_inputs[SOURCE_PRIMARY_COLOR] = {
+        (u8)(GetInterpolatedAttribute(v0.color.r(), v1.color.r(), v2.color.r()).ToFloat32() * 255),
+        (u8)(GetInterpolatedAttribute(v0.color.g(), v1.color.g(), v2.color.g()).ToFloat32() * 255),
+        (u8)(GetInterpolatedAttribute(v0.color.b(), v1.color.b(), v2.color.b()).ToFloat32() * 255),
+        (u8)(GetInterpolatedAttribute(v0.color.a(), v1.color.a(), v2.color.a()).ToFloat32() * 255)
+    };
 
-                    case Operation::Add:
-                        return std::min(255, input[0] + input[1]);
+    Math::Vec2<float24> uv[3];
+    uv[0].u() = GetInterpolatedAttribute(v0.tc0.u(), v1.tc0.u(), v2.tc0.u());
+    uv[0].v() = GetInterpolatedAttribute(v0.tc0.v(), v1.tc0.v(), v2.tc0.v());
+    uv[1].u() = GetInterpolatedAttribute(v0.tc1.u(), v1.tc1.u(), v2.tc1.u());
+    uv[1].v() = GetInterpolatedAttribute(v0.tc1.v(), v1.tc1.v(), v2.tc1.v());
+    uv[2].u() = GetInterpolatedAttribute(v0.tc2.u(), v1.tc2.u(), v2.tc2.u());
+    uv[2].v() = GetInterpolatedAttribute(v0.tc2.v(), v1.tc2.v(), v2.tc2.v());
 
-                    case Operation::Lerp:
-                        return (input[0] * input[2] + input[1] * (255 - input[2])) / 255;
+    for (int i = 0; i < 3; ++i) {
+        const auto& texture = textures[i];
+        if (!setup.textures[i])
+            continue;
 
-                    case Operation::Subtract:
-                        return std::max(0, (int)input[0] - (int)input[1]);
+        _dbg_assert_(HW_GPU, 0 != texture.config.address);
 
-                    default:
-                        LOG_ERROR(HW_GPU, "Unknown alpha combiner operation %d\n", (int)op);
-                        _dbg_assert_(HW_GPU, 0);
-                        return 0;
-                    }
-                };
+        int s = (int)(uv[i].u() * float24::FromFloat32(static_cast<float>(texture.config.width))).ToFloat32();
+        int t = (int)(uv[i].v() * float24::FromFloat32(static_cast<float>(texture.config.height))).ToFloat32();
+        combiner_inputs[SOURCE_TEXTURE0 + i] = SampleTexture(texture, *setup.textures[i], s, t);
+    }
 
-                // color combiner
-                // NOTE: Not sure if the alpha combiner might use the color output of the previous
-                //       stage as input. Hence, we currently don't directly write the result to
-                //       combiner_output.rgb(), but instead store it in a temporary variable until
-                //       alpha combining has been done.
-                Math::Vec3<u8> color_result[3] = {
-                    GetColorModifier(tev_stage.color_modifier1, GetColorSource(tev_stage.color_source1)),
-                    GetColorModifier(tev_stage.color_modifier2, GetColorSource(tev_stage.color_source2)),
-                    GetColorModifier(tev_stage.color_modifier3, GetColorSource(tev_stage.color_source3))
-                };
-                auto color_output = ColorCombine(tev_stage.color_op, color_result);
+    // Texture environment - consists of 6 stages of color and alpha combining.
+    //
+    // Color combiners take three input color values from some source (e.g. interpolated
+    // vertex color, texture color, previous stage, etc), perform some very simple
+    // operations on each of them (e.g. inversion) and then calculate the output color
+    // with some basic arithmetic. Alpha combiners can be configured separately but work
+    // analogously.
+    for (const auto& stage : pipeline.stages)
+        stage.run(stage, combiner_inputs);
+
+    Math::Vec4<u8> combiner_output = combiner_inputs[SOURCE_PREVIOUS];
+
+    // TODO: Does depth indeed only get written even if depth testing is enabled?
+    if (pipeline.depth_test_enable) {
+        u16 z = (u16)(-(v0.screenpos[2].ToFloat32() * w0 +
+                    v1.screenpos[2].ToFloat32() * w1 +
+                    v2.screenpos[2].ToFloat32() * w2) * 65535.f / wsum);
+        u16 ref_z = GetDepth(x >> 4, y >> 4);
+
+        bool pass = (z < ref_z) ? pipeline.depth_pass_less
+                  : (z > ref_z) ? pipeline.depth_pass_greater
+                  : pipeline.depth_pass_equal;
+        if (!pass)
+            return;
 
-                // alpha combiner
-                std::array<u8,3> alpha_result = {
-                    GetAlphaModifier(tev_stage.alpha_modifier1, GetAlphaSource(tev_stage.alpha_source1)),
-                    GetAlphaModifier(tev_stage.alpha_modifier2, GetAlphaSource(tev_stage.alpha_source2)),
-                    GetAlphaModifier(tev_stage.alpha_modifier3, GetAlphaSource(tev_stage.alpha_source3))
-                };
-                auto alpha_output = AlphaCombine(tev_stage.alpha_op, alpha_result);
+        if (pipeline.depth_write_enable)
+            SetDepth(x >> 4, y >> 4, z);
+    }
+
+    if (!pipeline.blend_supported)
+        ReportUnsupportedOutputMerger();
+
+    auto dest = GetPixel(x >> 4, y >> 4);
+
+    auto GetBlendFactor = [&](int index) -> u8 {
+        return (combiner_output.a() & pipeline.blend_factor_and[index]) ^ pipeline.blend_factor_xor[index];
+    };
+    u8 srcfactor_rgb = GetBlendFactor(0);
+    u8 dstfactor_rgb = GetBlendFactor(2);
+    auto srcfactor = Math::MakeVec(srcfactor_rgb, srcfactor_rgb, srcfactor_rgb, GetBlendFactor(1));
+    auto dstfactor = Math::MakeVec(dstfactor_rgb, dstfactor_rgb, dstfactor_rgb, GetBlendFactor(3));
+
+    auto result = (combiner_output * srcfactor + dest * dstfactor) / 255;
+    result.r() = std::min(255, result.r());
+    result.g() = std::min(255, result.g());
+    result.b() = std::min(255, result.b());
+    combiner_output = result.Cast<u8>();
+
+    DrawPixel(x >> 4, y >> 4, combiner_output);
+}
+
+#ifdef RASTERIZER_SSE2
+
+/**
+ * Shades up to four horizontally adjacent pixels covered by the given triangle at once, yielding
+ * exactly the same results as calling ShadePixel for each of them. Texture lookups, depth testing
+ * and framebuffer accesses are still done per pixel, while attribute interpolation, texture
+ * combining and blending are done on all pixels in parallel.
+ * @param x,y Position of the leftmost pixel in rasterizer coordinates
+ * @param w0,w1,w2 (Unnormalized) barycentric coordinates of the four pixels
+ * @param mask Bit i is set if the i-th pixel of the span is covered by the triangle
+ */
+static void ShadeSpanSSE2(const TriangleSetup& setup, unsigned x, unsigned y, int mask,
+                          __m128i w0, __m128i w1, __m128i w2,
+                          const std::array<Regs::FullTextureConfig, 3>& textures)
+{
+    const auto& v0 = setup.v0;
+    const auto& v1 = setup.v1;
+    const auto& v2 = setup.v2;
+    const auto& pipeline = *setup.pipeline;
+
+    const __m128 bary0 = _mm_cvtepi32_ps(w0);
+    const __m128 bary1 = _mm_cvtepi32_ps(w1);
+    const __m128 bary2 = _mm_cvtepi32_ps(w2);
+
+    // Same operation order as Math::Dot, so that the results match the scalar path bit by bit
+    auto Dot = [&](float24 attr0, float24 attr1, float24 attr2) {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(attr0.ToFloat32()), bary0),
+                                     _mm_mul_ps(_mm_set1_ps(attr1.ToFloat32()), bary1)),
+                          _mm_mul_ps(_mm_set1_ps(attr2.ToFloat32()), bary2));
+    };
+
+    // See ShadePixel for details on perspective correct interpolation
+    const __m128 interpolated_w_inverse = _mm_div_ps(_mm_set1_ps(1.0f), Dot(v0.pos.w, v1.pos.w, v2.pos.w));
+    auto GetInterpolatedAttribute = [&](float24 attr0, float24 attr1, float24 attr2) {
+        return _mm_mul_ps(Dot(attr0, attr1, attr2), interpolated_w_inverse);
+    };
+
+    const __m128i zero = _mm_setzero_si128();
+    ColorSSE2 combiner_inputs[NUM_COMBINER_SOURCES];
+    for (auto& input : combiner_inputs)
+        input = { zero, zero, zero, zero };
+
+    combiner_inputs[SOURCE_PRIMARY_COLOR] = {
+        ColorToU8SSE2(GetInterpolatedAttribute(v0.color.r(), v1.color.r(), v2.color.r())),
+        ColorToU8SSE2(GetInterpolatedAttribute(v0.color.g(), v1.color.g(), v2.color.g())),
+        ColorToU8SSE2(GetInterpolatedAttribute(v0.color.b(), v1.color.b(), v2.color.b())),
+        ColorToU8SSE2(GetInterpolatedAttribute(v0.color.a(), v1.color.a(), v2.color.a()))
+    };
+
+    const Math::Vec2<float24>* tc[3][3] = {
+        { &v0.tc0, &v1.tc0, &v2.tc0 },
+        { &v0.tc1, &v1.tc1, &v2.tc1 },
+        { &v0.tc2, &v1.tc2, &v2.tc2 },
+    };
 
-                combiner_output = Math::MakeVec(color_output, alpha_output);
+    for (int i = 0; i < 3; ++i) {
+        const auto& texture = textures[i];
+        if (!setup.textures[i])
+            continue;
+
+        _dbg_assert_(HW_GPU, 0 != texture.config.address);
+
+        __m128 u = GetInterpolatedAttribute(tc[i][0]->u(), tc[i][1]->u(), tc[i][2]->u());
+        __m128 v = GetInterpolatedAttribute(tc[i][0]->v(), tc[i][1]->v(), tc[i][2]->v());
+
+        alignas(16) s32 s[4];
+        alignas(16) s32 t[4];
+        _mm_store_si128((__m128i*)s, _mm_cvttps_epi32(_mm_mul_ps(u, _mm_set1_ps(static_cast<float>(texture.config.width)))));
+        _mm_store_si128((__m128i*)t, _mm_cvttps_epi32(_mm_mul_ps(v, _mm_set1_ps(static_cast<float>(texture.config.height)))));
+
+        // SSE2 lacks gather instructions, so texels are fetched one by one
+        alignas(16) s32 texel[4][4] = {};
+        for (int pixel = 0; pixel < 4; ++pixel) {
+            if (!(mask & (1 << pixel)))
+                continue;
+
+            const auto& color = SampleTexture(texture, *setup.textures[i], s[pixel], t[pixel]);
+            for (int channel = 0; channel < 4; ++channel)
+                texel[channel][pixel] = color[channel];
+        }
+        combiner_inputs[SOURCE_TEXTURE0 + i] = {
+            _mm_load_si128((__m128i*)texel[0]), _mm_load_si128((__m128i*)texel[1]),
+            _mm_load_si128((__m128i*)texel[2]), _mm_load_si128((__m128i*)texel[3])
+        };
+    }
+
+    // Texture environment, see ShadePixel for details
+    for (const auto& stage : pipeline.stages)
+        stage.run_sse2(stage, combiner_inputs);
+
+    ColorSSE2 combiner_output = combiner_inputs[SOURCE_PREVIOUS];
+
+    if (pipeline.depth_test_enable) {
+        __m128 wsum = _mm_cvtepi32_ps(_mm_add_epi32(_mm_add_epi32(w0, w1), w2));
+        __m128 depth = Dot(v0.screenpos[2], v1.screenpos[2], v2.screenpos[2]);
+        depth = _mm_xor_ps(depth, _mm_set1_ps(-0.f)); // flip the sign bit
+        depth = _mm_div_ps(_mm_mul_ps(depth, _mm_set1_ps(65535.f)), wsum);
+
+        alignas(16) s32 z[4];
+        _mm_store_si128((__m128i*)z, _mm_cvttps_epi32(depth));
+
+        for (int pixel = 0; pixel < 4; ++pixel) {
+            if (!(mask & (1 << pixel)))
+                continue;
+
+            unsigned pixel_x = (x >> 4) + pixel;
+            u16 pixel_z = (u16)z[pixel];
+            u16 ref_z = GetDepth(pixel_x, y >> 4);
+
+            bool pass = (pixel_z < ref_z) ? pipeline.depth_pass_less
+                      : (pixel_z > ref_z) ? pipeline.depth_pass_greater
+                      : pipeline.depth_pass_equal;
+            if (!pass) {
+                mask &= ~(1 << pixel);
+                continue;
             }
 
-            // TODO: Does depth indeed only get written even if depth testing is enabled?
-            if (registers.output_merger.depth_test_enable) {
-                u16 z = (u16)(-(v0.screenpos[2].ToFloat32() * w0 +
-                            v1.screenpos[2].ToFloat32() * w1 +
-                            v2.screenpos[2].ToFloat32() * w2) * 65535.f / wsum);
-                u16 ref_z = GetDepth(x >> 4, y >> 4);
+            if (pipeline.depth_write_enable)
+                SetDepth(pixel_x, y >> 4, pixel_z);
+        }
 
-                bool pass = false;
+        if (!mask)
+            return;
+    }
 
-                switch (registers.output_merger.depth_test_func) {
-                case registers.output_merger.Always:
-                    pass = true;
-                    break;
+    if (!pipeline.blend_supported)
+        ReportUnsupportedOutputMerger();
 
-                case registers.output_merger.LessThan:
-                    pass = z < ref_z;
-                    break;
+    alignas(16) s32 dest[4][4] = {};
+    for (int pixel = 0; pixel < 4; ++pixel) {
+        if (!(mask & (1 << pixel)))
+            continue;
 
-                case registers.output_merger.GreaterThan:
-                    pass = z > ref_z;
-                    break;
+        auto color = GetPixel((x >> 4) + pixel, y >> 4);
+        for (int channel = 0; channel < 4; ++channel)
+            dest[channel][pixel] = color[channel];
+    }
 
-                default:
-                    LOG_ERROR(HW_GPU, "Unknown depth test function %x", registers.output_merger.depth_test_func.Value());
-                    break;
-                }
+    auto GetBlendFactor = [&](int index) {
+        return _mm_xor_si128(_mm_and_si128(combiner_output.a, _mm_set1_epi32(pipeline.blend_factor_and[index])),
+                             _mm_set1_epi32(pipeline.blend_factor_xor[index]));
+    };
+    const __m128i srcfactor_rgb = GetBlendFactor(0);
+    const __m128i srcfactor_a = GetBlendFactor(1);
+    const __m128i dstfactor_rgb = GetBlendFactor(2);
+    const __m128i dstfactor_a = GetBlendFactor(3);
+
+    // The weighted sums may exceed the range in which Div255SSE2 is exact, so the division is
+    // done in floating point instead, which is exact for these magnitudes.
+    auto Blend = [](__m128i src, __m128i dst, __m128i srcfactor, __m128i dstfactor) {
+        __m128i sum = _mm_add_epi32(MultiplySSE2(src, srcfactor), MultiplySSE2(dst, dstfactor));
+        return _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(sum), _mm_set1_ps(255.f)));
+    };
+    const __m128i max = _mm_set1_epi32(255);
+    combiner_output = {
+        _mm_min_epi16(Blend(combiner_output.r, _mm_load_si128((__m128i*)dest[0]), srcfactor_rgb, dstfactor_rgb), max),
+        _mm_min_epi16(Blend(combiner_output.g, _mm_load_si128((__m128i*)dest[1]), srcfactor_rgb, dstfactor_rgb), max),
+        _mm_min_epi16(Blend(combiner_output.b, _mm_load_si128((__m128i*)dest[2]), srcfactor_rgb, dstfactor_rgb), max),
+        Blend(combiner_output.a, _mm_load_si128((__m128i*)dest[3]), srcfactor_a, dstfactor_a)
+    };
 
-                if (!pass)
-                    continue;
+    alignas(16) s32 output[4][4];
+    _mm_store_si128((__m128i*)output[0], combiner_output.r);
+    _mm_store_si128((__m128i*)output[1], combiner_output.g);
+    _mm_store_si128((__m128i*)output[2], combiner_output.b);
+    _mm_store_si128((__m128i*)output[3], combiner_output.a);
+
+    for (int pixel = 0; pixel < 4; ++pixel) {
+        if (!(mask & (1 << pixel)))
+            continue;
+
+        DrawPixel((x >> 4) + pixel, y >> 4, { (u8)output[0][pixel], (u8)output[1][pixel],
+                                              (u8)output[2][pixel], (u8)output[3][pixel] });
+    }
+}
+
+/**
+ * Shades a span using ShadeSpanSSE2, then shades the same pixels again using ShadePixel and
+ * reports any pixels for which the two paths disagree. The framebuffer ends up holding the
+ * results of ShadePixel. Parameters are the same as for ShadeSpanSSE2.
+ */
+static void ShadeSpanSSE2Verified(const TriangleSetup& setup, unsigned x, unsigned y, int mask,
+                                  __m128i w0, __m128i w1, __m128i w2,
+                                  const std::array<Regs::FullTextureConfig, 3>& textures)
+{
+    const auto& pipeline = *setup.pipeline;
+    const bool check_depth = pipeline.depth_test_enable && pipeline.depth_write_enable;
+
+    // Both paths blend with and depth test against the framebuffer contents, so those need to be
+    // restored before shading the span a second time
+    Math::Vec4<u8> old_color[4];
+    u16 old_depth[4] = {};
+    for (int pixel = 0; pixel < 4; ++pixel) {
+        if (!(mask & (1 << pixel)))
+            continue;
+
+        old_color[pixel] = GetPixel((x >> 4) + pixel, y >> 4);
+        if (check_depth)
+            old_depth[pixel] = GetDepth((x >> 4) + pixel, y >> 4);
+    }
+
+    ShadeSpanSSE2(setup, x, y, mask, w0, w1, w2, textures);
+
+    Math::Vec4<u8> sse2_color[4];
+    u16 sse2_depth[4] = {};
+    for (int pixel = 0; pixel < 4; ++pixel) {
+        if (!(mask & (1 << pixel)))
+            continue;
+
+        sse2_color[pixel] = GetPixel((x >> 4) + pixel, y >> 4);
+        DrawPixel((x >> 4) + pixel, y >> 4, old_color[pixel]);
+        if (check_depth) {
+            sse2_depth[pixel] = GetDepth((x >> 4) + pixel, y >> 4);
+            SetDepth((x >> 4) + pixel, y >> 4, old_depth[pixel]);
+        }
+    }
+
+    alignas(16) s32 w[3][4];
+    _mm_store_si128((__m128i*)w[0], w0);
+    _mm_store_si128((__m128i*)w[1], w1);
+    _mm_store_si128((__m128i*)w[2], w2);
+
+    for (int pixel = 0; pixel < 4; ++pixel) {
+        if (!(mask & (1 << pixel)))
+            continue;
+
+        unsigned pixel_x = (x >> 4) + pixel;
+        ShadePixel(setup, x + pixel * 0x10, y, w[0][pixel], w[1][pixel], w[2][pixel], textures);
+
+        auto color = GetPixel(pixel_x, y >> 4);
+        const auto& sse2 = sse2_color[pixel];
+        if (color.r() != sse2.r() || color.g() != sse2.g() || color.b() != sse2.b() || color.a() != sse2.a()) {
+            LOG_ERROR(Render_Software, "SSE2 span shading wrote color (%u, %u, %u, %u) at (%u, %u), "
+                      "but ShadePixel wrote (%u, %u, %u, %u)",
+                      sse2.r(), sse2.g(), sse2.b(), sse2.a(),
+                      pixel_x, y >> 4, color.r(), color.g(), color.b(), color.a());
+        }
 
-                if (registers.output_merger.depth_write_enable)
-                    SetDepth(x >> 4, y >> 4, z);
+        if (check_depth) {
+            u16 depth = GetDepth(pixel_x, y >> 4);
+            if (depth != sse2_depth[pixel]) {
+                LOG_ERROR(Render_Software, "SSE2 span shading wrote depth %u at (%u, %u), "
+                          "but ShadePixel wrote %u", sse2_depth[pixel], pixel_x, y >> 4, depth);
             }
+        }
+    }
+}
 
-            auto dest = GetPixel(x >> 4, y >> 4);
+/**
+ * Shades a row of fixed spans with ShadeSpanSSE2 and with ShadePixel, for a set of pipelines
+ * covering each implemented TEV operation, all supported blend factors and the depth test, and
+ * compares the results. The spans are rendered to a scratch framebuffer at the start of VRAM,
+ * which is restored afterwards, as are the GPU registers. Texturing is not covered, since both
+ * paths fetch texels one pixel at a time anyway.
+ * @return Whether both paths wrote the same color and depth values to all pixels
+ */
+static bool CheckSpanShadingSSE2() {
+    using Source = Regs::TevStageConfig::Source;
+    using ColorModifier = Regs::TevStageConfig::ColorModifier;
+    using Operation = Regs::TevStageConfig::Operation;
+    auto& output_merger = registers.output_merger;
+    using DepthFunc = decltype(registers.output_merger)::DepthFunc;
+    using BlendFactor = decltype(registers.output_merger.alpha_blending)::BlendFactor;
+
+    const unsigned width = 16;
+    const PAddr color_address = Memory::VRAM_PADDR;
+    const PAddr depth_address = color_address + width * 4;
+
+    u8* scratch = Memory::GetPointer(PAddrToVAddr(color_address));
+    if (!scratch)
+        return true;
+
+    const std::vector<u8> saved_memory(scratch, scratch + width * 6);
+    std::vector<u32> saved_registers(Regs::NumIds());
+    for (unsigned id = 0; id < Regs::NumIds(); ++id)
+        saved_registers[id] = registers[id];
+
+    registers.framebuffer.color_buffer_address = color_address / 8;
+    registers.framebuffer.depth_buffer_address = depth_address / 8;
+    registers.framebuffer.width = width;
+    registers.framebuffer.height = 0;
+
+    // Stages after the first one pass on its result unchanged
+    for (auto* stage : { &registers.tev_stage0, &registers.tev_stage1, &registers.tev_stage2,
+                         &registers.tev_stage3, &registers.tev_stage4, &registers.tev_stage5 }) {
+        for (unsigned word = 0; word < sizeof(*stage) / sizeof(u32); ++word)
+            reinterpret_cast<u32*>(stage)[word] = 0;
+        stage->color_source1 = Source::Previous;
+        stage->alpha_source1 = Source::Previous;
+    }
 
-            if (registers.output_merger.alphablend_enable) {
-                auto params = registers.output_merger.alpha_blending;
+    struct Configuration {
+        Operation color_op;
+        Operation alpha_op;
+        ColorModifier color_modifier2;
+        BlendFactor src_rgb, src_a, dst_rgb, dst_a;
+        bool depth_test;
+        DepthFunc depth_func;
+    };
+    const Configuration configurations[] = {
+        { Operation::Replace, Operation::Replace, ColorModifier::SourceColor,
+          BlendFactor::One, BlendFactor::One, BlendFactor::Zero, BlendFactor::Zero, false, DepthFunc::Always },
+        { Operation::Modulate, Operation::Modulate, ColorModifier::SourceColor,
+          BlendFactor::SourceAlpha, BlendFactor::SourceAlpha, BlendFactor::OneMinusSourceAlpha,
+          BlendFactor::OneMinusSourceAlpha, true, DepthFunc::LessThan },
+        { Operation::Add, Operation::Subtract, ColorModifier::OneMinusSourceColor,
+          BlendFactor::One, BlendFactor::One, BlendFactor::One, BlendFactor::One, true, DepthFunc::GreaterThan },
+        { Operation::Lerp, Operation::Add, ColorModifier::SourceAlpha,
+          BlendFactor::OneMinusSourceAlpha, BlendFactor::Zero, BlendFactor::SourceAlpha, BlendFactor::One,
+          true, DepthFunc::Always },
+        { Operation::Subtract, Operation::Lerp, ColorModifier::SourceColor,
+          BlendFactor::SourceAlpha, BlendFactor::One, BlendFactor::One, BlendFactor::Zero, false, DepthFunc::Always },
+    };
 
-                auto LookupFactorRGB = [&](decltype(params)::BlendFactor factor) -> Math::Vec3<u8> {
-                    switch(factor) {
-                    case params.Zero:
-                        return Math::Vec3<u8>(0, 0, 0);
+    TriangleSetup setup = {};
+    const float positions_w[3] = { 1.0f, 0.5f, 2.0f };
+    const float colors[3][4] = { { 1.0f, 0.0f, 0.5f, 1.0f }, { 0.0f, 1.0f, 0.25f, 0.5f }, { 0.2f, 0.4f, 1.0f, 0.25f } };
+    const float depths[3] = { -0.25f, -0.5f, -0.75f };
+    VertexShader::OutputVertex* vertices[3] = { &setup.v0, &setup.v1, &setup.v2 };
+    for (int i = 0; i < 3; ++i) {
+        vertices[i]->pos.w = float24::FromFloat32(positions_w[i]);
+        for (int channel = 0; channel < 4; ++channel)
+            vertices[i]->color[channel] = float24::FromFloat32(colors[i][channel]);
+        vertices[i]->screenpos[2] = float24::FromFloat32(depths[i]);
+    }
+    setup.textures = {};
+    const auto textures = registers.GetTextures();
+
+    // Barycentric coordinates of each pixel in the row
+    int w[3][width];
+    for (unsigned pixel = 0; pixel < width; ++pixel) {
+        w[0][pixel] = 3000 - 180 * pixel;
+        w[1][pixel] = 500 + 150 * pixel;
+        w[2][pixel] = 1000 + 31 * pixel;
+    }
 
-                    case params.One:
-                        return Math::Vec3<u8>(255, 255, 255);
+    auto ResetFramebuffer = [&]() {
+        for (unsigned pixel = 0; pixel < width; ++pixel) {
+            DrawPixel(pixel, 0, Math::MakeVec<u8>(pixel * 16, 255 - pixel * 13, pixel * 7 + 3, pixel * 17));
+            SetDepth(pixel, 0, 0x4000 + pixel * 0x800);
+        }
+    };
 
-                    case params.SourceAlpha:
-                        return Math::MakeVec(combiner_output.a(), combiner_output.a(), combiner_output.a());
+    bool match = true;
+    for (const auto& configuration : configurations) {
+        auto& stage = registers.tev_stage0;
+        stage.color_source1 = Source::PrimaryColor;
+        stage.color_source2 = Source::Constant;
+        stage.color_source3 = Source::PrimaryColor;
+        stage.alpha_source1 = Source::PrimaryColor;
+        stage.alpha_source2 = Source::Constant;
+        stage.alpha_source3 = Source::PrimaryColor;
+        stage.color_modifier2 = configuration.color_modifier2;
+        stage.color_op = configuration.color_op;
+        stage.alpha_op = configuration.alpha_op;
+        stage.const_r = 0x40;
+        stage.const_g = 0xC0;
+        stage.const_b = 0x80;
+        stage.const_a = 0x60;
+
+        output_merger.alphablend_enable = 1;
+        output_merger.alpha_blending.factor_source_rgb = configuration.src_rgb;
+        output_merger.alpha_blending.factor_source_a = configuration.src_a;
+        output_merger.alpha_blending.factor_dest_rgb = configuration.dst_rgb;
+        output_merger.alpha_blending.factor_dest_a = configuration.dst_a;
+        output_merger.depth_test_enable = configuration.depth_test;
+        output_merger.depth_test_func = configuration.depth_func;
+        output_merger.depth_write_enable = 1;
+
+        const auto pipeline = BuildPipeline(GetPipelineKey());
+        setup.pipeline = pipeline.get();
+
+        ResetFramebuffer();
+        for (unsigned x = 0; x < width; x += 4) {
+            ShadeSpanSSE2(setup, x * 0x10, 0, 0xF,
+                          _mm_set_epi32(w[0][x + 3], w[0][x + 2], w[0][x + 1], w[0][x]),
+                          _mm_set_epi32(w[1][x + 3], w[1][x + 2], w[1][x + 1], w[1][x]),
+                          _mm_set_epi32(w[2][x + 3], w[2][x + 2], w[2][x + 1], w[2][x]),
+                          textures);
+        }
 
-                    case params.OneMinusSourceAlpha:
-                        return Math::Vec3<u8>(255-combiner_output.a(), 255-combiner_output.a(), 255-combiner_output.a());
+        Math::Vec4<u8> sse2_color[width];
+        u32 sse2_depth[width];
+        for (unsigned pixel = 0; pixel < width; ++pixel) {
+            sse2_color[pixel] = GetPixel(pixel, 0);
+            sse2_depth[pixel] = GetDepth(pixel, 0);
+        }
 
-                    default:
-                        LOG_CRITICAL(HW_GPU, "Unknown color blend factor %x", factor);
-                        exit(0);
-                        break;
-                    }
-                };
+        ResetFramebuffer();
+        for (unsigned pixel = 0; pixel < width; ++pixel)
+            ShadePixel(setup, pixel * 0x10, 0, w[0][pixel], w[1][pixel], w[2][pixel], textures);
+
+        for (unsigned pixel = 0; pixel < width; ++pixel) {
+            auto color = GetPixel(pixel, 0);
+            const auto& sse2 = sse2_color[pixel];
+            if (color.r() != sse2.r() || color.g() != sse2.g() || color.b() != sse2.b() || color.a() != sse2.a() ||
+                GetDepth(pixel, 0) != sse2_depth[pixel]) {
+                LOG_ERROR(Render_Software, "Pipeline %d, pixel %u: SSE2 span shading wrote color "
+                          "(%u, %u, %u, %u) and depth %u, but ShadePixel wrote (%u, %u, %u, %u) and %u",
+                          (int)(&configuration - configurations), pixel,
+                          sse2.r(), sse2.g(), sse2.b(), sse2.a(), sse2_depth[pixel],
+                          color.r(), color.g(), color.b(), color.a(), GetDepth(pixel, 0));
+                match = false;
+            }
+        }
+    }
 
-                auto LookupFactorA = [&](decltype(params)::BlendFactor factor) -> u8 {
-                    switch(factor) {
-                    case params.Zero:
-                        return 0;
+    for (unsigned id = 0; id < Regs::NumIds(); ++id)
+        registers[id] = saved_registers[id];
+    std::copy(saved_memory.begin(), saved_memory.end(), scratch);
 
-                    case params.One:
-                        return 255;
+    return match;
+}
 
-                    case params.SourceAlpha:
-                        return combiner_output.a();
+#endif // RASTERIZER_SSE2
 
-                    case params.OneMinusSourceAlpha:
-                        return 255 - combiner_output.a();
+// Size of the pixel blocks used for coverage tests, in pixels along each axis
+static const unsigned BLOCK_SIZE = 8;
 
-                    default:
-                        LOG_CRITICAL(HW_GPU, "Unknown alpha blend factor %x", factor);
-                        exit(0);
-                        break;
-                    }
+/**
+ * Shades all pixels covered by the given triangle within the given region.
+ * @param region_min_x,region_min_y Inclusive lower bound of the region in rasterizer coordinates
+ * @param region_max_x,region_max_y Exclusive upper bound of the region in rasterizer coordinates
+ */
+static void RasterizeTriangle(const TriangleSetup& setup,
+                              unsigned region_min_x, unsigned region_min_y,
+                              unsigned region_max_x, unsigned region_max_y)
+{
+    // Restrict the bounding box to the given region. The pixel grid is the same for all regions,
+    // so every pixel is shaded exactly as if the whole triangle was rasterized at once.
+    unsigned min_x = std::max<unsigned>(setup.min_x, region_min_x);
+    unsigned min_y = std::max<unsigned>(setup.min_y, region_min_y);
+    unsigned max_x = std::min<unsigned>(setup.max_x, region_max_x);
+    unsigned max_y = std::min<unsigned>(setup.max_y, region_max_y);
+
+    auto textures = registers.GetTextures();
+
+    const auto& edges = setup.edges;
+
+#ifdef RASTERIZER_SSE2
+    // Offsets of the edge function values of each pixel in a span relative to the leftmost one
+    __m128i span_steps[3];
+    for (int i = 0; i < 3; ++i)
+        span_steps[i] = _mm_set_epi32(3 * edges[i].step_x, 2 * edges[i].step_x, edges[i].step_x, 0);
+#endif
+
+    // Walk the bounding box in blocks of BLOCK_SIZE x BLOCK_SIZE pixels. Since the edge functions
+    // are linear, evaluating them at the corner pixels of a block yields their extrema over the
+    // whole block. Hence, blocks which are fully outside of any edge can be skipped entirely,
+    // while blocks which are fully inside of all edges don't need any per-pixel coverage tests.
+    const unsigned block_step = BLOCK_SIZE * 0x10;
+    for (unsigned block_y = min_y; block_y < max_y; block_y += block_step) {
+        const unsigned last_y = std::min(block_y + block_step, max_y) - 0x10;
+
+        for (unsigned block_x = min_x; block_x < max_x; block_x += block_step) {
+            const unsigned last_x = std::min(block_x + block_step, max_x) - 0x10;
+
+            bool outside = false;
+            bool inside = true;
+            for (const auto& edge : edges) {
+                int corners[4] = {
+                    edge.Evaluate(block_x, block_y), edge.Evaluate(last_x, block_y),
+                    edge.Evaluate(block_x, last_y), edge.Evaluate(last_x, last_y)
                 };
+                outside |= std::max({ corners[0], corners[1], corners[2], corners[3] }) < 0;
+                inside &= std::min({ corners[0], corners[1], corners[2], corners[3] }) >= 0;
+            }
+
+            if (outside)
+                continue;
+
+            // Edge function values at the first pixel of the current row
+            int row_w0 = edges[0].Evaluate(block_x, block_y);
+            int row_w1 = edges[1].Evaluate(block_x, block_y);
+            int row_w2 = edges[2].Evaluate(block_x, block_y);
+
+            for (unsigned y = block_y; y <= last_y; y += 0x10) {
+                int w0 = row_w0;
+                int w1 = row_w1;
+                int w2 = row_w2;
+
+#ifdef RASTERIZER_SSE2
+                if (use_sse2) {
+                    for (unsigned x = block_x; x <= last_x; x += 4 * 0x10) {
+                        __m128i span_w0 = _mm_add_epi32(_mm_set1_epi32(w0), span_steps[0]);
+                        __m128i span_w1 = _mm_add_epi32(_mm_set1_epi32(w1), span_steps[1]);
+                        __m128i span_w2 = _mm_add_epi32(_mm_set1_epi32(w2), span_steps[2]);
+
+                        // Skip pixels beyond the end of the block and those which are not
+                        // covered by the current primitive (i.e. have any negative edge value)
+                        int mask = (1 << std::min(4u, (last_x - x) / 0x10 + 1)) - 1;
+                        if (!inside) {
+                            __m128i any_negative = _mm_or_si128(_mm_or_si128(span_w0, span_w1), span_w2);
+                            mask &= ~_mm_movemask_ps(_mm_castsi128_ps(any_negative));
+                        }
+
+                        if (mask && Settings::values.rasterizer_sse2_verify)
+                            ShadeSpanSSE2Verified(setup, x, y, mask, span_w0, span_w1, span_w2, textures);
+                        else if (mask)
+                            ShadeSpanSSE2(setup, x, y, mask, span_w0, span_w1, span_w2, textures);
+
+                        w0 += 4 * edges[0].step_x;
+                        w1 += 4 * edges[1].step_x;
+                        w2 += 4 * edges[2].step_x;
+                    }
 
-                auto srcfactor = Math::MakeVec(LookupFactorRGB(params.factor_source_rgb),
-                                               LookupFactorA(params.factor_source_a));
-                auto dstfactor = Math::MakeVec(LookupFactorRGB(params.factor_dest_rgb),
-                                               LookupFactorA(params.factor_dest_a));
-
-                switch (params.blend_equation_rgb) {
-                case params.Add:
-                {
-                    auto result = (combiner_output * srcfactor + dest * dstfactor) / 255;
-                    result.r() = std::min(255, result.r());
-                    result.g() = std::min(255, result.g());
-                    result.b() = std::min(255, result.b());
-                    combiner_output = result.Cast<u8>();
-                    break;
+                    row_w0 += edges[0].step_y;
+                    row_w1 += edges[1].step_y;
+                    row_w2 += edges[2].step_y;
+                    continue;
                 }
+#endif
+
+                for (unsigned x = block_x; x <= last_x; x += 0x10) {
+                    // Skip pixels which are not covered by the current primitive
+                    if (inside || (w0 >= 0 && w1 >= 0 && w2 >= 0))
+                        ShadePixel(setup, x, y, w0, w1, w2, textures);
 
-                default:
-                    LOG_CRITICAL(HW_GPU, "Unknown RGB blend equation %x", params.blend_equation_rgb.Value());
-                    exit(0);
+                    w0 += edges[0].step_x;
+                    w1 += edges[1].step_x;
+                    w2 += edges[2].step_x;
                 }
-            } else {
-                LOG_CRITICAL(HW_GPU, "logic op: %x", registers.output_merger.logic_op);
-                exit(0);
+
+                row_w0 += edges[0].step_y;
+                row_w1 += edges[1].step_y;
+                row_w2 += edges[2].step_y;
             }
+        }
+    }
+}
+
+// Screen tiles are square and measured in pixels. The tile grid covers the whole range of
+// rasterizer coordinates (12 integer bits), so no triangle can ever end up outside of it.
+static const unsigned TILE_SIZE = 64;
+static const unsigned NUM_TILES_X = 4096 / TILE_SIZE;
+static const unsigned NUM_TILES_Y = 4096 / TILE_SIZE;
+
+// Maximal number of triangles to queue before forcing a flush
+static const size_t MAX_QUEUED_TRIANGLES = 8192;
+
+static std::unique_ptr<Common::ThreadPool> thread_pool;
+
+// Triangles queued since the last flush, in submission order
+static std::vector<TriangleSetup> queued_triangles;
+
+// Indices into queued_triangles for each screen tile, in submission order
+static std::array<std::vector<u32>, NUM_TILES_X * NUM_TILES_Y> tile_bins;
+
+// List of screen tiles which have at least one triangle queued
+static std::vector<u32> active_tiles;
+
+// Decoded textures for the current register state, valid until the next Flush
+static std::array<const TextureCache::CachedTexture*, 3> current_textures;
+static bool current_textures_valid = false;
 
-            DrawPixel(x >> 4, y >> 4, combiner_output);
+// Whether any triangles have been processed since the last Flush
+static bool framebuffer_written = false;
+
+/// Returns the decoded textures for the current register state
+static const std::array<const TextureCache::CachedTexture*, 3>& GetCachedTextures() {
+    if (current_textures_valid)
+        return current_textures;
+
+    auto textures = registers.GetTextures();
+    for (unsigned i = 0; i < textures.size(); ++i) {
+        const auto& texture = textures[i];
+        current_textures[i] = texture.enabled ? &TextureCache::Lookup(texture.config, texture.format) : nullptr;
+    }
+
+    current_textures_valid = true;
+    return current_textures;
+}
+
+static void BinTriangle(const TriangleSetup& setup) {
+    // Exclusive pixel bounds
+    unsigned min_px = setup.min_x >> 4;
+    unsigned min_py = setup.min_y >> 4;
+    unsigned max_px = setup.max_x >> 4;
+    unsigned max_py = setup.max_y >> 4;
+
+    if (min_px >= max_px || min_py >= max_py)
+        return;
+
+    u32 triangle_index = static_cast<u32>(queued_triangles.size());
+    queued_triangles.push_back(setup);
+
+    for (unsigned tile_y = min_py / TILE_SIZE; tile_y <= (max_py - 1) / TILE_SIZE; ++tile_y) {
+        for (unsigned tile_x = min_px / TILE_SIZE; tile_x <= (max_px - 1) / TILE_SIZE; ++tile_x) {
+            u32 tile_index = tile_x + tile_y * NUM_TILES_X;
+            auto& bin = tile_bins[tile_index];
+            if (bin.empty())
+                active_tiles.push_back(tile_index);
+            bin.push_back(triangle_index);
         }
     }
 }
 
+void ProcessTriangle(const VertexShader::OutputVertex& v0,
+                     const VertexShader::OutputVertex& v1,
+                     const VertexShader::OutputVertex& v2)
+{
+    TriangleSetup setup;
+    if (!SetupTriangle(v0, v1, v2, setup))
+        return;
+
+    // Flushing invalidates the current pipeline and textures, so do it before looking them up
+    if (thread_pool && queued_triangles.size() >= MAX_QUEUED_TRIANGLES)
+        Flush();
+
+    setup.pipeline = GetPipeline();
+    setup.textures = GetCachedTextures();
+    framebuffer_written = true;
+
+    if (thread_pool) {
+        BinTriangle(setup);
+    } else {
+        RasterizeTriangle(setup, 0, 0, 0x10000, 0x10000);
+    }
+}
+
+void Flush() {
+    // Registers may be changed once the current triangles have been processed
+    current_pipeline = nullptr;
+    current_textures_valid = false;
+
+    if (!active_tiles.empty()) {
+        // Each tile is processed by exactly one thread, which shades its triangles in submission
+        // order. Since tiles don't overlap, this yields the same framebuffer contents as
+        // rasterizing all triangles sequentially.
+        thread_pool->ParallelFor(active_tiles.size(), [](size_t job) {
+            u32 tile_index = active_tiles[job];
+            unsigned region_min_x = (tile_index % NUM_TILES_X) * TILE_SIZE * 16;
+            unsigned region_min_y = (tile_index / NUM_TILES_X) * TILE_SIZE * 16;
+
+            for (u32 triangle_index : tile_bins[tile_index]) {
+                RasterizeTriangle(queued_triangles[triangle_index],
+                                  region_min_x, region_min_y,
+                                  region_min_x + TILE_SIZE * 16, region_min_y + TILE_SIZE * 16);
+            }
+        });
+
+        for (u32 tile_index : active_tiles)
+            tile_bins[tile_index].clear();
+        active_tiles.clear();
+    }
+    queued_triangles.clear();
+
+    // Games may render to textures, so cached copies of the framebuffer need to be dropped
+    if (framebuffer_written) {
+        const auto& framebuffer = registers.framebuffer;
+        u32 num_pixels = framebuffer.GetWidth() * framebuffer.GetHeight();
+        TextureCache::InvalidateRegion(framebuffer.GetColorBufferPhysicalAddress(), num_pixels * 4);
+        TextureCache::InvalidateRegion(framebuffer.GetDepthBufferPhysicalAddress(), num_pixels * 2);
+        framebuffer_written = false;
+    }
+
+    // No decoded textures are in use anymore at this point
+    TextureCache::Trim();
+}
+
+void Init() {
+#ifdef RASTERIZER_SSE2
+    use_sse2 = cpu_info.bSSE2;
+    if (use_sse2 && !CheckSpanShadingSSE2()) {
+        LOG_ERROR(Render_Software, "SSE2 span shading doesn't match ShadePixel, shading pixels one at a time");
+        use_sse2 = false;
+    }
+    if (use_sse2)
+        LOG_INFO(Render_Software, "Shading pixel spans using SSE2");
+#endif
+
+    if (Settings::values.rasterizer_threads > 1) {
+        thread_pool = Common::make_unique<Common::ThreadPool>(Settings::values.rasterizer_threads);
+        LOG_INFO(Render_Software, "Rasterizing on %d threads", Settings::values.rasterizer_threads);
+    }
+}
+
+void Shutdown() {
+    if (thread_pool)
+        Flush();
+    thread_pool.reset();
+
+    TextureCache::Clear();
+}
+
 } // namespace Rasterizer
 
 } // namespace Pica
@@ -12,10 +12,23 @@ namespace VertexShader {
 
 namespace Rasterizer {
 
+/**
+ * Rasterizes the given triangle. If multithreaded rasterization is enabled, the triangle is only
+ * queued for rasterization, and the framebuffer is guaranteed to be updated only after Flush().
+ */
 void ProcessTriangle(const VertexShader::OutputVertex& v0,
                      const VertexShader::OutputVertex& v1,
                      const VertexShader::OutputVertex& v2);
 
+/// Rasterizes all queued triangles and waits for the framebuffer to be fully updated
+void Flush();
+
+/// Sets up the rasterizer worker threads according to the current settings
+void Init();
+
+/// Finishes pending work and shuts down the rasterizer worker threads
+void Shutdown();
+
 } // namespace Rasterizer
 
 } // namespace Pica
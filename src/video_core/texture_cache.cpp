@@ -0,0 +1,168 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <array>
+#include <map>
+#include <memory>
+#include <tuple>
+
+#include "common/common.h"
+#include "common/make_unique.h"
+
+#include "core/mem_map.h"
+
+#include "video_core/debug_utils/debug_utils.h"
+#include "video_core/texture_cache.h"
+
+namespace Pica {
+
+namespace TextureCache {
+
+using CacheKey = std::tuple<PAddr, Regs::TextureFormat, unsigned, unsigned>;
+
+static std::map<CacheKey, std::unique_ptr<CachedTexture>> cached_textures;
+
+// Total number of decoded texels held by the cache
+static size_t cached_texel_count = 0;
+
+// Maximal number of decoded texels (i.e. 64 MiB of RGBA8 data) to keep before starting over
+static const size_t MAX_CACHED_TEXELS = 16 * 1024 * 1024;
+
+static const unsigned PAGE_BITS = 12;
+
+// Number of cached textures touching each page of the physical address space. This allows
+// filtering out the vast majority of memory writes without looking at any cached texture. CPU
+// writes to pages with cached textures are tracked, such that they invalidate the textures.
+static std::array<u16, (1 << (32 - PAGE_BITS))> page_refcounts;
+
+// Pages which got their first or lost their last cached texture since UpdatePageTracking was last
+// called. Textures are cached on the GPU thread, but only the CPU thread may change the tracking.
+static std::vector<u32> changed_pages;
+
+static void UpdatePageRefcounts(const CachedTexture& texture, int delta) {
+    if (texture.size == 0)
+        return;
+
+    u32 first_page = texture.address >> PAGE_BITS;
+    u32 last_page = (texture.address + texture.size - 1) >> PAGE_BITS;
+    for (u32 page = first_page; page <= last_page; ++page) {
+        bool was_cached = page_refcounts[page] != 0;
+        page_refcounts[page] += delta;
+        if (was_cached != (page_refcounts[page] != 0))
+            changed_pages.push_back(page);
+    }
+}
+
+static bool IsSupportedFormat(Regs::TextureFormat format) {
+    switch (format) {
+    case Regs::TextureFormat::RGBA8:
+    case Regs::TextureFormat::RGB8:
+    case Regs::TextureFormat::RGBA5551:
+    case Regs::TextureFormat::RGB565:
+    case Regs::TextureFormat::RGBA4:
+    case Regs::TextureFormat::IA8:
+    case Regs::TextureFormat::I8:
+    case Regs::TextureFormat::A8:
+    case Regs::TextureFormat::IA4:
+    case Regs::TextureFormat::A4:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+static std::unique_ptr<CachedTexture> Decode(const Regs::TextureConfig& config, Regs::TextureFormat format) {
+    auto texture = Common::make_unique<CachedTexture>();
+    texture->address = config.GetPhysicalAddress();
+    texture->format = format;
+    texture->width = config.width;
+    texture->height = config.height;
+    texture->size = texture->width * texture->height * Regs::NibblesPerPixel(format) / 2;
+    texture->texels.resize(texture->width * texture->height);
+
+    u8* data = Memory::GetPointer(PAddrToVAddr(texture->address));
+    if (!data) {
+        LOG_ERROR(HW_GPU, "Texture at invalid address 0x%08x", texture->address);
+        return texture;
+    }
+
+    // Unknown formats would decode to zero anyway, but report them only once per texture
+    if (!IsSupportedFormat(format)) {
+        LOG_ERROR(HW_GPU, "Unknown texture format: %x", (u32)format);
+        _dbg_assert_(HW_GPU, 0);
+        return texture;
+    }
+
+    auto info = DebugUtils::TextureInfo::FromPicaRegister(config, format);
+    for (unsigned t = 0; t < texture->height; ++t)
+        for (unsigned s = 0; s < texture->width; ++s)
+            texture->texels[s + t * texture->width] = DebugUtils::LookupTexture(data, s, t, info);
+
+    DebugUtils::DumpTexture(config, data);
+    return texture;
+}
+
+const CachedTexture& Lookup(const Regs::TextureConfig& config, Regs::TextureFormat format) {
+    CacheKey key(config.GetPhysicalAddress(), format, config.width, config.height);
+
+    auto& texture = cached_textures[key];
+    if (!texture) {
+        texture = Decode(config, format);
+        UpdatePageRefcounts(*texture, +1);
+        cached_texel_count += texture->texels.size();
+    }
+    return *texture;
+}
+
+void InvalidateRegion(PAddr start, u32 size) {
+    if (size == 0)
+        return;
+
+    // Fast path: Most writes don't touch any pages containing cached textures
+    u32 first_page = start >> PAGE_BITS;
+    u32 last_page = (start + size - 1) >> PAGE_BITS;
+    bool any_cached = false;
+    for (u32 page = first_page; page <= last_page && !any_cached; ++page)
+        any_cached = page_refcounts[page] != 0;
+
+    if (!any_cached)
+        return;
+
+    for (auto it = cached_textures.begin(); it != cached_textures.end();) {
+        const CachedTexture& texture = *it->second;
+        if (texture.address < start + size && start < texture.address + texture.size) {
+            UpdatePageRefcounts(texture, -1);
+            cached_texel_count -= texture.texels.size();
+            it = cached_textures.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void UpdatePageTracking() {
+    // A page may have changed more than once, its current refcount is what counts
+    for (u32 page : changed_pages)
+        Memory::SetPageWriteTracking(page << PAGE_BITS, page_refcounts[page] != 0);
+
+    changed_pages.clear();
+}
+
+void Trim() {
+    if (cached_texel_count > MAX_CACHED_TEXELS)
+        Clear();
+}
+
+void Clear() {
+    for (const auto& entry : cached_textures)
+        UpdatePageRefcounts(*entry.second, -1);
+
+    cached_textures.clear();
+    cached_texel_count = 0;
+}
+
+} // namespace
+
+} // namespace
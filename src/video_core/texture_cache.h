@@ -0,0 +1,70 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <vector>
+
+#include "common/common_types.h"
+
+#include "video_core/math.h"
+#include "video_core/pica.h"
+
+namespace Pica {
+
+/**
+ * Cache of textures decoded to linear RGBA8 data, so that the rasterizer doesn't need to decode
+ * each sampled texel from the tiled guest texture formats.
+ *
+ * Cached textures are invalidated whenever the underlying guest memory gets written to by the
+ * CPU, by GSP DMA, by memory fills and display transfers, or by the rasterizer itself. Since all
+ * of these happen on the emulation thread while no triangles are being rasterized, textures
+ * returned by Lookup may be used freely until the next rasterizer flush.
+ *
+ * The cache is used by the GPU thread while command lists are queued, and by the CPU thread only
+ * once they are finished (see CommandProcessor::WaitForIdle).
+ */
+namespace TextureCache {
+
+struct CachedTexture {
+    PAddr address;
+    u32 size; ///< Size of the encoded texture data in bytes
+    Regs::TextureFormat format;
+    unsigned width;
+    unsigned height;
+
+    /// Decoded texels, using the same coordinate system as DebugUtils::LookupTexture
+    std::vector<Math::Vec4<u8>> texels;
+
+    const Math::Vec4<u8>& GetTexel(unsigned s, unsigned t) const {
+        return texels[s + t * width];
+    }
+};
+
+/// Returns the decoded contents of the given texture, decoding it first if it isn't cached, yet
+const CachedTexture& Lookup(const Regs::TextureConfig& config, Regs::TextureFormat format);
+
+/// Drops all cached textures overlapping the given region of physical memory
+void InvalidateRegion(PAddr start, u32 size);
+
+/**
+ * Makes CPU writes to the pages with cached textures invalidate them, and stops tracking pages
+ * which no longer have any. The memory tracking is deferred to this, since it must only be changed
+ * by the CPU thread.
+ * @warning Must only be called by the CPU thread while the GPU thread is idle
+ */
+void UpdatePageTracking();
+
+/**
+ * Drops all cached textures if the cache exceeds its size limit.
+ * @warning Must not be called while textures returned by Lookup are still in use
+ */
+void Trim();
+
+/// Drops all cached textures
+void Clear();
+
+} // namespace
+
+} // namespace
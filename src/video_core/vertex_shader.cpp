@@ -2,19 +2,23 @@
 // Licensed under GPLv2 or any later version
 // Refer to the license.txt file included.
 
-#include <stack>
+#include <cmath>
+#include <unordered_map>
 
 #include <boost/range/algorithm.hpp>
 
 #include <common/file_util.h>
+#include <common/hash.h>
 
 #include <core/mem_map.h>
+#include <core/settings.h>
 
 #include <nihstro/shader_bytecode.h>
 
 
 #include "pica.h"
 #include "vertex_shader.h"
+#include "vertex_shader_jit_x64.h"
 #include "debug_utils/debug_utils.h"
 
 using nihstro::Instruction;
@@ -39,12 +43,38 @@ static struct {
 static std::array<u32, 1024> shader_memory;
 static std::array<u32, 1024> swizzle_data;
 
+// Set when the shader binary or swizzle patterns are changed to trigger decoding the program
+// again in the next call to Setup
+static bool program_dirty = true;
+
+#ifdef SHADER_JIT_X64
+// Compiled programs by hash of the program, swizzle patterns and main offset. Programs which
+// can't be compiled are cached as nullptr, so that compilation is not retried for every draw.
+static std::unordered_map<u64, std::unique_ptr<JitShader>> jit_cache;
+static const size_t MAX_CACHED_SHADERS = 256;
+
+static const JitShader* current_jit_shader = nullptr;
+
+// Set when the shader binary or swizzle patterns are changed to trigger a lookup of the
+// compiled program in the next call to Setup
+static bool shader_dirty = true;
+static u32 current_main_offset;
+#endif
+
 void SubmitShaderMemoryChange(u32 addr, u32 value) {
     shader_memory[addr] = value;
+    program_dirty = true;
+#ifdef SHADER_JIT_X64
+    shader_dirty = true;
+#endif
 }
 
 void SubmitSwizzleDataChange(u32 addr, u32 value) {
     swizzle_data[addr] = value;
+    program_dirty = true;
+#ifdef SHADER_JIT_X64
+    shader_dirty = true;
+#endif
 }
 
 Math::Vec4<float24>& GetFloatUniform(u32 index) {
@@ -67,8 +97,210 @@ const std::array<u32, 1024>& GetSwizzlePatterns() {
     return swizzle_data;
 }
 
+/**
+ * Pre-decoded form of a single shader instruction. The shader binary is decoded into micro-ops
+ * whenever it or the swizzle patterns changed, so that running the program for a vertex only
+ * requires executing them rather than decoding each instruction again.
+ */
+struct MicroOp {
+    enum class Type : u8 {
+        ADD, MUL, MAX, DP3, DP4, RCP, RSQ, MOVA, MOV, CMP,
+        END, CALL, NOP, IFU, IFC,
+
+        InvertedSources,     // Arithmetic instruction with inverted sources, which is not supported
+        UnhandledArithmetic,
+        Unhandled,
+        InvalidJump,         // Flow control instruction with a target outside of the binary
+    };
+
+    enum class Operand : u8 {
+        Input,
+        Temporary,
+        FloatUniform,
+        Dummy,
+        Relative, // Offset by an address register, hence only resolved when executing
+    };
+
+    enum class Dest : u8 {
+        Output,
+        Temporary,
+        Dummy,
+    };
+
+    enum class Compare : u8 {
+        Equal, NotEqual, LessThan, LessEqual, GreaterThan, GreaterEqual, Unknown
+    };
+
+    enum class Condition : u8 {
+        Or, And, JustX, JustY
+    };
+
+    Type type;
+
+    Operand src1_type;
+    Operand src2_type;
+    u8 src1_index;
+    u8 src2_index;
+    u8 address_register_index;
+    u8 src1_selector[4];
+    u8 src2_selector[4];
+    bool negate_src1;
+    bool negate_src2;
+
+    Dest dest_type;
+    u8 dest_index;
+    bool dest_enabled[4];
+
+    Compare compare[2];
+
+    u8 operand_desc_id;
+
+    u16 dest_offset;
+    u16 num_instructions;
+    u8 bool_uniform_id;
+    Condition condition;
+    bool refx;
+    bool refy;
+
+    // Original instruction, used for resolving relative sources and for error reporting
+    u32 hex;
+};
+
+// Decoded shader binary. The extra trailing entry is an END to stop programs running past the
+// end of the binary.
+static std::array<MicroOp, 1024 + 1> decoded_program;
+
+static void DecodeSource(const SourceRegister& source_reg, MicroOp::Operand& type, u8& index) {
+    switch (source_reg.GetRegisterType()) {
+    case RegisterType::Input:
+        type = MicroOp::Operand::Input;
+        break;
+
+    case RegisterType::Temporary:
+        type = MicroOp::Operand::Temporary;
+        break;
+
+    case RegisterType::FloatUniform:
+        type = MicroOp::Operand::FloatUniform;
+        break;
+
+    default:
+        type = MicroOp::Operand::Dummy;
+        index = 0;
+        return;
+    }
+    index = source_reg.GetIndex();
+}
+
+static MicroOp DecodeInstruction(const Instruction& instr) {
+    MicroOp op = {};
+    op.hex = instr.hex;
+
+    switch (instr.opcode.GetInfo().type) {
+    case Instruction::OpCodeType::Arithmetic:
+    {
+        if (0 != (instr.opcode.GetInfo().subtype & Instruction::OpCodeInfo::SrcInversed)) {
+            op.type = MicroOp::Type::InvertedSources;
+            return op;
+        }
+
+        switch (instr.opcode.EffectiveOpCode()) {
+        case Instruction::OpCode::ADD:  op.type = MicroOp::Type::ADD;  break;
+        case Instruction::OpCode::MUL:  op.type = MicroOp::Type::MUL;  break;
+        case Instruction::OpCode::MAX:  op.type = MicroOp::Type::MAX;  break;
+        case Instruction::OpCode::DP3:  op.type = MicroOp::Type::DP3;  break;
+        case Instruction::OpCode::DP4:  op.type = MicroOp::Type::DP4;  break;
+        case Instruction::OpCode::RCP:  op.type = MicroOp::Type::RCP;  break;
+        case Instruction::OpCode::RSQ:  op.type = MicroOp::Type::RSQ;  break;
+        case Instruction::OpCode::MOVA: op.type = MicroOp::Type::MOVA; break;
+        case Instruction::OpCode::MOV:  op.type = MicroOp::Type::MOV;  break;
+        case Instruction::OpCode::CMP:  op.type = MicroOp::Type::CMP;  break;
+        default:                        op.type = MicroOp::Type::UnhandledArithmetic; break;
+        }
+
+        op.address_register_index = instr.common.address_register_index;
+        if (op.address_register_index == 0) {
+            DecodeSource(instr.common.GetSrc1(false), op.src1_type, op.src1_index);
+        } else {
+            op.src1_type = MicroOp::Operand::Relative;
+        }
+        DecodeSource(instr.common.GetSrc2(false), op.src2_type, op.src2_index);
+
+        const SwizzlePattern& swizzle = *(SwizzlePattern*)&swizzle_data[instr.common.operand_desc_id];
+        for (int i = 0; i < 4; ++i) {
+            op.src1_selector[i] = (u8)swizzle.GetSelectorSrc1(i);
+            op.src2_selector[i] = (u8)swizzle.GetSelectorSrc2(i);
+            op.dest_enabled[i] = swizzle.DestComponentEnabled(i);
+        }
+        op.negate_src1 = ((bool)swizzle.negate_src1 != false);
+        op.negate_src2 = ((bool)swizzle.negate_src2 != false);
+        op.operand_desc_id = instr.common.operand_desc_id;
+
+        if (instr.common.dest < 0x08) {
+            op.dest_type = MicroOp::Dest::Output;
+            op.dest_index = instr.common.dest.GetIndex();
+        } else if (instr.common.dest >= 0x10 && instr.common.dest < 0x20) {
+            op.dest_type = MicroOp::Dest::Temporary;
+            op.dest_index = instr.common.dest.GetIndex();
+        } else {
+            op.dest_type = MicroOp::Dest::Dummy;
+        }
+
+        auto compare_op = instr.common.compare_op;
+        for (int i = 0; i < 2; ++i) {
+            switch ((i == 0) ? compare_op.x.Value() : compare_op.y.Value()) {
+            case compare_op.Equal:        op.compare[i] = MicroOp::Compare::Equal;        break;
+            case compare_op.NotEqual:     op.compare[i] = MicroOp::Compare::NotEqual;     break;
+            case compare_op.LessThan:     op.compare[i] = MicroOp::Compare::LessThan;     break;
+            case compare_op.LessEqual:    op.compare[i] = MicroOp::Compare::LessEqual;    break;
+            case compare_op.GreaterThan:  op.compare[i] = MicroOp::Compare::GreaterThan;  break;
+            case compare_op.GreaterEqual: op.compare[i] = MicroOp::Compare::GreaterEqual; break;
+            default:                      op.compare[i] = MicroOp::Compare::Unknown;      break;
+            }
+        }
+        return op;
+    }
+
+    default:
+        switch (instr.opcode) {
+        case Instruction::OpCode::END: op.type = MicroOp::Type::END; return op;
+        case Instruction::OpCode::NOP: op.type = MicroOp::Type::NOP; return op;
+        case Instruction::OpCode::CALL: op.type = MicroOp::Type::CALL; break;
+        case Instruction::OpCode::IFU: op.type = MicroOp::Type::IFU; break;
+        case Instruction::OpCode::IFC: op.type = MicroOp::Type::IFC; break;
+        default: op.type = MicroOp::Type::Unhandled; return op;
+        }
+
+        op.dest_offset = instr.flow_control.dest_offset;
+        op.num_instructions = instr.flow_control.num_instructions;
+        op.bool_uniform_id = instr.flow_control.bool_uniform_id;
+        op.refx = instr.flow_control.refx;
+        op.refy = instr.flow_control.refy;
+
+        auto flow_control = instr.flow_control;
+        switch (flow_control.op) {
+        case flow_control.Or:    op.condition = MicroOp::Condition::Or;    break;
+        case flow_control.And:   op.condition = MicroOp::Condition::And;   break;
+        case flow_control.JustX: op.condition = MicroOp::Condition::JustX; break;
+        case flow_control.JustY: op.condition = MicroOp::Condition::JustY; break;
+        }
+
+        if (op.dest_offset + op.num_instructions > shader_memory.size())
+            op.type = MicroOp::Type::InvalidJump;
+        return op;
+    }
+}
+
+static void DecodeProgram() {
+    for (size_t i = 0; i < shader_memory.size(); ++i)
+        decoded_program[i] = DecodeInstruction(*(const Instruction*)&shader_memory[i]);
+
+    decoded_program.back() = {};
+    decoded_program.back().type = MicroOp::Type::END;
+}
+
 struct VertexShaderState {
-    u32* program_counter;
+    u32 program_counter;
 
     const float24* input_register_table[16];
     float24* output_register_table[7*4];
@@ -80,17 +312,20 @@ struct VertexShaderState {
     // TODO: How many bits do these actually have?
     s32 address_registers[3];
 
-    enum {
-        INVALID_ADDRESS = 0xFFFFFFFF
-    };
-
     struct CallStackElement {
         u32 final_address;
         u32 return_address;
     };
 
-    // TODO: Is there a maximal size for this?
-    std::stack<CallStackElement> call_stack;
+    // Holds both subroutine calls and IF blocks.
+    // TODO: Figure out the nesting limit of the hardware
+    static const unsigned MAX_CALL_DEPTH = 16;
+    CallStackElement call_stack[MAX_CALL_DEPTH];
+    unsigned call_stack_size;
+
+    // Placeholder for invalid inputs and outputs. Kept per invocation since vertices may be
+    // shaded on multiple threads concurrently.
+    float24 dummy_vec4_float24[4];
 
     struct {
         u32 max_offset; // maximum program counter ever reached
@@ -98,16 +333,30 @@ struct VertexShaderState {
     } debug;
 };
 
-static void ProcessShaderCode(VertexShaderState& state) {
+static const float24* LookupSourceRegister(const VertexShaderState& state, MicroOp::Operand type, u32 index) {
+    switch (type) {
+    case MicroOp::Operand::Input:
+        return state.input_register_table[index];
+
+    case MicroOp::Operand::Temporary:
+        return &state.temporary_registers[index].x;
+
+    case MicroOp::Operand::FloatUniform:
+        return &shader_uniforms.f[index].x;
 
-    // Placeholder for invalid inputs
-    static float24 dummy_vec4_float24[4];
+    default:
+        return state.dummy_vec4_float24;
+    }
+}
+
+static void ProcessShaderCode(VertexShaderState& state) {
 
     while (true) {
-        if (!state.call_stack.empty()) {
-            if (state.program_counter - shader_memory.data() == state.call_stack.top().final_address) {
-                state.program_counter = &shader_memory[state.call_stack.top().return_address];
-                state.call_stack.pop();
+        if (state.call_stack_size != 0) {
+            const auto& top = state.call_stack[state.call_stack_size - 1];
+            if (state.program_counter == top.final_address) {
+                state.program_counter = top.return_address;
+                --state.call_stack_size;
 
                 // TODO: Is "trying again" accurate to hardware?
                 continue;
@@ -115,91 +364,91 @@ static void ProcessShaderCode(VertexShaderState& state) {
         }
 
         bool exit_loop = false;
-        const Instruction& instr = *(const Instruction*)state.program_counter;
-        const SwizzlePattern& swizzle = *(SwizzlePattern*)&swizzle_data[instr.common.operand_desc_id];
+        const MicroOp& op = decoded_program[state.program_counter];
 
         auto call = [&](VertexShaderState& state, u32 offset, u32 num_instructions, u32 return_offset) {
-            state.program_counter = &shader_memory[offset] - 1; // -1 to make sure when incrementing the PC we end up at the correct offset
-            state.call_stack.push({ offset + num_instructions, return_offset });
+            if (state.call_stack_size == VertexShaderState::MAX_CALL_DEPTH) {
+                LOG_ERROR(HW_GPU, "Shader call stack overflow at offset 0x%x", state.program_counter);
+                exit_loop = true;
+                return;
+            }
+            state.program_counter = offset - 1; // -1 to make sure when incrementing the PC we end up at the correct offset
+            state.call_stack[state.call_stack_size++] = { offset + num_instructions, return_offset };
         };
-        u32 binary_offset = state.program_counter - shader_memory.data();
+        u32 binary_offset = state.program_counter;
 
         state.debug.max_offset = std::max<u32>(state.debug.max_offset, 1 + binary_offset);
 
-        auto LookupSourceRegister = [&](const SourceRegister& source_reg) -> const float24* {
-            switch (source_reg.GetRegisterType()) {
-            case RegisterType::Input:
-                return state.input_register_table[source_reg.GetIndex()];
-
-            case RegisterType::Temporary:
-                return &state.temporary_registers[source_reg.GetIndex()].x;
-
-            case RegisterType::FloatUniform:
-                return &shader_uniforms.f[source_reg.GetIndex()].x;
-
-            default:
-                return dummy_vec4_float24;
-            }
-        };
-
-        switch (instr.opcode.GetInfo().type) {
-        case Instruction::OpCodeType::Arithmetic:
+        switch (op.type) {
+        case MicroOp::Type::InvertedSources:
+            // TODO: We don't really support this properly: For instance, the address register
+            //       offset needs to be applied to SRC2 instead, etc.
+            //       For now, we just abort in this situation.
+            LOG_CRITICAL(HW_GPU, "Bad condition...");
+            exit(0);
+
+        case MicroOp::Type::ADD:
+        case MicroOp::Type::MUL:
+        case MicroOp::Type::MAX:
+        case MicroOp::Type::DP3:
+        case MicroOp::Type::DP4:
+        case MicroOp::Type::RCP:
+        case MicroOp::Type::RSQ:
+        case MicroOp::Type::MOVA:
+        case MicroOp::Type::MOV:
+        case MicroOp::Type::CMP:
+        case MicroOp::Type::UnhandledArithmetic:
         {
-            bool is_inverted = 0 != (instr.opcode.GetInfo().subtype & Instruction::OpCodeInfo::SrcInversed);
-            if (is_inverted) {
-                // TODO: We don't really support this properly: For instance, the address register
-                //       offset needs to be applied to SRC2 instead, etc.
-                //       For now, we just abort in this situation.
-                LOG_CRITICAL(HW_GPU, "Bad condition...");
-                exit(0);
+            const float24* src1_;
+            if (op.src1_type == MicroOp::Operand::Relative) {
+                const Instruction& instr = *(const Instruction*)&op.hex;
+                const SourceRegister source_reg = instr.common.GetSrc1(false) + state.address_registers[op.address_register_index - 1];
+
+                MicroOp::Operand type;
+                u8 index;
+                DecodeSource(source_reg, type, index);
+                src1_ = LookupSourceRegister(state, type, index);
+            } else {
+                src1_ = LookupSourceRegister(state, op.src1_type, op.src1_index);
             }
-
-            const int address_offset = (instr.common.address_register_index == 0)
-                                       ? 0 : state.address_registers[instr.common.address_register_index - 1];
-
-            const float24* src1_ = LookupSourceRegister(instr.common.GetSrc1(is_inverted) + address_offset);
-            const float24* src2_ = LookupSourceRegister(instr.common.GetSrc2(is_inverted));
-
-            const bool negate_src1 = ((bool)swizzle.negate_src1 != false);
-            const bool negate_src2 = ((bool)swizzle.negate_src2 != false);
+            const float24* src2_ = LookupSourceRegister(state, op.src2_type, op.src2_index);
 
             float24 src1[4] = {
-                src1_[(int)swizzle.GetSelectorSrc1(0)],
-                src1_[(int)swizzle.GetSelectorSrc1(1)],
-                src1_[(int)swizzle.GetSelectorSrc1(2)],
-                src1_[(int)swizzle.GetSelectorSrc1(3)],
+                src1_[op.src1_selector[0]],
+                src1_[op.src1_selector[1]],
+                src1_[op.src1_selector[2]],
+                src1_[op.src1_selector[3]],
             };
-            if (negate_src1) {
+            if (op.negate_src1) {
                 src1[0] = src1[0] * float24::FromFloat32(-1);
                 src1[1] = src1[1] * float24::FromFloat32(-1);
                 src1[2] = src1[2] * float24::FromFloat32(-1);
                 src1[3] = src1[3] * float24::FromFloat32(-1);
             }
             float24 src2[4] = {
-                src2_[(int)swizzle.GetSelectorSrc2(0)],
-                src2_[(int)swizzle.GetSelectorSrc2(1)],
-                src2_[(int)swizzle.GetSelectorSrc2(2)],
-                src2_[(int)swizzle.GetSelectorSrc2(3)],
+                src2_[op.src2_selector[0]],
+                src2_[op.src2_selector[1]],
+                src2_[op.src2_selector[2]],
+                src2_[op.src2_selector[3]],
             };
-            if (negate_src2) {
+            if (op.negate_src2) {
                 src2[0] = src2[0] * float24::FromFloat32(-1);
                 src2[1] = src2[1] * float24::FromFloat32(-1);
                 src2[2] = src2[2] * float24::FromFloat32(-1);
                 src2[3] = src2[3] * float24::FromFloat32(-1);
             }
 
-            float24* dest = (instr.common.dest < 0x08) ? state.output_register_table[4*instr.common.dest.GetIndex()]
-                        : (instr.common.dest < 0x10) ? dummy_vec4_float24
-                        : (instr.common.dest < 0x20) ? &state.temporary_registers[instr.common.dest.GetIndex()][0]
-                        : dummy_vec4_float24;
+            float24* dest = (op.dest_type == MicroOp::Dest::Output) ? state.output_register_table[4*op.dest_index]
+                          : (op.dest_type == MicroOp::Dest::Temporary) ? &state.temporary_registers[op.dest_index][0]
+                          : state.dummy_vec4_float24;
 
-            state.debug.max_opdesc_id = std::max<u32>(state.debug.max_opdesc_id, 1+instr.common.operand_desc_id);
+            state.debug.max_opdesc_id = std::max<u32>(state.debug.max_opdesc_id, 1+op.operand_desc_id);
 
-            switch (instr.opcode.EffectiveOpCode()) {
-            case Instruction::OpCode::ADD:
+            switch (op.type) {
+            case MicroOp::Type::ADD:
             {
                 for (int i = 0; i < 4; ++i) {
-                    if (!swizzle.DestComponentEnabled(i))
+                    if (!op.dest_enabled[i])
                         continue;
 
                     dest[i] = src1[i] + src2[i];
@@ -208,10 +457,10 @@ static void ProcessShaderCode(VertexShaderState& state) {
                 break;
             }
 
-            case Instruction::OpCode::MUL:
+            case MicroOp::Type::MUL:
             {
                 for (int i = 0; i < 4; ++i) {
-                    if (!swizzle.DestComponentEnabled(i))
+                    if (!op.dest_enabled[i])
                         continue;
 
                     dest[i] = src1[i] * src2[i];
@@ -220,25 +469,25 @@ static void ProcessShaderCode(VertexShaderState& state) {
                 break;
             }
 
-            case Instruction::OpCode::MAX:
+            case MicroOp::Type::MAX:
                 for (int i = 0; i < 4; ++i) {
-                    if (!swizzle.DestComponentEnabled(i))
+                    if (!op.dest_enabled[i])
                         continue;
 
                     dest[i] = std::max(src1[i], src2[i]);
                 }
                 break;
 
-            case Instruction::OpCode::DP3:
-            case Instruction::OpCode::DP4:
+            case MicroOp::Type::DP3:
+            case MicroOp::Type::DP4:
             {
                 float24 dot = float24::FromFloat32(0.f);
-                int num_components = (instr.opcode == Instruction::OpCode::DP3) ? 3 : 4;
+                int num_components = (op.type == MicroOp::Type::DP3) ? 3 : 4;
                 for (int i = 0; i < num_components; ++i)
                     dot = dot + src1[i] * src2[i];
 
                 for (int i = 0; i < num_components; ++i) {
-                    if (!swizzle.DestComponentEnabled(i))
+                    if (!op.dest_enabled[i])
                         continue;
 
                     dest[i] = dot;
@@ -247,10 +496,10 @@ static void ProcessShaderCode(VertexShaderState& state) {
             }
 
             // Reciprocal
-            case Instruction::OpCode::RCP:
+            case MicroOp::Type::RCP:
             {
                 for (int i = 0; i < 4; ++i) {
-                    if (!swizzle.DestComponentEnabled(i))
+                    if (!op.dest_enabled[i])
                         continue;
 
                     // TODO: Be stable against division by zero!
@@ -262,24 +511,24 @@ static void ProcessShaderCode(VertexShaderState& state) {
             }
 
             // Reciprocal Square Root
-            case Instruction::OpCode::RSQ:
+            case MicroOp::Type::RSQ:
             {
                 for (int i = 0; i < 4; ++i) {
-                    if (!swizzle.DestComponentEnabled(i))
+                    if (!op.dest_enabled[i])
                         continue;
 
                     // TODO: Be stable against division by zero!
                     // TODO: I think this might be wrong... we should only use one component here
-                    dest[i] = float24::FromFloat32(1.0 / sqrt(src1[i].ToFloat32()));
+                    dest[i] = float24::FromFloat32(1.0 / std::sqrt(static_cast<double>(src1[i].ToFloat32())));
                 }
 
                 break;
             }
 
-            case Instruction::OpCode::MOVA:
+            case MicroOp::Type::MOVA:
             {
                 for (int i = 0; i < 2; ++i) {
-                    if (!swizzle.DestComponentEnabled(i))
+                    if (!op.dest_enabled[i])
                         continue;
 
                     // TODO: Figure out how the rounding is done on hardware
@@ -289,10 +538,10 @@ static void ProcessShaderCode(VertexShaderState& state) {
                 break;
             }
 
-            case Instruction::OpCode::MOV:
+            case MicroOp::Type::MOV:
             {
                 for (int i = 0; i < 4; ++i) {
-                    if (!swizzle.DestComponentEnabled(i))
+                    if (!op.dest_enabled[i])
                         continue;
 
                     dest[i] = src1[i];
@@ -300,136 +549,135 @@ static void ProcessShaderCode(VertexShaderState& state) {
                 break;
             }
 
-            case Instruction::OpCode::CMP:
+            case MicroOp::Type::CMP:
                 for (int i = 0; i < 2; ++i) {
                     // TODO: Can you restrict to one compare via dest masking?
 
-                    auto compare_op = instr.common.compare_op;
-                    auto op = (i == 0) ? compare_op.x.Value() : compare_op.y.Value();
-
-                    switch (op) {
-                        case compare_op.Equal:
+                    switch (op.compare[i]) {
+                        case MicroOp::Compare::Equal:
                             state.conditional_code[i] = (src1[i] == src2[i]);
                             break;
 
-                        case compare_op.NotEqual:
+                        case MicroOp::Compare::NotEqual:
                             state.conditional_code[i] = (src1[i] != src2[i]);
                             break;
 
-                        case compare_op.LessThan:
+                        case MicroOp::Compare::LessThan:
                             state.conditional_code[i] = (src1[i] <  src2[i]);
                             break;
 
-                        case compare_op.LessEqual:
+                        case MicroOp::Compare::LessEqual:
                             state.conditional_code[i] = (src1[i] <= src2[i]);
                             break;
 
-                        case compare_op.GreaterThan:
+                        case MicroOp::Compare::GreaterThan:
                             state.conditional_code[i] = (src1[i] >  src2[i]);
                             break;
 
-                        case compare_op.GreaterEqual:
+                        case MicroOp::Compare::GreaterEqual:
                             state.conditional_code[i] = (src1[i] >= src2[i]);
                             break;
 
                         default:
-                            LOG_ERROR(HW_GPU, "Unknown compare mode %x", static_cast<int>(op));
+                        {
+                            auto compare_op = ((const Instruction*)&op.hex)->common.compare_op;
+                            LOG_ERROR(HW_GPU, "Unknown compare mode %x",
+                                      static_cast<int>((i == 0) ? compare_op.x.Value() : compare_op.y.Value()));
                             break;
+                        }
                     }
                 }
                 break;
 
             default:
+            {
+                const Instruction& instr = *(const Instruction*)&op.hex;
                 LOG_ERROR(HW_GPU, "Unhandled arithmetic instruction: 0x%02x (%s): 0x%08x",
                           (int)instr.opcode.Value(), instr.opcode.GetInfo().name, instr.hex);
                 _dbg_assert_(HW_GPU, 0);
                 break;
             }
+            }
 
             break;
         }
-        default:
-            // Handle each instruction on its own
-            switch (instr.opcode) {
-            case Instruction::OpCode::END:
-                exit_loop = true;
-                break;
 
-            case Instruction::OpCode::CALL:
-                call(state,
-                     instr.flow_control.dest_offset,
-                     instr.flow_control.num_instructions,
-                     binary_offset + 1);
-                break;
-
-            case Instruction::OpCode::NOP:
-                break;
+        case MicroOp::Type::END:
+            exit_loop = true;
+            break;
 
-            case Instruction::OpCode::IFU:
-                if (shader_uniforms.b[instr.flow_control.bool_uniform_id]) {
-                    call(state,
-                         binary_offset + 1,
-                         instr.flow_control.dest_offset - binary_offset - 1,
-                         instr.flow_control.dest_offset + instr.flow_control.num_instructions);
-                } else {
-                    call(state,
-                         instr.flow_control.dest_offset,
-                         instr.flow_control.num_instructions,
-                         instr.flow_control.dest_offset + instr.flow_control.num_instructions);
-                }
+        case MicroOp::Type::CALL:
+            call(state,
+                 op.dest_offset,
+                 op.num_instructions,
+                 binary_offset + 1);
+            break;
 
-                break;
+        case MicroOp::Type::NOP:
+            break;
 
-            case Instruction::OpCode::IFC:
-            {
+        case MicroOp::Type::IFU:
+        case MicroOp::Type::IFC:
+        {
+            bool condition;
+            if (op.type == MicroOp::Type::IFU) {
+                condition = shader_uniforms.b[op.bool_uniform_id];
+            } else {
                 // TODO: Do we need to consider swizzlers here?
 
-                auto flow_control = instr.flow_control;
-                bool results[3] = { (bool)flow_control.refx == state.conditional_code[0],
-                                    (bool)flow_control.refy == state.conditional_code[1] };
+                bool results[2] = { op.refx == state.conditional_code[0],
+                                    op.refy == state.conditional_code[1] };
 
-                switch (flow_control.op) {
-                case flow_control.Or:
-                    results[2] = results[0] || results[1];
+                switch (op.condition) {
+                case MicroOp::Condition::Or:
+                    condition = results[0] || results[1];
                     break;
 
-                case flow_control.And:
-                    results[2] = results[0] && results[1];
+                case MicroOp::Condition::And:
+                    condition = results[0] && results[1];
                     break;
 
-                case flow_control.JustX:
-                    results[2] = results[0];
+                case MicroOp::Condition::JustX:
+                    condition = results[0];
                     break;
 
-                case flow_control.JustY:
-                    results[2] = results[1];
+                case MicroOp::Condition::JustY:
+                default:
+                    condition = results[1];
                     break;
                 }
-
-                if (results[2]) {
-                    call(state,
-                         binary_offset + 1,
-                         instr.flow_control.dest_offset - binary_offset - 1,
-                         instr.flow_control.dest_offset + instr.flow_control.num_instructions);
-                } else {
-                    call(state,
-                         instr.flow_control.dest_offset,
-                         instr.flow_control.num_instructions,
-                         instr.flow_control.dest_offset + instr.flow_control.num_instructions);
-                }
-
-                break;
             }
 
-            default:
-                LOG_ERROR(HW_GPU, "Unhandled instruction: 0x%02x (%s): 0x%08x",
-                          (int)instr.opcode.Value(), instr.opcode.GetInfo().name, instr.hex);
-                break;
+            if (condition) {
+                call(state,
+                     binary_offset + 1,
+                     op.dest_offset - binary_offset - 1,
+                     op.dest_offset + op.num_instructions);
+            } else {
+                call(state,
+                     op.dest_offset,
+                     op.num_instructions,
+                     op.dest_offset + op.num_instructions);
             }
 
             break;
         }
 
+        case MicroOp::Type::InvalidJump:
+            LOG_ERROR(HW_GPU, "Shader jumps outside of the binary at offset 0x%x: 0x%08x",
+                      binary_offset, op.hex);
+            exit_loop = true;
+            break;
+
+        default:
+        {
+            const Instruction& instr = *(const Instruction*)&op.hex;
+            LOG_ERROR(HW_GPU, "Unhandled instruction: 0x%02x (%s): 0x%08x",
+                      (int)instr.opcode.Value(), instr.opcode.GetInfo().name, instr.hex);
+            break;
+        }
+        }
+
         ++state.program_counter;
 
         if (exit_loop)
@@ -437,18 +685,13 @@ static void ProcessShaderCode(VertexShaderState& state) {
     }
 }
 
-OutputVertex RunShader(const InputVertex& input, int num_attributes) {
-    VertexShaderState state;
-
-    const u32* main = &shader_memory[registers.vs_main_offset];
-    state.program_counter = (u32*)main;
-    state.debug.max_offset = 0;
-    state.debug.max_opdesc_id = 0;
-
+/// Points the register tables of an interpreter or JIT state at the given input and output vertex
+template<typename State>
+static void SetupRegisterTables(State& state, const InputVertex& input, int num_attributes,
+                                OutputVertex& ret, const float24* dummy_register) {
     // Setup input register table
     const auto& attribute_register_map = registers.vs_input_register_map;
-    float24 dummy_register;
-    boost::fill(state.input_register_table, &dummy_register);
+    boost::fill(state.input_register_table, dummy_register);
     if(num_attributes > 0) state.input_register_table[attribute_register_map.attribute0_register] = &input.attr[0].x;
     if(num_attributes > 1) state.input_register_table[attribute_register_map.attribute1_register] = &input.attr[1].x;
     if(num_attributes > 2) state.input_register_table[attribute_register_map.attribute2_register] = &input.attr[2].x;
@@ -467,7 +710,6 @@ OutputVertex RunShader(const InputVertex& input, int num_attributes) {
     if(num_attributes > 15) state.input_register_table[attribute_register_map.attribute15_register] = &input.attr[15].x;
 
     // Setup output register table
-    OutputVertex ret;
     // Zero output so that attributes which aren't output won't have denormals in them, which will
     // slow us down later.
     memset(&ret, 0, sizeof(ret));
@@ -486,6 +728,19 @@ OutputVertex RunShader(const InputVertex& input, int num_attributes) {
 
     state.conditional_code[0] = false;
     state.conditional_code[1] = false;
+}
+
+static OutputVertex InterpretShader(const InputVertex& input, int num_attributes) {
+    VertexShaderState state;
+
+    state.program_counter = registers.vs_main_offset;
+    state.call_stack_size = 0;
+    state.debug.max_offset = 0;
+    state.debug.max_opdesc_id = 0;
+
+    float24 dummy_register;
+    OutputVertex ret;
+    SetupRegisterTables(state, input, num_attributes, ret, &dummy_register);
 
     ProcessShaderCode(state);
     DebugUtils::DumpShader(shader_memory.data(), state.debug.max_offset, swizzle_data.data(),
@@ -500,6 +755,79 @@ OutputVertex RunShader(const InputVertex& input, int num_attributes) {
     return ret;
 }
 
+void Setup() {
+    if (program_dirty) {
+        DecodeProgram();
+        program_dirty = false;
+    }
+
+#ifdef SHADER_JIT_X64
+    if (!Settings::values.use_shader_jit) {
+        current_jit_shader = nullptr;
+        shader_dirty = true;
+        return;
+    }
+
+    if (!shader_dirty && current_main_offset == registers.vs_main_offset)
+        return;
+
+    shader_dirty = false;
+    current_main_offset = registers.vs_main_offset;
+
+    u64 hash = GetHash64(reinterpret_cast<const u8*>(shader_memory.data()), sizeof(shader_memory), 0);
+    hash = hash * 31 + GetHash64(reinterpret_cast<const u8*>(swizzle_data.data()), sizeof(swizzle_data), 0);
+    hash = hash * 31 + current_main_offset;
+
+    auto it = jit_cache.find(hash);
+    if (it != jit_cache.end() && (!it->second || it->second->Matches(shader_memory, swizzle_data, current_main_offset))) {
+        current_jit_shader = it->second.get();
+        return;
+    }
+
+    if (jit_cache.size() >= MAX_CACHED_SHADERS)
+        jit_cache.clear();
+
+    auto shader = JitShader::Compile(shader_memory, swizzle_data, current_main_offset,
+                                     shader_uniforms.f, shader_uniforms.b.data());
+    if (!shader)
+        LOG_WARNING(HW_GPU, "Shader at offset 0x%x not supported by the JIT, using the interpreter", current_main_offset);
+
+    current_jit_shader = shader.get();
+    jit_cache[hash] = std::move(shader);
+#endif
+}
+
+OutputVertex RunShader(const InputVertex& input, int num_attributes) {
+#ifdef SHADER_JIT_X64
+    if (current_jit_shader) {
+        JitState state;
+        float24 dummy_register;
+        OutputVertex ret;
+        SetupRegisterTables(state, input, num_attributes, ret, &dummy_register);
+
+        current_jit_shader->Run(state);
+
+        if (Settings::values.shader_jit_verify) {
+            OutputVertex reference = InterpretShader(input, num_attributes);
+            const float24* jit_output = (const float24*)&ret;
+            const float24* reference_output = (const float24*)&reference;
+            for (unsigned i = 0; i < sizeof(OutputVertex) / sizeof(float24); ++i) {
+                if (memcmp(&jit_output[i], &reference_output[i], sizeof(float24)) == 0)
+                    continue;
+
+                LOG_ERROR(HW_GPU, "Shader JIT output %u is %f, but the interpreter returned %f (main offset 0x%x)",
+                          i, jit_output[i].ToFloat32(), reference_output[i].ToFloat32(), current_main_offset);
+                return reference;
+            }
+        }
+
+        return ret;
+    }
+#endif
+
+    return InterpretShader(input, num_attributes);
+}
+
 
 } // namespace
 
@@ -69,6 +69,13 @@ static_assert(sizeof(OutputVertex) == 32 * sizeof(float), "OutputVertex has inva
 void SubmitShaderMemoryChange(u32 addr, u32 value);
 void SubmitSwizzleDataChange(u32 addr, u32 value);
 
+/**
+ * Prepares running the current shader program by decoding it and looking up its compiled form.
+ * Needs to be called before RunShader whenever the program, swizzle patterns or main offset may
+ * have changed.
+ */
+void Setup();
+
 OutputVertex RunShader(const InputVertex& input, int num_attributes);
 
 Math::Vec4<float24>& GetFloatUniform(u32 index);
@@ -0,0 +1,603 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <nihstro/shader_bytecode.h>
+
+#include "common/memory_util.h"
+#include "common/x64_emitter.h"
+
+#include "vertex_shader_jit_x64.h"
+
+#ifdef SHADER_JIT_X64
+
+using nihstro::Instruction;
+using nihstro::RegisterType;
+using nihstro::SourceRegister;
+using nihstro::SwizzlePattern;
+
+namespace Pica {
+
+namespace VertexShader {
+
+namespace {
+
+using namespace X64;
+
+// Registers with a fixed meaning throughout compiled code. All of them are callee-saved in both
+// the System V and the Windows x64 calling conventions.
+static const X64Reg STATE = R12;          // JitState of the current invocation
+static const X64Reg FLOAT_UNIFORMS = R13; // Float uniform array
+static const X64Reg STACK_BASE = R14;     // Stack pointer of the outermost frame, used by END
+static const X64Reg BOOL_UNIFORMS = R15;  // Bool uniform array
+
+// Operands of the current arithmetic instruction. Only caller-saved XMM registers are used, so
+// compiled code does not need to preserve any on Windows.
+static const XmmReg SRC1 = XMM0;
+static const XmmReg SRC2 = XMM1;
+static const XmmReg RESULT = XMM2;
+static const XmmReg SCRATCH1 = XMM3;
+static const XmmReg SCRATCH2 = XMM4;
+static const XmmReg CONSTANT = XMM5;
+
+// Stack space reserved by each frame of compiled code: The Windows x64 calling convention
+// requires 32 bytes of shadow space for called functions, and another 8 bytes keep the stack
+// 16-byte aligned since either a return address or four 8-byte registers have been pushed.
+static const s8 FRAME_SIZE = 40;
+
+/// Called by compiled code to resolve a source register indexed by an address register
+static const float24* LookupRelativeSource(const JitState* state, const Instruction* instr,
+                                           const Math::Vec4<float24>* float_uniforms) {
+    const int address_offset = state->address_registers[instr->common.address_register_index - 1];
+    const SourceRegister source_reg = instr->common.GetSrc1(false) + address_offset;
+
+    switch (source_reg.GetRegisterType()) {
+    case RegisterType::Input:
+        return state->input_register_table[source_reg.GetIndex()];
+
+    case RegisterType::Temporary:
+        return &state->temporary_registers[source_reg.GetIndex()].x;
+
+    case RegisterType::FloatUniform:
+        return &float_uniforms[source_reg.GetIndex()].x;
+
+    default:
+        return state->dummy_vec4_float24;
+    }
+}
+
+/**
+ * Translates a shader program to x86-64 code. Flow control of the shader is structured, so rather
+ * than emulating the interpreter's call stack, CALL is compiled to a native call to a subroutine
+ * and IFU/IFC to native branches around the inlined conditional blocks. Programs for which this
+ * would not reproduce the interpreter's behavior are rejected.
+ */
+class ShaderCompiler {
+public:
+    ShaderCompiler(const u32* program, const u32* swizzle_data,
+                   const Math::Vec4<float24>* float_uniforms, const bool* bool_uniforms)
+        : program(program), swizzle_data(swizzle_data),
+          float_uniforms(float_uniforms), bool_uniforms(bool_uniforms) {
+    }
+
+    /// Compiles the program, returns false if it can't be compiled
+    bool Compile(u32 main_offset) {
+        // Epilogue shared by all exits of the program
+        epilogue = code.GetOffset();
+        code.ADD64(RSP, FRAME_SIZE);
+        code.POP(R15);
+        code.POP(R14);
+        code.POP(R13);
+        code.POP(R12);
+        code.RET();
+
+        entry_point = code.GetOffset();
+        code.PUSH(R12);
+        code.PUSH(R13);
+        code.PUSH(R14);
+        code.PUSH(R15);
+        code.SUB64(RSP, FRAME_SIZE);
+        code.MOV64(STATE, ABI_PARAM1);
+        code.MOV64(FLOAT_UNIFORMS, reinterpret_cast<u64>(float_uniforms));
+        code.MOV64(BOOL_UNIFORMS, reinterpret_cast<u64>(bool_uniforms));
+        code.MOV64(STACK_BASE, RSP);
+
+        const std::pair<u32, u32> main_range(main_offset, PROGRAM_SIZE);
+        current_range = main_range;
+        if (!CompileBlock(main_offset, PROGRAM_SIZE, 0))
+            return false;
+        EmitExit();
+
+        // Compile subroutines, which may in turn reference further subroutines
+        for (bool done = false; !done;) {
+            done = true;
+            for (auto& subroutine : subroutines) {
+                if (subroutine.second != NOT_COMPILED)
+                    continue;
+
+                subroutine.second = code.GetOffset();
+                current_range = subroutine.first;
+                code.SUB64(RSP, FRAME_SIZE);
+                if (!CompileBlock(subroutine.first.first, subroutine.first.second, 0))
+                    return false;
+                code.ADD64(RSP, FRAME_SIZE);
+                code.RET();
+                done = false;
+                break;
+            }
+        }
+
+        // Compiled subroutines use the host stack, so recursion or calls nested deeper than the
+        // interpreter's call stack allows must not reach the generated code
+        std::map<std::pair<u32, u32>, int> call_depths;
+        if (GetCallDepth(main_range, call_depths) > MAX_CALL_DEPTH)
+            return false;
+
+        for (const auto& call : calls)
+            code.SetJumpTarget(call.first, subroutines[call.second]);
+
+        return true;
+    }
+
+    const std::vector<u8>& GetCode() const {
+        return code.GetCode();
+    }
+
+    size_t GetEntryPoint() const {
+        return entry_point;
+    }
+
+private:
+    static const u32 PROGRAM_SIZE = 1024;
+
+    // Bounds the nesting depth of conditional blocks, which are inlined
+    static const int MAX_NESTING = 16;
+
+    // Maximal number of nested calls, same as the interpreter's call stack size
+    static const int MAX_CALL_DEPTH = 16;
+
+    static const size_t NOT_COMPILED = ~size_t(0);
+
+    /**
+     * Returns the maximal number of nested calls made by the given range of code, or a value
+     * larger than MAX_CALL_DEPTH if it may call itself.
+     * @param depths Depths of the ranges visited so far, ranges currently being visited map to -1
+     */
+    int GetCallDepth(const std::pair<u32, u32>& range, std::map<std::pair<u32, u32>, int>& depths) {
+        auto visited = depths.find(range);
+        if (visited != depths.end())
+            return (visited->second < 0) ? MAX_CALL_DEPTH + 1 : visited->second;
+
+        depths[range] = -1;
+        int depth = 0;
+        for (const auto& callee : callees[range])
+            depth = std::max(depth, 1 + GetCallDepth(callee, depths));
+
+        // Clamp the result so that long chains of calls can't overflow it
+        depth = std::min(depth, MAX_CALL_DEPTH + 1);
+        depths[range] = depth;
+        return depth;
+    }
+
+    /// Leaves the program from any nesting level
+    void EmitExit() {
+        code.MOV64(RSP, STACK_BASE);
+        code.SetJumpTarget(code.JMP(), epilogue);
+    }
+
+    /// Compiles the instructions in [begin, end), returns false if they can't be compiled
+    bool CompileBlock(u32 begin, u32 end, int depth) {
+        if (depth > MAX_NESTING || end > PROGRAM_SIZE)
+            return false;
+
+        u32 offset = begin;
+        while (offset < end) {
+            const Instruction& instr = *(const Instruction*)&program[offset];
+
+            if (instr.opcode.GetInfo().type == Instruction::OpCodeType::Arithmetic) {
+                if (!CompileArithmetic(instr))
+                    return false;
+                ++offset;
+                continue;
+            }
+
+            switch (instr.opcode) {
+            case Instruction::OpCode::END:
+                EmitExit();
+                return true;
+
+            case Instruction::OpCode::CALL:
+            {
+                const std::pair<u32, u32> subroutine(instr.flow_control.dest_offset,
+                                                     instr.flow_control.dest_offset + instr.flow_control.num_instructions);
+                subroutines.insert(std::make_pair(subroutine, NOT_COMPILED));
+                callees[current_range].push_back(subroutine);
+                calls.push_back(std::make_pair(code.CALL(), subroutine));
+                ++offset;
+                break;
+            }
+
+            case Instruction::OpCode::NOP:
+                ++offset;
+                break;
+
+            case Instruction::OpCode::IFU:
+            case Instruction::OpCode::IFC:
+            {
+                const u32 else_offset = instr.flow_control.dest_offset;
+                const u32 end_offset = else_offset + instr.flow_control.num_instructions;
+                if (else_offset <= offset || end_offset > end)
+                    return false;
+
+                if (instr.opcode == Instruction::OpCode::IFU) {
+                    code.CMP8(BOOL_UNIFORMS, instr.flow_control.bool_uniform_id, 0);
+                } else if (!CompileCondition(instr)) {
+                    return false;
+                }
+
+                size_t else_fixup = code.J_CC(CC_E);
+                if (!CompileBlock(offset + 1, else_offset, depth + 1))
+                    return false;
+                size_t end_fixup = code.JMP();
+                code.SetJumpTarget(else_fixup, code.GetOffset());
+                if (!CompileBlock(else_offset, end_offset, depth + 1))
+                    return false;
+                code.SetJumpTarget(end_fixup, code.GetOffset());
+
+                offset = end_offset;
+                break;
+            }
+
+            default:
+                return false;
+            }
+        }
+
+        // Running off the end of the shader binary ends the program
+        if (end == PROGRAM_SIZE)
+            EmitExit();
+
+        return true;
+    }
+
+    /// Sets the zero flag if the IFC condition is false
+    bool CompileCondition(const Instruction& instr) {
+        auto flow_control = instr.flow_control;
+
+        code.MOVZX8(RAX, STATE, offsetof(JitState, conditional_code));
+        if (!(bool)flow_control.refx)
+            code.XOR32(RAX, 1);
+        code.MOVZX8(RCX, STATE, offsetof(JitState, conditional_code) + 1);
+        if (!(bool)flow_control.refy)
+            code.XOR32(RCX, 1);
+
+        switch (flow_control.op) {
+        case flow_control.Or:
+            code.OR32(RAX, RCX);
+            break;
+
+        case flow_control.And:
+            code.AND32(RAX, RCX);
+            break;
+
+        case flow_control.JustX:
+            break;
+
+        case flow_control.JustY:
+            code.MOV32(RAX, RCX);
+            break;
+
+        default:
+            return false;
+        }
+
+        code.TEST32(RAX, RAX);
+        return true;
+    }
+
+    void LoadConstant(XmmReg dest, float value) {
+        u32 raw;
+        memcpy(&raw, &value, sizeof(raw));
+        code.MOV32(RAX, raw);
+        code.MOVD(dest, RAX);
+        code.SHUFPS(dest, dest, 0);
+    }
+
+    void LoadSource(XmmReg dest, const SourceRegister& source_reg) {
+        switch (source_reg.GetRegisterType()) {
+        case RegisterType::Input:
+            code.MOV64(RAX, STATE, offsetof(JitState, input_register_table) + sizeof(float24*) * source_reg.GetIndex());
+            code.MOVUPS(dest, RAX, 0);
+            break;
+
+        case RegisterType::Temporary:
+            code.MOVUPS(dest, STATE, offsetof(JitState, temporary_registers) + sizeof(Math::Vec4<float24>) * source_reg.GetIndex());
+            break;
+
+        case RegisterType::FloatUniform:
+            code.MOVUPS(dest, FLOAT_UNIFORMS, sizeof(Math::Vec4<float24>) * source_reg.GetIndex());
+            break;
+
+        default:
+            code.MOVUPS(dest, STATE, offsetof(JitState, dummy_vec4_float24));
+            break;
+        }
+    }
+
+    /// Applies the swizzle selectors and negation given by the operand descriptor
+    template<typename SelectorFunc>
+    void ApplySwizzle(XmmReg reg, SelectorFunc selector, bool negate) {
+        u8 shuffle = 0;
+        for (int i = 0; i < 4; ++i)
+            shuffle |= static_cast<u8>((int)selector(i) << (2 * i));
+
+        if (shuffle != 0xE4) // identity
+            code.SHUFPS(reg, reg, shuffle);
+
+        // Compilers turn the interpreter's multiplication by -1 into a sign flip, too
+        if (negate) {
+            LoadConstant(CONSTANT, -0.f);
+            code.XORPS(reg, CONSTANT);
+        }
+    }
+
+    /// Writes the components of src enabled in mask to the instruction's destination register
+    void StoreDest(const Instruction& instr, XmmReg src, unsigned mask) {
+        X64Reg base = STATE;
+        s32 disp = offsetof(JitState, dummy_vec4_float24);
+
+        if (instr.common.dest < 0x08) {
+            code.MOV64(RDX, STATE, offsetof(JitState, output_register_table) + sizeof(float24*) * 4 * instr.common.dest.GetIndex());
+            base = RDX;
+            disp = 0;
+        } else if (instr.common.dest >= 0x10 && instr.common.dest < 0x20) {
+            disp = offsetof(JitState, temporary_registers) + sizeof(Math::Vec4<float24>) * instr.common.dest.GetIndex();
+        }
+
+        if (mask == 0xF) {
+            code.MOVUPS(base, disp, src);
+            return;
+        }
+
+        // Output registers may not be followed by four writable components, so write only the
+        // enabled ones like the interpreter does
+        for (int i = 0; i < 4; ++i) {
+            if (!(mask & (1 << i)))
+                continue;
+
+            if (i == 0) {
+                code.MOVSS(base, disp, src);
+            } else {
+                code.PSHUFD(SCRATCH1, src, static_cast<u8>(i * 0x55));
+                code.MOVSS(base, disp + i * static_cast<s32>(sizeof(float24)), SCRATCH1);
+            }
+        }
+    }
+
+    bool CompileArithmetic(const Instruction& instr) {
+        const SwizzlePattern& swizzle = *(const SwizzlePattern*)&swizzle_data[instr.common.operand_desc_id];
+
+        // The interpreter aborts on these
+        if (0 != (instr.opcode.GetInfo().subtype & Instruction::OpCodeInfo::SrcInversed))
+            return false;
+
+        unsigned dest_mask = 0;
+        for (int i = 0; i < 4; ++i)
+            dest_mask |= swizzle.DestComponentEnabled(i) ? (1 << i) : 0;
+
+        bool uses_src2 = false;
+        switch (instr.opcode.EffectiveOpCode()) {
+        case Instruction::OpCode::ADD:
+        case Instruction::OpCode::MUL:
+        case Instruction::OpCode::MAX:
+        case Instruction::OpCode::DP3:
+        case Instruction::OpCode::DP4:
+        case Instruction::OpCode::CMP:
+            uses_src2 = true;
+            break;
+
+        case Instruction::OpCode::RCP:
+        case Instruction::OpCode::RSQ:
+        case Instruction::OpCode::MOVA:
+        case Instruction::OpCode::MOV:
+            break;
+
+        default:
+            return false;
+        }
+
+        // Load SRC1 first, since resolving it may call into C++ code which clobbers XMM registers
+        if (instr.common.address_register_index != 0) {
+            code.MOV64(ABI_PARAM1, STATE);
+            code.MOV64(ABI_PARAM2, reinterpret_cast<u64>(&instr));
+            code.MOV64(ABI_PARAM3, FLOAT_UNIFORMS);
+            code.MOV64(RAX, reinterpret_cast<u64>(&LookupRelativeSource));
+            code.CALL(RAX);
+            code.MOVUPS(SRC1, RAX, 0);
+        } else {
+            LoadSource(SRC1, instr.common.GetSrc1(false));
+        }
+        ApplySwizzle(SRC1, [&](int i) { return swizzle.GetSelectorSrc1(i); }, (bool)swizzle.negate_src1);
+
+        if (uses_src2) {
+            LoadSource(SRC2, instr.common.GetSrc2(false));
+            ApplySwizzle(SRC2, [&](int i) { return swizzle.GetSelectorSrc2(i); }, (bool)swizzle.negate_src2);
+        }
+
+        switch (instr.opcode.EffectiveOpCode()) {
+        case Instruction::OpCode::ADD:
+            code.MOVAPS(RESULT, SRC1);
+            code.ADDPS(RESULT, SRC2);
+            StoreDest(instr, RESULT, dest_mask);
+            break;
+
+        case Instruction::OpCode::MUL:
+            code.MOVAPS(RESULT, SRC1);
+            code.MULPS(RESULT, SRC2);
+            StoreDest(instr, RESULT, dest_mask);
+            break;
+
+        case Instruction::OpCode::MAX:
+            // MAXPS returns its second operand unless the first one is greater, which matches
+            // std::max(src1, src2) with the operands swapped
+            code.MOVAPS(RESULT, SRC2);
+            code.MAXPS(RESULT, SRC1);
+            StoreDest(instr, RESULT, dest_mask);
+            break;
+
+        case Instruction::OpCode::DP3:
+        case Instruction::OpCode::DP4:
+        {
+            // Accumulate the products in the same order as the interpreter
+            int num_components = (instr.opcode == Instruction::OpCode::DP3) ? 3 : 4;
+            code.MOVAPS(SCRATCH1, SRC1);
+            code.MULPS(SCRATCH1, SRC2);
+            code.XORPS(RESULT, RESULT);
+            code.ADDSS(RESULT, SCRATCH1);
+            for (int i = 1; i < num_components; ++i) {
+                code.PSHUFD(SCRATCH2, SCRATCH1, static_cast<u8>(i * 0x55));
+                code.ADDSS(RESULT, SCRATCH2);
+            }
+            code.SHUFPS(RESULT, RESULT, 0);
+            StoreDest(instr, RESULT, dest_mask & ((1 << num_components) - 1));
+            break;
+        }
+
+        case Instruction::OpCode::RCP:
+        case Instruction::OpCode::RSQ:
+            // Computed in double precision like the interpreter, one component at a time
+            for (int i = 0; i < 4; ++i) {
+                if (!(dest_mask & (1 << i)))
+                    continue;
+
+                code.PSHUFD(SCRATCH2, SRC1, static_cast<u8>(i * 0x55));
+                code.CVTSS2SD(SCRATCH2, SCRATCH2);
+                if (instr.opcode.EffectiveOpCode() == Instruction::OpCode::RSQ)
+                    code.SQRTSD(SCRATCH2, SCRATCH2);
+                code.MOV64(RAX, 0x3FF0000000000000ull); // 1.0
+                code.MOVQ(RESULT, RAX);
+                code.DIVSD(RESULT, SCRATCH2);
+                code.CVTSD2SS(RESULT, RESULT);
+                code.SHUFPS(RESULT, RESULT, 0);
+                StoreDest(instr, RESULT, 1 << i);
+            }
+            break;
+
+        case Instruction::OpCode::MOVA:
+            for (int i = 0; i < 2; ++i) {
+                if (!(dest_mask & (1 << i)))
+                    continue;
+
+                code.PSHUFD(SCRATCH1, SRC1, static_cast<u8>(i * 0x55));
+                code.CVTTSS2SI(RAX, SCRATCH1);
+                code.MOV32(STATE, offsetof(JitState, address_registers) + i * sizeof(s32), RAX);
+            }
+            break;
+
+        case Instruction::OpCode::MOV:
+            StoreDest(instr, SRC1, dest_mask);
+            break;
+
+        case Instruction::OpCode::CMP:
+            for (int i = 0; i < 2; ++i) {
+                auto compare_op = instr.common.compare_op;
+                auto op = (i == 0) ? compare_op.x.Value() : compare_op.y.Value();
+
+                // CMPSS predicates, where greater-than comparisons swap their operands
+                u8 predicate;
+                bool swap = false;
+                switch (op) {
+                    case compare_op.Equal:        predicate = 0; break;
+                    case compare_op.NotEqual:     predicate = 4; break;
+                    case compare_op.LessThan:     predicate = 1; break;
+                    case compare_op.LessEqual:    predicate = 2; break;
+                    case compare_op.GreaterThan:  predicate = 1; swap = true; break;
+                    case compare_op.GreaterEqual: predicate = 2; swap = true; break;
+                    default:
+                        return false;
+                }
+
+                code.PSHUFD(SCRATCH1, swap ? SRC2 : SRC1, static_cast<u8>(i * 0x55));
+                code.PSHUFD(SCRATCH2, swap ? SRC1 : SRC2, static_cast<u8>(i * 0x55));
+                code.CMPSS(SCRATCH1, SCRATCH2, predicate);
+                code.MOVD(RAX, SCRATCH1);
+                code.AND32(RAX, 1);
+                code.MOV8(STATE, offsetof(JitState, conditional_code) + i, RAX);
+            }
+            break;
+
+        default:
+            return false;
+        }
+
+        return true;
+    }
+
+    const u32* program;
+    const u32* swizzle_data;
+    const Math::Vec4<float24>* float_uniforms;
+    const bool* bool_uniforms;
+
+    X64Emitter code;
+    size_t epilogue = 0;
+    size_t entry_point = 0;
+
+    // Code offsets of subroutines by instruction range, and the call sites referencing them
+    std::map<std::pair<u32, u32>, size_t> subroutines;
+    std::vector<std::pair<size_t, std::pair<u32, u32>>> calls;
+
+    // Subroutines called by each range of code, and the range currently being compiled
+    std::map<std::pair<u32, u32>, std::vector<std::pair<u32, u32>>> callees;
+    std::pair<u32, u32> current_range;
+};
+
+} // anonymous namespace
+
+JitShader::~JitShader() {
+    if (code)
+        FreeMemoryPages(code, code_size);
+}
+
+std::unique_ptr<JitShader> JitShader::Compile(const std::array<u32, 1024>& program,
+                                              const std::array<u32, 1024>& swizzle_data,
+                                              u32 main_offset,
+                                              const Math::Vec4<float24>* float_uniforms,
+                                              const bool* bool_uniforms) {
+    std::unique_ptr<JitShader> shader(new JitShader);
+    shader->program = program;
+    shader->swizzle_data = swizzle_data;
+    shader->main_offset = main_offset;
+
+    // Compile from the shader's own copy of the program, which compiled code may reference
+    ShaderCompiler compiler(shader->program.data(), shader->swizzle_data.data(), float_uniforms, bool_uniforms);
+    if (main_offset >= program.size() || !compiler.Compile(main_offset))
+        return nullptr;
+
+    const std::vector<u8>& code = compiler.GetCode();
+    shader->code_size = code.size();
+    shader->code = static_cast<u8*>(AllocateExecutableMemory(code.size(), false));
+    if (shader->code == nullptr)
+        return nullptr;
+
+    memcpy(shader->code, code.data(), code.size());
+    shader->entry_point = reinterpret_cast<void (*)(JitState*)>(shader->code + compiler.GetEntryPoint());
+    return shader;
+}
+
+bool JitShader::Matches(const std::array<u32, 1024>& program, const std::array<u32, 1024>& swizzle_data,
+                        u32 main_offset) const {
+    return this->main_offset == main_offset && this->program == program && this->swizzle_data == swizzle_data;
+}
+
+} // namespace
+
+} // namespace
+
+#endif // SHADER_JIT_X64
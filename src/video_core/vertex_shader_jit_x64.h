@@ -0,0 +1,83 @@
+// Copyright 2014 Citra Emulator Project
+// Licensed under GPLv2 or any later version
+// Refer to the license.txt file included.
+
+#pragma once
+
+#include <array>
+#include <memory>
+
+#include "common/common.h"
+
+#include "math.h"
+#include "vertex_shader.h"
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(_M_GENERIC)
+#define SHADER_JIT_X64
+#endif
+
+#ifdef SHADER_JIT_X64
+
+namespace Pica {
+
+namespace VertexShader {
+
+/// Register state of a single shader invocation, as accessed by compiled shader code
+struct JitState {
+    const float24* input_register_table[16];
+    float24* output_register_table[7*4];
+
+    Math::Vec4<float24> temporary_registers[16];
+    s32 address_registers[3];
+    bool conditional_code[2];
+
+    // Placeholder for invalid inputs and outputs
+    float24 dummy_vec4_float24[4];
+};
+
+/**
+ * A vertex shader program compiled to native x86-64 code. Uniforms are read when the program
+ * runs, so a compiled program stays valid until the shader binary, the swizzle patterns or the
+ * main offset change.
+ */
+class JitShader : NonCopyable {
+public:
+    ~JitShader();
+
+    /**
+     * Compiles the program starting at main_offset.
+     * @return The compiled program, or nullptr if it uses features the compiler does not handle
+     */
+    static std::unique_ptr<JitShader> Compile(const std::array<u32, 1024>& program,
+                                              const std::array<u32, 1024>& swizzle_data,
+                                              u32 main_offset,
+                                              const Math::Vec4<float24>* float_uniforms,
+                                              const bool* bool_uniforms);
+
+    /// Returns true if this is the compiled form of the given program
+    bool Matches(const std::array<u32, 1024>& program, const std::array<u32, 1024>& swizzle_data,
+                 u32 main_offset) const;
+
+    void Run(JitState& state) const {
+        entry_point(&state);
+    }
+
+private:
+    JitShader() = default;
+
+    // Copies of the source program. The program is also referenced by compiled code when
+    // resolving source registers relative to an address register.
+    std::array<u32, 1024> program;
+    std::array<u32, 1024> swizzle_data;
+    u32 main_offset;
+
+    u8* code = nullptr;
+    size_t code_size = 0;
+    void (*entry_point)(JitState* state) = nullptr;
+};
+
+} // namespace
+
+} // namespace
+
+#endif // SHADER_JIT_X64
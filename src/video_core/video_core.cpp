@@ -9,6 +9,8 @@
 #include "core/core.h"
 
 #include "video_core/video_core.h"
+#include "video_core/command_processor.h"
+#include "video_core/rasterizer.h"
 #include "video_core/renderer_base.h"
 #include "video_core/renderer_opengl/renderer_opengl.h"
 
@@ -28,6 +30,9 @@ void Init(EmuWindow* emu_window) {
     g_renderer->SetWindow(g_emu_window);
     g_renderer->Init();
 
+    Pica::CommandProcessor::Init();
+    Pica::Rasterizer::Init();
+
     g_current_frame = 0;
 
     LOG_DEBUG(Render, "initialized OK");
@@ -35,6 +40,9 @@ void Init(EmuWindow* emu_window) {
 
 /// Shutdown the video core
 void Shutdown() {
+    Pica::Rasterizer::Shutdown();
+    Pica::CommandProcessor::Shutdown();
+
     delete g_renderer;
     LOG_DEBUG(Render, "shutdown OK");
 }